@@ -0,0 +1,188 @@
+#include "BatchSimulation.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include "ProfileDatabase.h"
+#include "ResultStats.h"
+#include "Route.h"
+#include "SimulationCounters.h"
+
+Routing::BatchSimulation::BatchSimulation(const ProfileDatabase &database,
+                                          const std::vector<Data::BatchEntry> &requests) : m_requests(requests) {
+    std::map<std::string, int> routes;
+    for (const auto &request : m_requests) {
+        auto it = routes.find(request.routeFile);
+        if (it == routes.end()) {
+            // Profiles are shared, a copy for every route of a large batch would not fit the memory
+            it = routes.insert({request.routeFile, static_cast<int>(m_simulations.size())}).first;
+            m_simulations.push_back(new MCSimulation(database, Route(database, request.routeFile),
+                                                     ProfileLayout::Shared));
+            m_simulations.back()->SetSeed(static_cast<uint64_t>(std::rand()));
+        }
+        m_requestRoutes.push_back(it->second);
+    }
+}
+
+Routing::BatchSimulation::~BatchSimulation() {
+    for (auto simulation : m_simulations) {
+        delete simulation;
+    }
+}
+
+void Routing::BatchSimulation::SetRngBackend(RngBackend backend) {
+    for (auto simulation : m_simulations) {
+        simulation->SetRngBackend(backend);
+    }
+}
+
+void Routing::BatchSimulation::SetSeed(uint64_t seed) {
+    for (std::size_t i = 0; i < m_simulations.size(); ++i) {
+        m_simulations[i]->SetSeed(seed + i);
+    }
+}
+
+void Routing::BatchSimulation::SetCounters(SimulationCounters *counters) {
+    m_counters = counters;
+    for (auto simulation : m_simulations) {
+        simulation->SetCounters(counters);
+    }
+}
+
+void Routing::BatchSimulation::SetEngine(SimulationEngine engine) {
+    m_engine = engine;
+}
+
+int Routing::BatchSimulation::GetRequestCount() const {
+    return static_cast<int>(m_requests.size());
+}
+
+void Routing::BatchSimulation::Run(int samples, const std::vector<float> &percentiles,
+                                   const std::function<void(int, const ResultStats &)> &consumer) const {
+    if (samples < 1) {
+        std::cerr << "ERROR: Invalid number of samples " << samples << std::endl;
+        return;
+    }
+
+    int requestCount = static_cast<int>(m_requests.size());
+    int chunks = (samples + BATCH_CHUNK_SAMPLES - 1) / BATCH_CHUNK_SAMPLES;
+    std::vector<std::vector<float>> travelTimes(requestCount);
+    std::vector<int> remaining(requestCount, chunks);
+    std::vector<ResultStats *> stats(requestCount, nullptr);
+    int nextResult = 0;
+
+    // Windows follow the order of the requests, so the results are streamed window by window. Longest routes of a
+    // window are started first, chunks of the short ones then fill the tail of the window.
+    std::vector<int> order(requestCount);
+    std::iota(order.begin(), order.end(), 0);
+    for (int window = 0; window < requestCount; window += BATCH_MAX_OUTSTANDING) {
+        std::stable_sort(order.begin() + window, order.begin() + std::min(requestCount, window + BATCH_MAX_OUTSTANDING),
+                         [this](int a, int b) {
+                             return m_simulations[m_requestRoutes[a]]->GetSegmentCount() >
+                                    m_simulations[m_requestRoutes[b]]->GetSegmentCount();
+                         });
+    }
+
+    // Statistics of a finished request are passed to the consumer with all the finished requests following it
+    auto publish = [&](int r, ResultStats *result, SimulationCounters *counters) {
+#pragma omp critical(batch_results)
+        {
+            PhaseTimer timer(counters != nullptr ? &counters->writeSeconds : nullptr);
+            stats[r] = result;
+            while (nextResult < requestCount && stats[nextResult] != nullptr) {
+                consumer(nextResult, *stats[nextResult]);
+                delete stats[nextResult];
+                stats[nextResult] = nullptr;
+                nextResult++;
+            }
+        }
+
+        // Same critical section as the simulations merging their counters
+        if (counters != nullptr) {
+#pragma omp critical(simulation_counters)
+            {
+                m_counters->Merge(*counters);
+            }
+        }
+    };
+
+    // Samples of a request are simulated by independent chunk tasks
+    auto simulate = [&](int r) {
+        for (int c = 0; c < chunks; ++c) {
+#pragma omp task firstprivate(r, c) shared(travelTimes, remaining)
+            {
+                const Data::BatchEntry &request = m_requests[r];
+                int secs = (request.startDay * 86400) + (request.startHour * 3600) + (request.startMinute * 60);
+
+                // Samples are allocated by the first started chunk and released by the last one
+                float *buffer;
+#pragma omp critical(batch_buffers)
+                {
+                    if (travelTimes[r].empty())
+                        travelTimes[r].resize(samples);
+                    buffer = travelTimes[r].data();
+                }
+
+                int first = c * BATCH_CHUNK_SAMPLES;
+                m_simulations[m_requestRoutes[r]]->SimulateChunk(first, std::min(BATCH_CHUNK_SAMPLES,
+                                                                                 samples - first), secs,
+                                                                 buffer + first);
+
+                int left;
+#pragma omp atomic capture
+                left = --remaining[r];
+
+                if (left == 0) {
+                    // Last chunk of the request summarizes the samples and releases them
+                    SimulationCounters taskCounters;
+                    SimulationCounters *counters = m_counters != nullptr ? &taskCounters : nullptr;
+                    ResultStats *result;
+                    {
+                        PhaseTimer timer(counters != nullptr ? &counters->statsSeconds : nullptr);
+                        result = new ResultStats(travelTimes[r], percentiles);
+                    }
+#pragma omp critical(batch_buffers)
+                    {
+                        std::vector<float>().swap(travelTimes[r]);
+                    }
+                    publish(r, result, counters);
+                }
+            }
+        }
+    };
+
+#pragma omp parallel
+#pragma omp single
+    for (int window = 0; window < requestCount; window += BATCH_MAX_OUTSTANDING) {
+        // Task group waits for the chunks spawned by the histogram tasks too, which taskwait would not
+#pragma omp taskgroup
+        for (int i = window; i < std::min(requestCount, window + BATCH_MAX_OUTSTANDING); ++i) {
+            int r = order[i];
+            if (m_engine == SimulationEngine::MonteCarlo) {
+                simulate(r);
+                continue;
+            }
+
+#pragma omp task firstprivate(r)
+            {
+                const Data::BatchEntry &request = m_requests[r];
+                TravelTimeHistogram histogram;
+                if (m_simulations[m_requestRoutes[r]]->ConvolveHistograms(request.startDay, request.startHour,
+                                                                          request.startMinute, histogram)) {
+                    SimulationCounters taskCounters;
+                    SimulationCounters *counters = m_counters != nullptr ? &taskCounters : nullptr;
+                    ResultStats *result;
+                    {
+                        PhaseTimer timer(counters != nullptr ? &counters->statsSeconds : nullptr);
+                        result = new ResultStats(histogram, percentiles);
+                    }
+                    publish(r, result, counters);
+                } else {
+                    // Histogram is too wide, the request is sampled
+                    simulate(r);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Data.h"
+#include "MCSimulation.h"
+
+#define BATCH_CHUNK_SAMPLES 512 // Samples of a single task of the batch simulation
+#define BATCH_MAX_OUTSTANDING 64 // Requests of the batch simulation whose samples are held in memory at once
+
+namespace Routing {
+    class ProfileDatabase;
+
+    /**
+     * Simulation of many routes and departure times sharing a single profile database. The samples of all the
+     * requests are split into chunks simulated as OpenMP tasks, idle threads steal chunks of any request, so short
+     * routes fill the gaps left by the long ones instead of waiting for them. With the histogram engine every request
+     * is a single task, its chunks are spawned only if the histogram gets too wide. Requests are started in windows
+     * of BATCH_MAX_OUTSTANDING in the order of the requests, a window is started when all the tasks of the previous
+     * one are done, so at most BATCH_MAX_OUTSTANDING sample buffers and results waiting for the previous requests
+     * exist at any time. Only the requests of a window are reordered, longest routes first.
+     */
+    class BatchSimulation {
+    public:
+        /**
+         * Constructor, resolves the routes of the requests, every route file is read once
+         * @param database profiles of the road network, must contain all the segments and outlive the batch
+         * @param requests routes and departure times to simulate
+         */
+        BatchSimulation(const ProfileDatabase &database, const std::vector<Data::BatchEntry> &requests);
+
+        BatchSimulation(const BatchSimulation &) = delete;
+
+        BatchSimulation &operator=(const BatchSimulation &) = delete;
+
+        /**
+         * Destructor frees the simulations of the routes
+         */
+        ~BatchSimulation();
+
+        /**
+         * Select random number generator backend of all the routes
+         * @param backend generator backend
+         */
+        void SetRngBackend(RngBackend backend);
+
+        /**
+         * Fix the seed of the random number generator, i-th distinct route is seeded by seed + i. Otherwise the
+         * routes are seeded by std::rand.
+         * @param seed seed of the first route
+         */
+        void SetSeed(uint64_t seed);
+
+        /**
+         * Enable collection of the hot path counters of all the routes, see MCSimulation::SetCounters
+         * @param counters counters to add to, must outlive the runs, nullptr disables the collection
+         */
+        void SetCounters(SimulationCounters *counters);
+
+        /**
+         * Select method computing the travel time distributions, requests whose histogram gets too wide are
+         * sampled, see MCSimulation::ConvolveHistograms
+         * @param engine simulation engine
+         */
+        void SetEngine(SimulationEngine engine);
+
+        /**
+         * Simulate all the requests
+         * @param samples number of samples of every request
+         * @param percentiles percentile values to obtain
+         * @param consumer called with the index and statistics of every request in the order of the requests, as
+         * soon as the request and all the previous ones are done
+         */
+        void Run(const int samples, const std::vector<float> &percentiles,
+                 const std::function<void(int, const ResultStats &)> &consumer) const;
+
+        /**
+         * @return number of requests of the batch
+         */
+        int GetRequestCount() const;
+
+    private:
+        /**
+         * Routes and departure times to simulate
+         */
+        std::vector<Data::BatchEntry> m_requests;
+
+        /**
+         * Simulation of every distinct route, all use the profiles of the database in place
+         */
+        std::vector<MCSimulation *> m_simulations;
+
+        /**
+         * Index of the route simulation of every request
+         */
+        std::vector<int> m_requestRoutes;
+
+        /**
+         * Counters enabled by SetCounters, null if disabled
+         */
+        SimulationCounters *m_counters = nullptr;
+
+        /**
+         * Method computing the travel time distributions
+         */
+        SimulationEngine m_engine = SimulationEngine::MonteCarlo;
+    };
+}
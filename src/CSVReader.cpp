@@ -1,29 +1,113 @@
 #include "CSVReader.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 
 namespace Routing {
 
+    bool CSVField::operator==(const char *text) const {
+        return std::strlen(text) == m_length && std::memcmp(text, m_data, m_length) == 0;
+    }
+
+    int CSVField::ToInt() const {
+        const char *p = m_data;
+        const char *end = m_data + m_length;
+        bool negative = false;
+        if (p < end && (*p == '+' || *p == '-'))
+            negative = *p++ == '-';
+
+        long long value = 0;
+        const char *digits = p;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            value = value * 10 + (*p - '0');
+            if (value > static_cast<long long>(INT_MAX) + 1)
+                throw std::out_of_range("stoi");
+        }
+        if (p == digits)
+            throw std::invalid_argument("stoi");
+
+        value = negative ? -value : value;
+        if (value > INT_MAX)
+            throw std::out_of_range("stoi");
+        return static_cast<int>(value);
+    }
+
+    float CSVField::ToFloat() const {
+        // Exact powers of ten representable in double
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+                                        1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        const char *p = m_data;
+        const char *end = m_data + m_length;
+        bool negative = false;
+        if (p < end && (*p == '+' || *p == '-'))
+            negative = *p++ == '-';
+
+        // Decimal digits are collected into an integer mantissa, at most 15 significant digits fit the double
+        // mantissa exactly and the result is then the correctly rounded quotient or product (Clinger's fast path)
+        uint64_t mantissa = 0;
+        int significant = 0;
+        int exponent = 0;
+        bool any = false;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significant += mantissa != 0;
+            any = true;
+        }
+        if (p < end && *p == '.') {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant += mantissa != 0;
+                exponent--;
+                any = true;
+            }
+        }
+
+        // Exponents, special values and long numbers take the slow path
+        if (!any || significant > 15 || exponent < -22 || (p < end && (*p == 'e' || *p == 'E')))
+            return ToFloatSlow();
+
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / powers[-exponent] : value;
+        float result = static_cast<float>(value);
+        return negative ? -result : result;
+    }
+
+    float CSVField::ToFloatSlow() const {
+        return std::stof(std::string(m_data, m_length));
+    }
+
     void CSVReader::readNextRow(std::istream &str) {
-        std::string line;
-        std::getline(str, line);
-        std::stringstream lineStream(line);
-        std::string cell;
-        m_data.clear();
-        while (std::getline(lineStream, cell, m_separator)) {
-            // Trim newline characters at the end of the line
-            cell.erase(std::remove(cell.begin(), cell.end(), '\n'), cell.end());
-            cell.erase(std::remove(cell.begin(), cell.end(), '\r'), cell.end());
-            cell.erase(std::remove(cell.begin(), cell.end(), ' '), cell.end());
-
-            m_data.push_back(cell);
+        // The line buffer keeps its capacity between rows
+        std::getline(str, m_line);
+        m_columns.clear();
+
+        // Remove newline characters and spaces in the whole line, same as trimming every column
+        if (m_separator != ' ' && m_separator != '\r') {
+            m_line.erase(std::remove_if(m_line.begin(), m_line.end(),
+                                        [](char c) { return c == ' ' || c == '\r' || c == '\n'; }),
+                         m_line.end());
+        }
+
+        // Empty line has no columns, separator at the end of the line does not start a new column
+        std::size_t begin = 0;
+        while (begin < m_line.size()) {
+            std::size_t sep = m_line.find(m_separator, begin);
+            if (sep == std::string::npos)
+                sep = m_line.size();
+            m_columns.emplace_back(begin, sep - begin);
+            begin = sep + 1;
         }
     }
 
     std::size_t CSVReader::size() const {
-        return m_data.size();
+        return m_columns.size();
     }
 
-    std::string const &CSVReader::operator[](std::size_t index) const {
-        return m_data[index];
+    CSVField CSVReader::operator[](std::size_t index) const {
+        return CSVField(m_line.data() + m_columns[index].first, m_columns[index].second);
     }
 
     std::istream &operator>>(std::istream &str, CSVReader &data) {
@@ -8,6 +8,71 @@
 #include <string>
 
 namespace Routing {
+    /**
+     * Single column of a CSV row, refers to the line buffer of the reader and is valid until the next row is read
+     */
+    class CSVField {
+    public:
+        /**
+         * Constructor
+         * @param data first character of the column
+         * @param length number of characters of the column
+         */
+        CSVField(const char *data, std::size_t length) : m_data(data), m_length(length) {}
+
+        /**
+         * @return first character of the column, not terminated
+         */
+        const char *data() const { return m_data; }
+
+        /**
+         * @return number of characters of the column
+         */
+        std::size_t size() const { return m_length; }
+
+        /**
+         * Compare the column with a terminated string
+         */
+        bool operator==(const char *text) const;
+
+        bool operator!=(const char *text) const { return !(*this == text); }
+
+        /**
+         * Copy of the column as string
+         */
+        operator std::string() const { return std::string(m_data, m_length); }
+
+        /**
+         * Parse the column as integer without copying, same rules as std::stoi
+         * @return parsed value
+         * @throws std::invalid_argument if the column does not start with a number
+         */
+        int ToInt() const;
+
+        /**
+         * Parse the column as float without copying, same rules as std::stof
+         * @return parsed value
+         * @throws std::invalid_argument if the column does not start with a number
+         */
+        float ToFloat() const;
+
+    private:
+        /**
+         * Parse the column by the standard library, for the rare formats the fast path does not handle
+         */
+        float ToFloatSlow() const;
+
+        /**
+         * First character of the column
+         */
+        const char *m_data;
+
+        /**
+         * Number of characters of the column
+         */
+        std::size_t m_length;
+    };
+
     class CSVReader {
     public:
         /**
@@ -19,9 +84,9 @@ namespace Routing {
         /**
          * Array access operator overload for column access for current row
          * @param index is a idx of column to read
-         * @return value in the selected column as string
+         * @return value in the selected column, valid until the next row is read
          */
-        std::string const &operator[](std::size_t index) const;
+        CSVField operator[](std::size_t index) const;
 
         /**
          * Size of current row
@@ -30,7 +95,9 @@ namespace Routing {
         std::size_t size() const;
 
         /**
-         * Fetches next row from file
+         * Fetches next row from file. The line is read into a buffer reused by all rows, spaces and carriage
+         * returns are removed in place and the columns are only located, so no memory is allocated once the
+         * buffer is large enough for the longest line.
          * @param str is an input stream of the file to be read
          */
         void readNextRow(std::istream &str);
@@ -45,9 +112,14 @@ namespace Routing {
 
     private:
         /**
-         * Hold current parsed row
+         * Current line
+         */
+        std::string m_line;
+
+        /**
+         * Offsets and lengths of the columns of the current line
          */
-        std::vector<std::string> m_data;
+        std::vector<std::pair<std::size_t, std::size_t>> m_columns;
 
         /**
          * Current CSV separator
@@ -1,40 +1,478 @@
 #include <map>
+#include <algorithm>
 #include <regex>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <dirent.h>
 #include "Data.h"
 #include "CSVReader.h"
+#include "ResultSink.h"
+#include "ResultStats.h"
 
 #define PROFILE_FILE_NAME_SEP "_"
 
-void
-Routing::Data::WriteResultAll(std::vector<float> &result, const std::string &file, int samples, float secondInterval) {
-    std::ofstream rfile(file);
-    int intervalsPerDay = 86400 / secondInterval;
-    // Header
-    rfile << "day;interval;1";
-    for (int j = 2; j <= samples; ++j) {
-        rfile << ";" << j;
+std::vector<Routing::Data::Segment> Routing::Data::LoadEdges(const std::string &segmentsFile) {
+    std::ifstream segmentFileStream(segmentsFile);
+    if (!segmentFileStream.is_open()) {
+        std::cerr << "ERROR: Unable to open file " << segmentsFile << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<Segment> segments;
+    ReadEdges(segmentFileStream, segments);
+    return segments;
+}
+
+bool Routing::Data::ReadEdges(std::istream &in, std::vector<Segment> &segments, std::ostream &log) {
+    segments.clear();
+    bool valid = true;
+    CSVReader row(';');
+    int cnt = 0;
+    in >> row; // Discard the header
+    while (in >> row) {
+        cnt++;
+        try {
+            if (row.size() != 3)
+                throw std::invalid_argument("column count");
+            segments.push_back({row[0], row[1].ToInt(), row[2].ToFloat()});
+        } catch (const std::exception &) {
+            log << "ERROR: Row " << cnt << " has invalid column count or value." << std::endl;
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+std::vector<Routing::Data::BatchEntry> Routing::Data::LoadBatchManifest(const std::string &manifestFile) {
+    std::ifstream manifestStream(manifestFile);
+    if (!manifestStream.is_open()) {
+        std::cerr << "ERROR: Unable to open file " << manifestFile << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<BatchEntry> entries;
+    CSVReader row(';');
+    int cnt = 0;
+    manifestStream >> row; // Discard the header
+    while (manifestStream >> row) {
+        cnt++;
+        if (row.size() == 0)
+            continue;
+        try {
+            if (row.size() != 4)
+                throw std::invalid_argument("column count");
+            BatchEntry entry = {row[0], row[1].ToInt(), row[2].ToInt(), row[3].ToInt()};
+            if (entry.startDay < 0 || entry.startDay > 6 || entry.startHour < 0 || entry.startHour > 23 ||
+                entry.startMinute < 0 || entry.startMinute > 59)
+                throw std::invalid_argument("departure");
+            entries.push_back(entry);
+        } catch (const std::exception &) {
+            std::cerr << "ERROR: Row " << cnt << " of manifest " << manifestFile << " is invalid." << std::endl;
+        }
+    }
+    return entries;
+}
+
+std::map<std::string, std::string> Routing::Data::ListSpeedProfiles(const std::string &profilesDir) {
+    // Load files in profile directory
+    DIR *dirp = opendir(profilesDir.c_str());
+    struct dirent *entry;
+    std::map<std::string, std::string> profilesByTmcId;
+
+    if (!dirp) {
+        std::cerr << "ERROR: Cannot open directory " << profilesDir << std::endl;
+        return profilesByTmcId;
+    }
+
+    char *fileName = new char[1024];
+    while ((entry = readdir(dirp))) {
+        if (entry->d_type == DT_REG) {
+            // First field in the speed profile file name corresponds to segment ID
+            char *token = strtok(strncpy(fileName, entry->d_name, 1024), PROFILE_FILE_NAME_SEP);
+            profilesByTmcId.emplace(std::string(token), profilesDir + '/' + std::string(entry->d_name));
+        }
+    }
+
+    delete[] fileName;
+    closedir(dirp);
+    return profilesByTmcId;
+}
+
+bool Routing::Data::LoadSpeedLevels(const std::string &speedProfileFile, SpeedLevels &levels, float freeflowSpeed,
+                                    float &secondInterval, std::ostream &log) {
+    const float oneDiv3point6 = 1 / 3.6; // For conversion of km/h to m/s
+    std::ifstream profileFileStream(speedProfileFile);
+    if (!profileFileStream.is_open()) {
+        log << "ERROR: Cannot open profile file " << speedProfileFile << std::endl;
+        return false;
+    }
+
+    // Get intervals from first two rows of the file, the rows are kept to be parsed with the rest of the file
+    CSVReader first('|'), second('|');
+    if (!(profileFileStream >> first) || !(profileFileStream >> second) || first.size() < 3 || second.size() < 3) {
+        log << "ERROR: Profile file " << speedProfileFile << " has less than two rows" << std::endl;
+        return false;
+    }
+
+    int profilesPerInterval;
+    int intervalsPerDay;
+    try {
+        std::vector<int> hours = {first[1].ToInt(), second[1].ToInt()};
+        std::vector<int> min = {first[2].ToInt(), second[2].ToInt()};
+        if (hours[0] == hours[1]) {
+            // Interval is less than 1 hour
+            secondInterval = 60 * (min[1] - min[0]);
+        } else {
+            // Interval is longer than 1 hour
+            secondInterval = (hours[1] - hours[0]) * 3600;
+        }
+    } catch (const std::exception &) {
+        secondInterval = 0;
+    }
+    if (secondInterval <= 0) {
+        log << "ERROR: Cannot determine time interval of profile file " << speedProfileFile << std::endl;
+        return false;
+    }
+
+    // Get profile count from number of columns in file
+    profilesPerInterval =
+            (first.size() - 3) / 2; // Skip first three columns, divide by two values in single SpeedProbability
+    intervalsPerDay = 86400 / secondInterval;
+
+    // Intervals missing in the file use freeflow speed
+    levels.intervals = 7 * intervalsPerDay;
+    levels.maxLevels = std::max(profilesPerInterval, 1);
+    levels.counts.assign(levels.intervals, 1);
+    levels.speeds.assign(levels.intervals * levels.maxLevels, freeflowSpeed);
+    levels.probabilities.assign(levels.intervals * levels.maxLevels, 0.0f);
+    for (int i = 0; i < levels.intervals; ++i) {
+        levels.probabilities[i * levels.maxLevels] = 1.0f;
     }
-    rfile << std::endl;
-    // Data
-    for (int d = 0; d < 7; ++d) {
-        for (int i = 0; i < intervalsPerDay; ++i) {
-            rfile << d << ";" << i << ";";
-            for (int s = 0; s < samples; ++s) {
-                if (s != 0)
-                    rfile << ";";
-                rfile << result[(d * intervalsPerDay * samples) + (i * samples) + s];
+
+    CSVReader next('|');
+    for (int rowNumber = 1;; ++rowNumber) {
+        const CSVReader *current = &next;
+        if (rowNumber == 1)
+            current = &first;
+        else if (rowNumber == 2)
+            current = &second;
+        else if (!(profileFileStream >> next))
+            break;
+        const CSVReader &row = *current;
+        if (row.size() < 3)
+            continue;
+
+        // Day of week
+        int currentDay = -1;
+        CSVField currentDayString = row[0];
+
+        if (currentDayString == "Monday") currentDay = 0; // Monday
+        else if (currentDayString == "Tuesday") currentDay = 1; // Tuesday
+        else if (currentDayString == "Wednesday") currentDay = 2; // Wednesday
+        else if (currentDayString == "Thursday") currentDay = 3; //
+        else if (currentDayString == "Friday") currentDay = 4;
+        else if (currentDayString == "Saturday") currentDay = 5;
+        else if (currentDayString == "Sunday") currentDay = 6;
+
+        if (currentDay == -1) {
+            log << "ERROR: Unknown day of week string " << std::string(currentDayString) << " on row " << rowNumber << " of "
+                << speedProfileFile << std::endl;
+            continue;
+        }
+
+        try {
+            // Time interval
+            int hour = row[1].ToInt();
+            int min = row[2].ToInt();
+            int currentProfileIdx =
+                    (((hour * 3600) + (min * 60)) / (int) secondInterval) + (currentDay * intervalsPerDay);
+            if (currentProfileIdx < 0 || currentProfileIdx >= levels.intervals) {
+                log << "ERROR: Invalid time " << hour << ":" << min << " on row " << rowNumber << " of "
+                    << speedProfileFile << std::endl;
+                continue;
             }
-            rfile << std::endl;
+
+            float *speeds = &levels.speeds[currentProfileIdx * levels.maxLevels];
+            float *probabilities = &levels.probabilities[currentProfileIdx * levels.maxLevels];
+            int count = 0;
+            float probabilitySum = 0.0f;
+            int rowProfiles = std::min(profilesPerInterval, static_cast<int>(row.size() - 3) / 2);
+            for (int i = 0; i < rowProfiles; i++) {
+
+                int rowIdx = i * 2 + 3; // Skip first three columns
+                CSVField velocity_str = row[rowIdx];
+                CSVField probability_str = row[rowIdx + 1];
+
+                if (velocity_str == "NaN" || probability_str == "NaN") {
+                    // Probability is nan
+                    continue;
+                }
+
+                float velocity = velocity_str.ToFloat() * oneDiv3point6; // Convert velocity from km/h to m/s
+                float probability = probability_str.ToFloat();
+
+                if (velocity <= 0.0f && velocity > 300.0f) {
+                    log << "Invalid velocity value: " << velocity << std::endl;
+                }
+
+                if (probability < 0.0f && probability > 1.0f) {
+                    log << "Invalid probability value: " << probability << std::endl;
+                }
+
+                speeds[count] = velocity;
+                probabilities[count] = probability;
+                count++;
+                probabilitySum += probability;
+            }
+
+            if ((1.0f - probabilitySum) > std::numeric_limits<float>::epsilon()) {
+                log << "Invalid probability sum: " << probabilitySum << std::endl;
+            }
+
+            if (count == 0 || probabilitySum <= 0.0f) {
+                log << "Day: " << currentDay << " no speed profile, using freeflow speed " << freeflowSpeed << "("
+                    << speedProfileFile << ")" << std::endl;
+                speeds[0] = freeflowSpeed;
+                probabilities[0] = 1.0f;
+                count = 1;
+            }
+            levels.counts[currentProfileIdx] = count;
+        } catch (const std::exception &) {
+            log << "ERROR: Invalid number on row " << rowNumber << " of " << speedProfileFile << std::endl;
         }
     }
-    rfile.close();
+    profileFileStream.close();
+    return true;
+}
+
+void Routing::Data::CollapseSpeedProfile(const float *speedProfileData, int intervals, SpeedLevels &levels) {
+    // Distinct speeds of every interval with the number of their entries in the expanded array
+    std::vector<std::vector<std::pair<float, int>>> distinct(intervals);
+    levels.maxLevels = 1;
+    for (int i = 0; i < intervals; ++i) {
+        for (int j = 0; j < INDEX_RESOLUTION; ++j) {
+            float speed = speedProfileData[i * INDEX_RESOLUTION + j];
+            auto it = std::find_if(distinct[i].begin(), distinct[i].end(),
+                                   [speed](const std::pair<float, int> &level) { return level.first == speed; });
+            if (it != distinct[i].end())
+                it->second++;
+            else
+                distinct[i].emplace_back(speed, 1);
+        }
+        levels.maxLevels = std::max(levels.maxLevels, static_cast<int>(distinct[i].size()));
+    }
+
+    levels.intervals = intervals;
+    levels.counts.assign(intervals, 0);
+    levels.speeds.assign(intervals * levels.maxLevels, 0.0f);
+    levels.probabilities.assign(intervals * levels.maxLevels, 0.0f);
+    for (int i = 0; i < intervals; ++i) {
+        levels.counts[i] = static_cast<int>(distinct[i].size());
+        for (int l = 0; l < levels.counts[i]; ++l) {
+            levels.speeds[i * levels.maxLevels + l] = distinct[i][l].first;
+            levels.probabilities[i * levels.maxLevels + l] = static_cast<float>(distinct[i][l].second) / INDEX_RESOLUTION;
+        }
+    }
+}
+
+void Routing::Data::ExpandSpeedLevels(const SpeedLevels &levels, float *speedProfileData, std::ostream &log) {
+    for (int i = 0; i < levels.intervals; ++i) {
+        const float *speeds = &levels.speeds[i * levels.maxLevels];
+        const float *probabilities = &levels.probabilities[i * levels.maxLevels];
+        float *profile = speedProfileData + i * INDEX_RESOLUTION;
+
+        int startIdx = 0;
+        for (int l = 0; l < levels.counts[i]; ++l) {
+            if (std::floor(probabilities[l] * INDEX_RESOLUTION) < 1 && probabilities[l] > 0.0f) {
+                log << "WARNING: Increase index resolution! (min. p: " << probabilities[l] << " )" << std::endl;
+            }
+
+            // The last speed takes the entries lost by rounding down, so that the whole interval is filled
+            int length = static_cast<int>(INDEX_RESOLUTION * probabilities[l]);
+            if (l == levels.counts[i] - 1 || startIdx + length > INDEX_RESOLUTION) {
+                length = INDEX_RESOLUTION - startIdx;
+            }
+
+            std::fill(profile + startIdx, profile + startIdx + length, speeds[l]);
+            startIdx += length;
+        }
+    }
+}
+
+int Routing::Data::AliasColumns(int maxLevels) {
+    int columns = 2;
+    while (columns < maxLevels)
+        columns *= 2;
+    return columns;
+}
+
+void Routing::Data::BuildAliasTables(const SpeedLevels &levels, int columns, float *aliasTable) {
+    std::vector<double> scaled(columns);
+    std::vector<double> thresholds(columns);
+    std::vector<int> aliases(columns);
+    std::vector<int> small, large;
+
+    for (int i = 0; i < levels.intervals; ++i) {
+        const float *speeds = &levels.speeds[i * levels.maxLevels];
+        const float *probabilities = &levels.probabilities[i * levels.maxLevels];
+        const int count = levels.counts[i];
+
+        // Vose's method, probabilities are scaled so that the average column holds 1
+        double probabilitySum = 0.0;
+        for (int l = 0; l < count; ++l) {
+            probabilitySum += probabilities[l];
+        }
+        small.clear();
+        large.clear();
+        for (int c = 0; c < columns; ++c) {
+            scaled[c] = c < count ? probabilities[c] * columns / probabilitySum : 0.0;
+            thresholds[c] = 1.0;
+            aliases[c] = c < count ? c : 0;
+            (scaled[c] < 1.0 ? small : large).push_back(c);
+        }
+        while (!small.empty() && !large.empty()) {
+            int less = small.back();
+            int more = large.back();
+            small.pop_back();
+            thresholds[less] = scaled[less];
+            aliases[less] = more;
+            scaled[more] -= 1.0 - scaled[less];
+            if (scaled[more] < 1.0) {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+
+        // Columns left in either list are full up to the rounding errors and keep threshold 1
+        float *table = aliasTable + i * columns * ALIAS_ENTRY_SIZE;
+        for (int c = 0; c < columns; ++c) {
+            table[c * ALIAS_ENTRY_SIZE] = static_cast<float>(thresholds[c] * ALIAS_THRESHOLD_SCALE);
+            table[c * ALIAS_ENTRY_SIZE + 1] = c < count ? speeds[c] : speeds[aliases[c]];
+            table[c * ALIAS_ENTRY_SIZE + 2] = speeds[aliases[c]];
+        }
+    }
+}
+
+bool Routing::Data::LoadSpeedProfile(const std::string &speedProfileFile, float **speedProfileData,
+                                     float freeflowSpeed, float &secondInterval, std::ostream &log) {
+    SpeedLevels levels;
+    if (!LoadSpeedLevels(speedProfileFile, levels, freeflowSpeed, secondInterval, log)) {
+        *speedProfileData = nullptr;
+        return false;
+    }
+    *speedProfileData = new float[INDEX_RESOLUTION * levels.intervals];
+    ExpandSpeedLevels(levels, *speedProfileData, log);
+    return true;
+}
+
+bool Routing::Data::WriteEdges(const std::string &segmentsFile, const std::vector<Segment> &segments) {
+    std::ofstream out(segmentsFile);
+    if (!out.is_open()) {
+        std::cerr << "ERROR: Unable to open file " << segmentsFile << std::endl;
+        return false;
+    }
+
+    out << "id;length;speed\n";
+    for (const auto &segment : segments) {
+        out << segment.tmcId << ";" << segment.length << ";" << segment.freeSpeed << "\n";
+    }
+    out.close();
+    if (out.fail()) {
+        std::cerr << "ERROR: Failed to write file " << segmentsFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Routing::Data::WriteSpeedLevels(const std::string &speedProfileFile, const SpeedLevels &levels,
+                                     int secondInterval) {
+    static const char *days[] = {"Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday", "Sunday"};
+    std::ofstream out(speedProfileFile);
+    if (!out.is_open()) {
+        std::cerr << "ERROR: Unable to open file " << speedProfileFile << std::endl;
+        return false;
+    }
+
+    // Whole file is formatted in memory, profiles of large networks are written by many threads at once
+    int intervalsPerDay = 86400 / secondInterval;
+    std::string buffer;
+    char field[32];
+    for (int i = 0; i < levels.intervals; ++i) {
+        int seconds = (i % intervalsPerDay) * secondInterval;
+        buffer += days[i / intervalsPerDay];
+        std::snprintf(field, sizeof(field), "|%d|%d", seconds / 3600, seconds % 3600 / 60);
+        buffer += field;
+        for (int l = 0; l < levels.maxLevels; ++l) {
+            if (l < levels.counts[i]) {
+                std::snprintf(field, sizeof(field), "|%.2f|%.2f", levels.speeds[i * levels.maxLevels + l] * 3.6f,
+                              levels.probabilities[i * levels.maxLevels + l]);
+                buffer += field;
+            } else {
+                buffer += "|NaN|NaN";
+            }
+        }
+        buffer += '\n';
+    }
+    out.write(buffer.data(), buffer.size());
+    out.close();
+    if (out.fail()) {
+        std::cerr << "ERROR: Failed to write file " << speedProfileFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void
+Routing::Data::WriteResultAll(std::vector<float> &result, const std::string &file, int samples, float secondInterval) {
+    int intervalsPerDay = 86400 / secondInterval;
+    TextResultSink sink(file);
+    sink.Write({"", samples, 7 * intervalsPerDay, 0, secondInterval}, result);
 }
 
 void Routing::Data::WriteResultSingle(std::vector<float> &result, const std::string &file) {
-    std::ofstream rfile(file);
-    for (const auto &r : result) {
-        rfile << r << "\n";
+    TextResultSink sink(file);
+    sink.Write({"", static_cast<int>(result.size()), 1, 0, 0.0f}, result);
+}
+
+void Routing::Data::WriteIntervalSummaryHeader(std::ostream &out, const std::vector<float> &percentiles) {
+    // Statistics hold the percentiles sorted
+    std::vector<float> sorted(percentiles);
+    std::sort(sorted.begin(), sorted.end());
+    out << "day;interval;mean;sample_dev";
+    for (const auto &p : sorted) {
+        out << ";p" << p * 100.0f;
+    }
+    out << "\n";
+}
+
+void Routing::Data::WriteIntervalSummary(std::ostream &out, int day, int interval, const ResultStats &stats) {
+    // Rows are written as the intervals finish, the stream is not flushed after every row
+    out << day << ";" << interval << ";" << stats.mean << ";" << stats.sampleDev;
+    for (const auto &p : stats.percentiles) {
+        out << ";" << p.second;
+    }
+    out << "\n";
+}
+
+void Routing::Data::WriteBatchSummaryHeader(std::ostream &out, const std::vector<float> &percentiles) {
+    std::vector<float> sorted(percentiles);
+    std::sort(sorted.begin(), sorted.end());
+    out << "route;day;hour;minute;samples;mean;sample_dev";
+    for (const auto &p : sorted) {
+        out << ";p" << p * 100.0f;
+    }
+    out << "\n";
+}
+
+void Routing::Data::WriteBatchSummary(std::ostream &out, const BatchEntry &entry, int samples,
+                                      const ResultStats &stats) {
+    out << entry.routeFile << ";" << entry.startDay << ";" << entry.startHour << ";" << entry.startMinute << ";"
+        << samples << ";" << stats.mean << ";" << stats.sampleDev;
+    for (const auto &p : stats.percentiles) {
+        out << ";" << p.second;
     }
-    rfile.flush();
-    rfile.close();
+    out << "\n";
 }
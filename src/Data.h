@@ -1,10 +1,157 @@
 #pragma once
 
 #include <list>
+#include <iostream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define INDEX_RESOLUTION 100 // Size of the speed profile array
+#define ALIAS_ENTRY_SIZE 3 // Floats in a single alias table column: threshold, speed, alias speed
+#define ALIAS_THRESHOLD_SCALE 16777216.0f // Alias thresholds are stored as 24-bit fractions
+
+class ResultStats;
 
 namespace Routing {
     namespace Data {
 
+        /**
+         * Single row of the edges file
+         */
+        struct Segment {
+            std::string tmcId;
+            int length;
+            float freeSpeed;
+        };
+
+        /**
+         * Load segments from the edges file
+         * @param segmentsFile CSV file with segment IDs, lengths in meters and freeflow speeds
+         * @return segments in the order of the file, invalid rows are skipped
+         */
+        std::vector<Segment> LoadEdges(const std::string &segmentsFile);
+
+        /**
+         * Read segments of an edges file without terminating the process, for callers that must survive invalid
+         * files
+         * @param in stream of the edges file, the header row is skipped
+         * @param segments is set to the valid segments in the order of the file
+         * @param log stream for errors
+         * @return false if any row is invalid, the invalid rows are reported and skipped
+         */
+        bool ReadEdges(std::istream &in, std::vector<Segment> &segments, std::ostream &log = std::cerr);
+
+        /**
+         * Single row of the batch manifest, a route and its departure time
+         */
+        struct BatchEntry {
+            std::string routeFile;
+            int startDay;
+            int startHour;
+            int startMinute;
+        };
+
+        /**
+         * Load the batch manifest
+         * @param manifestFile CSV file with a header and rows route edges file;day;hour;minute
+         * @return entries in the order of the file, invalid rows are skipped
+         */
+        std::vector<BatchEntry> LoadBatchManifest(const std::string &manifestFile);
+
+        /**
+         * Find speed profile files in the directory
+         * @param profilesDir directory with CSV files named <tmcid>_*.csv
+         * @return map of paths to the profile files indexed by segment ID
+         */
+        std::map<std::string, std::string> ListSpeedProfiles(const std::string &profilesDir);
+
+        /**
+         * Speed distributions of a single segment, up to maxLevels (speed, probability) pairs for every interval
+         * of the week
+         */
+        struct SpeedLevels {
+            int intervals = 0;
+            int maxLevels = 0;
+            std::vector<int> counts; // Number of used levels of every interval
+            std::vector<float> speeds; // Speeds in m/s, maxLevels values for every interval
+            std::vector<float> probabilities; // Probabilities, maxLevels values for every interval
+        };
+
+        /**
+         * Load speed distributions of a single segment from the supplied CSV file
+         * @param speedProfileFile path to the CSV file
+         * @param levels is set to the speed distributions, intervals without a valid distribution use freeflow speed
+         * @param freeflowSpeed default speed to be used when segment does not have a profile
+         * @param secondInterval is set to the length of the profile time interval in seconds
+         * @param log stream for errors and warnings, allows to collect messages of files loaded in parallel
+         * @return false if the file cannot be read, invalid rows are reported and skipped
+         */
+        bool LoadSpeedLevels(const std::string &speedProfileFile, SpeedLevels &levels, float freeflowSpeed,
+                             float &secondInterval, std::ostream &log = std::cerr);
+
+        /**
+         * Recover speed distributions from an expanded speed profile
+         * @param speedProfileData expanded profile, INDEX_RESOLUTION values for every interval
+         * @param intervals number of intervals of the week
+         * @param levels is set to the distinct speeds of every interval and their share of the expanded array
+         */
+        void CollapseSpeedProfile(const float *speedProfileData, int intervals, SpeedLevels &levels);
+
+        /**
+         * Expand speed distributions to INDEX_RESOLUTION values per interval, every speed is repeated
+         * proportionally to its probability
+         * @param levels speed distributions
+         * @param speedProfileData array of INDEX_RESOLUTION * levels.intervals values to store the profile in
+         * @param log stream for warnings
+         */
+        void ExpandSpeedLevels(const SpeedLevels &levels, float *speedProfileData, std::ostream &log = std::cerr);
+
+        /**
+         * @param maxLevels maximum number of speeds in an interval
+         * @return number of columns of the alias tables, power of two of at least 2
+         */
+        int AliasColumns(int maxLevels);
+
+        /**
+         * Build Walker alias table of every interval. A 32-bit random word selects the column by its top bits, the
+         * remaining bits are compared with the column threshold to choose between the speed and the alias speed.
+         * @param levels speed distributions
+         * @param columns number of columns, see AliasColumns
+         * @param aliasTable array of columns * ALIAS_ENTRY_SIZE * levels.intervals values to store the tables in
+         */
+        void BuildAliasTables(const SpeedLevels &levels, int columns, float *aliasTable);
+
+        /**
+         * Load single speed profile from the supplied CSV file
+         * @param speedProfileFile path to the CSV file
+         * @param speedProfileData pointer to the beginning of memory to store the profile data in
+         * @param freeflowSpeed default speed to be used when segment does not have a profile
+         * @param secondInterval is set to the length of the profile time interval in seconds
+         * @param log stream for errors and warnings
+         * @return false if the file cannot be read, speedProfileData is then set to nullptr
+         */
+        bool LoadSpeedProfile(const std::string &speedProfileFile, float **speedProfileData, float freeflowSpeed,
+                              float &secondInterval, std::ostream &log = std::cerr);
+
+        /**
+         * Write the edges file read by LoadEdges
+         * @param segmentsFile path to write
+         * @param segments segments in the order of the route
+         * @return false if the file cannot be written
+         */
+        bool WriteEdges(const std::string &segmentsFile, const std::vector<Segment> &segments);
+
+        /**
+         * Write speed distributions of a single segment as a CSV file read by LoadSpeedLevels, speeds are converted
+         * to km/h and unused levels are written as NaN
+         * @param speedProfileFile path to write
+         * @param levels speed distributions of every interval of the week
+         * @param secondInterval length of the profile time interval in seconds, divides or is a multiple of an hour
+         * @return false if the file cannot be written
+         */
+        bool WriteSpeedLevels(const std::string &speedProfileFile, const SpeedLevels &levels, int secondInterval);
+
         /**
          * Write result of a simulation for all departure times
          * @param result contains vector of travel times obtained from the simulation
@@ -13,6 +160,38 @@ namespace Routing {
          */
         void WriteResultAll(std::vector<float> &result, const std::string &file, int samples, float secondInterval);
 
+        /**
+         * Write header of the per-interval statistics of a week sweep
+         * @param out output stream
+         * @param percentiles percentile values written for every interval
+         */
+        void WriteIntervalSummaryHeader(std::ostream &out, const std::vector<float> &percentiles);
+
+        /**
+         * Write statistics of a single departure interval as one row
+         * @param out output stream
+         * @param day departure day (0-6)
+         * @param interval departure interval of the day
+         * @param stats statistics of the interval
+         */
+        void WriteIntervalSummary(std::ostream &out, int day, int interval, const ResultStats &stats);
+
+        /**
+         * Write header of the per-request statistics of a batch simulation
+         * @param out output stream
+         * @param percentiles percentile values written for every request
+         */
+        void WriteBatchSummaryHeader(std::ostream &out, const std::vector<float> &percentiles);
+
+        /**
+         * Write statistics of a single batch request as one row
+         * @param out output stream
+         * @param entry route and departure time of the request
+         * @param samples number of samples of the request
+         * @param stats statistics of the request
+         */
+        void WriteBatchSummary(std::ostream &out, const BatchEntry &entry, int samples, const ResultStats &stats);
+
         /**
        * Write result of a simulation for single departure time
        * @param result contains vector of travel times obtained from the simulation
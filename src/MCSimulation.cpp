@@ -3,93 +3,105 @@
 #include <iostream>
 #include <fstream>
 #include "CSVReader.h"
-#include <dirent.h>
+#include "Data.h"
+#include "NumaTopology.h"
+#include "ProfileCache.h"
+#include "ProfileDatabase.h"
+#include "RandomGenerator.h"
+#include "ResultStats.h"
+#include "Route.h"
+#include "SimdKernel.h"
+#include "SimulationCounters.h"
+#include <algorithm>
 #include <map>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
 
-#if defined USE_MKL || defined __INTEL_COMPILER // If we are using Intel compiler, MKL will be most certainly available as well
-#define INTEL_RND
-#include <mkl_vsl.h>
-#include <mkl.h>
-#else
-#define GNU_RND
-#include <random>
-#endif
-
-#define RANDS_PER_SEGMENT 5 // Margin of random numbers per segment generated
-#define PROFILE_FILE_NAME_SEP "_" // Separator in file names
-#define INDEX_RESOLUTION 100 // Size of the speed profile array
-
-Routing::MCSimulation::MCSimulation(const std::string segmentsFile, const std::string profilesDir) {
+Routing::MCSimulation::MCSimulation(const std::string segmentsFile, const std::string profilesDir,
+                                    ProfileLayout layout, ProfileStorage storage)
+        : m_layout(layout), m_storage(storage) {
+    LoadSegments(segmentsFile, profilesDir);
+}
 
-#ifdef INTEL_RND
-    std::cout << "RNG: Intel MKL";
-#else
-    std::cout << "RNG: GNU";
-#endif
-    std::cout << std::endl;
+Routing::MCSimulation::MCSimulation(const ProfileDatabase &database, const Route &route, ProfileLayout layout)
+        : m_layout(layout) {
+    SetRoute(database, route);
+}
 
-    LoadSegments(segmentsFile, profilesDir);
+Routing::MCSimulation::MCSimulation(const CachedRoute &route, ProfileLayout layout) : m_layout(layout) {
+    SetRoute(route);
 }
 
 Routing::MCSimulation::~MCSimulation() {
+    // Replicas are freed first, so the segment times are not placed again
+    m_numaMode = NumaMode::None;
+    m_counters = nullptr;
+    PlaceProfiles();
+
     if (m_lengths != nullptr)
         delete[] m_lengths;
 
     if (m_freeSpeeds != nullptr)
         delete[] m_freeSpeeds;
 
-    if (m_speedProfiles != nullptr) {
-        for (int i = 0; i < m_segmentCount; ++i) {
-            delete[] m_speedProfiles[i];
-        }
+    // Profiles are owned by the database or by the arena
+    if (m_speedProfiles != nullptr)
         delete[] m_speedProfiles;
-    }
+
+    if (m_profileArena != nullptr)
+        std::free(m_profileArena);
+
+    SetSegmentTimes(false);
+
+    if (m_ownedDatabase != nullptr)
+        delete m_ownedDatabase;
 }
 
 std::vector<float>
 Routing::MCSimulation::RunMonteCarloSimulation(int samples, int startDay, int startHour, int startMinute,
                                                bool all) const {
-    int intervalsPerDay = 86400 / m_secondInterval;
+    int intervals = 7 * static_cast<int>(86400 / m_secondInterval);
     std::vector<float> travelTimes;
+
+    // Seed of the run, counter based backend with fixed seed gives the same result for any thread count
+    uint64_t seed = RunSeed(0);
+
+    // Samples are simulated in blocks of kernel lanes
+    int lanes = Kernel::Lanes(m_kernel);
 #pragma omp parallel shared(travelTimes)
     {
         int tid = omp_get_thread_num();
-        int probsSize = m_segmentCount * RANDS_PER_SEGMENT;
-        int *probs = new int[probsSize];
-
-#ifdef INTEL_RND
-        VSLStreamStatePtr rndStream;
-        vslNewStream(&rndStream, VSL_BRNG_MT2203 + tid, std::rand());
-        std::cout<<"using intel"<<std::cout;
-#else
-        std::mt19937_64 rnd((unsigned long long) (std::rand() + tid));
-#endif
-
+        uint32_t *draws = new uint32_t[m_segmentCount * lanes];
+        RandomGenerator rnd(m_rngBackend, seed, tid);
+        SimulationCounters threadCounters;
+        SimulationCounters *counters = m_counters != nullptr ? &threadCounters : nullptr;
 
         if (all) {
 #pragma omp single
             {
-                travelTimes.resize(intervalsPerDay * 7 * samples);
+                travelTimes.resize(static_cast<std::size_t>(intervals) * samples);
             }
 
+            // Common random numbers, draws of a block are generated once and simulated for every departure
 #pragma omp for schedule(dynamic)
-            for (int s = 0; s < samples; ++s) {
-                for (int d = 0; d < 7; ++d) {
-                    for (int i = 0; i < intervalsPerDay; ++i) {
-
-#ifdef INTEL_RND
-                        viRngUniform(VSL_RNG_METHOD_UNIFORM_STD, rndStream, probsSize, probs, 0, INDEX_RESOLUTION);
-#else
-                        std::uniform_int_distribution<int> dist(0, INDEX_RESOLUTION - 1);
-                        for (int r = 0; r < probsSize; ++r) {
-                            probs[r] = dist(rnd);
-                        }
-#endif
-                        int secs = (d * 86400) + (i * 900);
-                        travelTimes[(d * intervalsPerDay * samples) + (i * samples) +
-                                    s] = Routing::MCSimulation::GetRandomTravelTime(secs, probs);
-                    }
+            for (int s = 0; s < samples; s += lanes) {
+                int count = std::min(lanes, samples - s);
+                {
+                    PhaseTimer timer(counters != nullptr ? &counters->rngSeconds : nullptr);
+                    FillDraws(rnd, draws, s, count, 0);
+                }
+                PhaseTimer timer(counters != nullptr ? &counters->simulateSeconds : nullptr);
+                for (int departure = 0; departure < intervals; ++departure) {
+                    int secs = static_cast<int>(departure * m_secondInterval);
+                    SimulateDraws(rnd, draws, s, count, secs, 0,
+                                  &travelTimes[(static_cast<std::size_t>(departure) * samples) + s]);
+                }
+                if (counters != nullptr) {
+                    counters->samples += static_cast<uint64_t>(count) * intervals;
+                    counters->segments += static_cast<uint64_t>(count) * intervals * m_segmentCount;
+                    counters->remoteSegments += RemoteFraction() * count * intervals * m_segmentCount;
                 }
             }
         } else {
@@ -98,66 +110,687 @@ Routing::MCSimulation::RunMonteCarloSimulation(int samples, int startDay, int st
                 travelTimes.resize(samples);
             }
 
+            int secs = (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
 #pragma omp for schedule(dynamic)
-            for (int s = 0; s < samples; ++s) {
-#ifdef INTEL_RND
-                viRngUniform(VSL_RNG_METHOD_UNIFORM_STD, rndStream, probsSize, probs, 0, INDEX_RESOLUTION);
-#else
-                std::uniform_int_distribution<int> dist(0, INDEX_RESOLUTION - 1);
-                for (int r = 0; r < probsSize; ++r) {
-                    probs[r] = dist(rnd);
-                }
-#endif
-
-                int secs = (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
-                travelTimes[s] = Routing::MCSimulation::GetRandomTravelTime(secs, probs);
+            for (int s = 0; s < samples; s += lanes) {
+                SimulateSamples(rnd, draws, s, std::min(lanes, samples - s), secs, 0, &travelTimes[s], counters);
             }
         }
 
-        delete[] probs;
+        FlushCounters(counters, rnd);
+        delete[] draws;
     }
     return travelTimes;
 }
 
+void Routing::MCSimulation::RunMonteCarloSimulation(int samples, int startDay, int startHour, int startMinute,
+                                                    QuantileSketch &sketch, int firstSample) const {
+    uint64_t seed = RunSeed(firstSample);
+    int secs = (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
+
+    int lanes = Kernel::Lanes(m_kernel);
+#pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        uint32_t *draws = new uint32_t[m_segmentCount * lanes];
+        float travelTimes[SIMD_KERNEL_MAX_LANES];
+        RandomGenerator rnd(m_rngBackend, seed, tid);
+        QuantileSketch threadSketch(sketch.GetRelativeError());
+        SimulationCounters threadCounters;
+        SimulationCounters *counters = m_counters != nullptr ? &threadCounters : nullptr;
+
+#pragma omp for schedule(dynamic)
+        for (int s = 0; s < samples; s += lanes) {
+            int count = std::min(lanes, samples - s);
+            SimulateSamples(rnd, draws, firstSample + s, count, secs, 0, travelTimes, counters);
+            for (int l = 0; l < count; ++l) {
+                threadSketch.Add(travelTimes[l]);
+            }
+        }
+
+#pragma omp critical
+        {
+            sketch.Merge(threadSketch);
+        }
+
+        FlushCounters(counters, rnd);
+        delete[] draws;
+    }
+}
+
+void Routing::MCSimulation::ExtendSimulation(std::vector<float> &travelTimes, int samples, int startDay,
+                                             int startHour, int startMinute) const {
+    int firstSample = static_cast<int>(travelTimes.size());
+    if (samples <= 0)
+        return;
+    travelTimes.resize(firstSample + samples);
+
+    uint64_t seed = RunSeed(firstSample);
+    int secs = (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
+    int lanes = Kernel::Lanes(m_kernel);
+#pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        uint32_t *draws = new uint32_t[m_segmentCount * lanes];
+        RandomGenerator rnd(m_rngBackend, seed, tid);
+        SimulationCounters threadCounters;
+        SimulationCounters *counters = m_counters != nullptr ? &threadCounters : nullptr;
+
+#pragma omp for schedule(dynamic)
+        for (int s = 0; s < samples; s += lanes) {
+            SimulateSamples(rnd, draws, firstSample + s, std::min(lanes, samples - s), secs, 0,
+                            &travelTimes[firstSample + s], counters);
+        }
+
+        FlushCounters(counters, rnd);
+        delete[] draws;
+    }
+}
+
+void Routing::MCSimulation::SimulateChunk(int firstSample, int samples, int startSeconds, float *travelTimes) const {
+    RandomGenerator rnd(m_rngBackend, RunSeed(firstSample), 0);
+    int lanes = Kernel::Lanes(m_kernel);
+    uint32_t *draws = new uint32_t[m_segmentCount * lanes];
+    SimulationCounters chunkCounters;
+    SimulationCounters *counters = m_counters != nullptr ? &chunkCounters : nullptr;
+    for (int s = 0; s < samples; s += lanes) {
+        SimulateSamples(rnd, draws, firstSample + s, std::min(lanes, samples - s), startSeconds, 0, travelTimes + s,
+                        counters);
+    }
+    FlushCounters(counters, rnd);
+    delete[] draws;
+}
+
 std::vector<float>
-Routing::MCSimulation::ComputeOptimalTravelTime(int startDay, int startHour, int startMinute, bool all) const {
-    int intervalsPerDay = 86400 / m_secondInterval;
+Routing::MCSimulation::RunAdaptiveSimulation(int maxSamples, int startDay, int startHour, int startMinute,
+                                             double targetError, const std::vector<float> &percentiles,
+                                             int minSamples) const {
     std::vector<float> travelTimes;
-    if (all) {
-#pragma omp parallel shared(travelTimes)
+    std::vector<float> sorted;
+    int next = std::min(minSamples, maxSamples);
+    while (true) {
+        ExtendSimulation(travelTimes, next - static_cast<int>(travelTimes.size()), startDay, startHour, startMinute);
+        int taken = static_cast<int>(travelTimes.size());
+        if (taken >= maxSamples)
+            break;
+
+        double error;
         {
-#pragma omp single
+            PhaseTimer timer(m_counters != nullptr ? &m_counters->statsSeconds : nullptr);
+            sorted = travelTimes;
+            std::sort(sorted.begin(), sorted.end());
+            error = ResultStats::PercentileError(sorted, percentiles);
+        }
+        if (error <= targetError)
+            break;
+
+        // Standard error decreases with the square root of the sample count, growth per chunk is bounded as the
+        // estimate of few samples is rough
+        double ratio = error / targetError;
+        double predicted = std::ceil(taken * ratio * ratio * ADAPTIVE_SAMPLING_MARGIN);
+        next = static_cast<int>(std::min(predicted, static_cast<double>(taken) * ADAPTIVE_SAMPLING_MAX_GROWTH));
+        next = std::min(std::max(next, taken + Kernel::Lanes(m_kernel)), maxSamples);
+    }
+    return travelTimes;
+}
+
+void Routing::MCSimulation::SweepWeek(int samples, const std::vector<float> &percentiles, double relativeError,
+                                      const std::function<void(int, int, const ResultStats &)> &consumer) const {
+    int intervalsPerDay = 86400 / m_secondInterval;
+    uint64_t seed = RunSeed(0);
+
+    int lanes = Kernel::Lanes(m_kernel);
+#pragma omp parallel
+    {
+        uint32_t *draws = new uint32_t[m_segmentCount * lanes];
+        SimulationCounters threadCounters;
+        SimulationCounters *counters = m_counters != nullptr ? &threadCounters : nullptr;
+
+        // Exact statistics need all samples of the interval, the sketch only a single block
+        std::vector<float> travelTimes(relativeError > 0.0 ? lanes : samples);
+
+        // Dynamic schedule hands out intervals in order, a finished interval waits only for the previous ones
+#pragma omp for schedule(dynamic) ordered
+        for (int departure = 0; departure < 7 * intervalsPerDay; ++departure) {
+            int secs = static_cast<int>(departure * m_secondInterval);
+            // Fresh generator of the first stream gives the interval the same random numbers as the other ones
+            RandomGenerator rnd(m_rngBackend, seed, 0);
+            if (relativeError > 0.0) {
+                QuantileSketch sketch(relativeError);
+                for (int s = 0; s < samples; s += lanes) {
+                    int count = std::min(lanes, samples - s);
+                    SimulateSamples(rnd, draws, s, count, secs, 0, travelTimes.data(), counters);
+                    for (int l = 0; l < count; ++l) {
+                        sketch.Add(travelTimes[l]);
+                    }
+                }
+                ResultStats stats = [&]() {
+                    PhaseTimer timer(counters != nullptr ? &counters->statsSeconds : nullptr);
+                    return ResultStats(sketch, percentiles);
+                }();
+#pragma omp ordered
+                {
+                    PhaseTimer timer(counters != nullptr ? &counters->writeSeconds : nullptr);
+                    consumer(departure / intervalsPerDay, departure % intervalsPerDay, stats);
+                }
+                FlushCounters(counters, rnd);
+            } else {
+                for (int s = 0; s < samples; s += lanes) {
+                    SimulateSamples(rnd, draws, s, std::min(lanes, samples - s), secs, 0, &travelTimes[s], counters);
+                }
+                ResultStats stats = [&]() {
+                    PhaseTimer timer(counters != nullptr ? &counters->statsSeconds : nullptr);
+                    return ResultStats(travelTimes, percentiles);
+                }();
+#pragma omp ordered
+                {
+                    PhaseTimer timer(counters != nullptr ? &counters->writeSeconds : nullptr);
+                    consumer(departure / intervalsPerDay, departure % intervalsPerDay, stats);
+                }
+                FlushCounters(counters, rnd);
+            }
+        }
+
+        delete[] draws;
+    }
+}
+
+void Routing::MCSimulation::SweepWeekSamples(int samples,
+                                             const std::function<void(int, int, const float *)> &consumer) const {
+    int intervalsPerDay = 86400 / m_secondInterval;
+    uint64_t seed = RunSeed(0);
+
+    int lanes = Kernel::Lanes(m_kernel);
+#pragma omp parallel
+    {
+        uint32_t *draws = new uint32_t[m_segmentCount * lanes];
+        SimulationCounters threadCounters;
+        SimulationCounters *counters = m_counters != nullptr ? &threadCounters : nullptr;
+        std::vector<float> travelTimes(samples);
+
+#pragma omp for schedule(dynamic) ordered
+        for (int departure = 0; departure < 7 * intervalsPerDay; ++departure) {
+            int secs = static_cast<int>(departure * m_secondInterval);
+            RandomGenerator rnd(m_rngBackend, seed, 0);
+            for (int s = 0; s < samples; s += lanes) {
+                SimulateSamples(rnd, draws, s, std::min(lanes, samples - s), secs, 0, &travelTimes[s], counters);
+            }
+#pragma omp ordered
             {
-                travelTimes.resize(intervalsPerDay * 7);
+                PhaseTimer timer(counters != nullptr ? &counters->writeSeconds : nullptr);
+                consumer(departure / intervalsPerDay, departure % intervalsPerDay, travelTimes.data());
             }
+            FlushCounters(counters, rnd);
+        }
 
-#pragma omp for schedule(dynamic)
-            for (int d = 0; d < 7; ++d) {
-                for (int i = 0; i < intervalsPerDay; ++i) {
-                    int secs = (d * 86400) + (i * 900);
-                    travelTimes[(d * intervalsPerDay) + i] = Routing::MCSimulation::GetOptimalTravelTime(secs);
-                }
+        delete[] draws;
+    }
+}
+
+uint64_t Routing::MCSimulation::RunSeed(int firstSample) const {
+    uint64_t seed = m_hasSeed ? m_seed : static_cast<uint64_t>(std::rand());
+    // Counter based draws already differ by the sample number, stream generators would restart the same sequence
+    if (m_rngBackend != RngBackend::Philox && firstSample != 0)
+        seed ^= static_cast<uint64_t>(firstSample) * 0x9E3779B97F4A7C15ULL;
+    return seed;
+}
+
+void Routing::MCSimulation::SimulateSamples(RandomGenerator &rnd, uint32_t *draws, int firstSample, int count,
+                                            int startSeconds, int departure, float *travelTimes,
+                                            SimulationCounters *counters) const {
+    double *rngSeconds = counters != nullptr ? &counters->rngSeconds : nullptr;
+    double *simulateSeconds = counters != nullptr ? &counters->simulateSeconds : nullptr;
+    if (m_kernel != SimulationKernel::Scalar && count == Kernel::Lanes(m_kernel)) {
+        // Full block is simulated by the vector kernel
+        {
+            PhaseTimer timer(rngSeconds);
+            FillDraws(rnd, draws, firstSample, count, departure);
+        }
+        PhaseTimer timer(simulateSeconds);
+        SimulateDraws(rnd, draws, firstSample, count, startSeconds, departure, travelTimes);
+    } else {
+        Kernel::RouteView route = LocalRoute();
+        for (int l = 0; l < count; ++l) {
+            {
+                PhaseTimer timer(rngSeconds);
+                rnd.Fill(draws, m_segmentCount, firstSample + l, departure);
             }
+            PhaseTimer timer(simulateSeconds);
+            travelTimes[l] = GetRandomTravelTime(route, startSeconds, draws, rnd, firstSample + l, departure);
+        }
+    }
+
+    if (counters != nullptr) {
+        counters->samples += count;
+        counters->segments += static_cast<uint64_t>(count) * m_segmentCount;
+        counters->remoteSegments += RemoteFraction() * count * m_segmentCount;
+    }
+}
+
+void Routing::MCSimulation::FlushCounters(SimulationCounters *counters, const RandomGenerator &rnd) const {
+    if (counters == nullptr)
+        return;
+
+    // Every traversed segment uses its first word, every crossing one more
+    counters->crossings += rnd.GetCrossingDraws();
+    counters->wordsConsumed += counters->segments + rnd.GetCrossingDraws();
+    counters->wordsGenerated += rnd.GetWordsGenerated();
+#pragma omp critical(simulation_counters)
+    {
+        m_counters->Merge(*counters);
+    }
+    *counters = SimulationCounters();
+}
+
+void Routing::MCSimulation::FillDraws(RandomGenerator &rnd, uint32_t *draws, int firstSample, int count,
+                                      int departure) const {
+    for (int l = 0; l < count; ++l) {
+        rnd.Fill(draws + (l * m_segmentCount), m_segmentCount, firstSample + l, departure);
+    }
+}
+
+void Routing::MCSimulation::SimulateDraws(RandomGenerator &rnd, const uint32_t *draws, int firstSample, int count,
+                                          int startSeconds, int departure, float *travelTimes) const {
+    if (m_kernel != SimulationKernel::Scalar && count == Kernel::Lanes(m_kernel)) {
+        int starts[SIMD_KERNEL_MAX_LANES];
+        uint32_t sampleIds[SIMD_KERNEL_MAX_LANES];
+        for (int l = 0; l < count; ++l) {
+            starts[l] = startSeconds;
+            sampleIds[l] = firstSample + l;
         }
+        Kernel::TravelTimes(m_kernel, LocalRoute(), starts, draws, rnd, sampleIds, departure, travelTimes);
     } else {
-        travelTimes.resize(1);
+        Kernel::RouteView route = LocalRoute();
+        for (int l = 0; l < count; ++l) {
+            travelTimes[l] = GetRandomTravelTime(route, startSeconds, draws + (l * m_segmentCount), rnd,
+                                                 firstSample + l, departure);
+        }
+    }
+}
+
+void Routing::MCSimulation::SetKernel(SimulationKernel kernel) {
+    if (!Kernel::IsSupported(kernel)) {
+        std::cerr << "WARNING: Kernel " << Kernel::Name(kernel) << " is not supported by the CPU, using "
+                  << Kernel::Name(Kernel::Best()) << std::endl;
+        kernel = Kernel::Best();
+    }
+
+    // Profiles of long routes with short intervals are beyond the 32-bit indexes of the gathers
+    int intervalsPerWeek = m_secondInterval > 0 ? 7 * static_cast<int>(86400 / m_secondInterval) : 0;
+    if (kernel != SimulationKernel::Scalar && !Kernel::FitsGatherIndex(intervalsPerWeek, m_intervalStride)) {
+        std::cerr << "WARNING: Profiles of the route are too large for kernel " << Kernel::Name(kernel)
+                  << ", using " << Kernel::Name(SimulationKernel::Scalar) << std::endl;
+        kernel = SimulationKernel::Scalar;
+    }
+    m_kernel = kernel;
+}
+
+void Routing::MCSimulation::SetRngBackend(RngBackend backend) {
+    m_rngBackend = backend;
+}
+
+void Routing::MCSimulation::SetCounters(SimulationCounters *counters) {
+    m_counters = counters;
+    if (m_counters != nullptr)
+        MeasurePlacement();
+}
+
+void Routing::MCSimulation::SetSegmentTimes(bool enabled) {
+    if (m_segmentTimes != nullptr) {
+        delete[] m_segmentTimes;
+        std::free(m_timeArena);
+        m_segmentTimes = nullptr;
+        m_timeArena = nullptr;
+    }
+
+    if (enabled && m_segmentCount > 0) {
+        // Same layout as the profiles, so the kernels find the time of a speed at the offset of the speed
+        int intervalsPerWeek = 7 * static_cast<int>(86400 / m_secondInterval);
+        std::size_t arenaSize = sizeof(float) * ArenaSize();
+        void *arena = nullptr;
+        if (posix_memalign(&arena, 64, arenaSize) != 0) {
+            std::cerr << "ERROR: Cannot allocate " << arenaSize << " bytes for the segment times" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        m_timeArena = static_cast<float *>(arena);
+        m_segmentTimes = new const float *[m_segmentCount];
+        for (int i = 0; i < m_segmentCount; ++i) {
+            m_segmentTimes[i] = m_timeArena + ArenaOffset(i);
+        }
+
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < m_segmentCount; ++i) {
+            float length = static_cast<float>(m_lengths[i]);
+            float *times = const_cast<float *>(m_segmentTimes[i]);
+            for (int t = 0; t < intervalsPerWeek; ++t) {
+                const float *speeds = m_speedProfiles[i] + (static_cast<std::size_t>(t) * m_intervalStride);
+                float *intervalTimes = times + (static_cast<std::size_t>(t) * m_intervalStride);
+                for (int j = 0; j < m_intervalSize; ++j) {
+                    // Thresholds of the alias columns are kept
+                    bool threshold = m_aliasShift != 0 && j % ALIAS_ENTRY_SIZE == 0;
+                    intervalTimes[j] = threshold ? speeds[j] : length / speeds[j];
+                }
+            }
+        }
+    }
+
+    // Replicas hold copies of the previous times
+    if (m_numaMode != NumaMode::None)
+        PlaceProfiles();
+    if (m_counters != nullptr)
+        MeasurePlacement();
+}
+
+void Routing::MCSimulation::SetNumaMode(NumaMode mode) {
+    m_numaMode = mode;
+    PlaceProfiles();
+    if (m_counters != nullptr)
+        MeasurePlacement();
+}
+
+std::size_t Routing::MCSimulation::ArenaOffset(int segment) const {
+    if (m_layout == ProfileLayout::IntervalMajor)
+        return static_cast<std::size_t>(segment) * m_intervalSize;
+    int intervalsPerWeek = 7 * static_cast<int>(86400 / m_secondInterval);
+    return static_cast<std::size_t>(segment) * intervalsPerWeek * m_intervalSize;
+}
+
+std::size_t Routing::MCSimulation::ArenaSize() const {
+    int intervalsPerWeek = 7 * static_cast<int>(86400 / m_secondInterval);
+    return static_cast<std::size_t>(m_segmentCount) * intervalsPerWeek * m_intervalSize;
+}
+
+void Routing::MCSimulation::PlaceProfiles() {
+    for (const auto &replica : m_replicas) {
+        delete[] replica.speedProfiles;
+        if (replica.segmentTimes != nullptr)
+            delete[] replica.segmentTimes;
+        munmap(replica.arena, replica.bytes);
+    }
+    m_replicas.clear();
+    if (m_numaMode == NumaMode::None || m_segmentCount < 1)
+        return;
+
+    const NumaTopology &topology = NumaTopology::Get();
+    int intervalsPerWeek = 7 * static_cast<int>(86400 / m_secondInterval);
+    std::size_t arenaSize = ArenaSize();
+    int copies = m_numaMode == NumaMode::Replicate ? topology.GetNodeCount() : 1;
+    for (int node = 0; node < copies; ++node) {
+        // Fresh mapping, pages of a reused heap block would already be placed
+        Replica replica;
+        replica.bytes = sizeof(float) * arenaSize * (m_segmentTimes != nullptr ? 2 : 1);
+        void *memory = mmap(nullptr, replica.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            std::cerr << "ERROR: Cannot map " << replica.bytes << " bytes for the profile replica" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        topology.Place(memory, replica.bytes, m_numaMode == NumaMode::Replicate ? node : -1);
+
+        replica.arena = static_cast<float *>(memory);
+        replica.speedProfiles = new const float *[m_segmentCount];
+        replica.segmentTimes = m_segmentTimes != nullptr ? new const float *[m_segmentCount] : nullptr;
+        for (int i = 0; i < m_segmentCount; ++i) {
+            replica.speedProfiles[i] = replica.arena + ArenaOffset(i);
+            if (replica.segmentTimes != nullptr)
+                replica.segmentTimes[i] = replica.arena + arenaSize + ArenaOffset(i);
+        }
+
+        // Pages are already placed, so the copy may be made by any thread
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < m_segmentCount; ++i) {
+            for (int t = 0; t < intervalsPerWeek; ++t) {
+                std::size_t offset = static_cast<std::size_t>(t) * m_intervalStride;
+                std::memcpy(const_cast<float *>(replica.speedProfiles[i]) + offset, m_speedProfiles[i] + offset,
+                            sizeof(float) * m_intervalSize);
+                if (replica.segmentTimes != nullptr)
+                    std::memcpy(const_cast<float *>(replica.segmentTimes[i]) + offset, m_segmentTimes[i] + offset,
+                                sizeof(float) * m_intervalSize);
+            }
+        }
+        m_replicas.push_back(replica);
+    }
+}
+
+void Routing::MCSimulation::MeasurePlacement() {
+    const NumaTopology &topology = NumaTopology::Get();
+    int nodes = topology.GetNodeCount();
+    m_remoteFractions.assign(nodes, 0.0);
+    if (nodes < 2 || m_segmentCount < 1)
+        return;
+
+    // Reads are sampled over the segments and the intervals of the week, whole segments read the segment times
+    int intervalsPerWeek = 7 * static_cast<int>(86400 / m_secondInterval);
+    std::size_t reads = static_cast<std::size_t>(m_segmentCount) * intervalsPerWeek;
+    std::size_t step = std::max(static_cast<std::size_t>(1), reads / NUMA_PLACEMENT_SAMPLES);
+    int copies = m_replicas.empty() ? 1 : static_cast<int>(m_replicas.size());
+    std::vector<const void *> addresses;
+    std::vector<int> placement;
+    for (int copy = 0; copy < copies; ++copy) {
+        const float *const *profiles = m_replicas.empty() ? m_speedProfiles : m_replicas[copy].speedProfiles;
+        const float *const *times = m_replicas.empty() ? m_segmentTimes : m_replicas[copy].segmentTimes;
+        addresses.clear();
+        for (std::size_t r = 0; r < reads; r += step) {
+            int s = static_cast<int>(r % m_segmentCount);
+            std::size_t offset = (r / m_segmentCount) * m_intervalStride;
+            addresses.push_back((times != nullptr ? times[s] : profiles[s]) + offset);
+        }
+        topology.GetNodesOfAddresses(addresses, placement);
+
+        // Every node reads the single copy, a replica is read by its node only, pages of unknown node count as remote
+        for (int node = 0; node < nodes; ++node) {
+            if (m_numaMode == NumaMode::Replicate && !m_replicas.empty() && node != copy)
+                continue;
+            std::size_t remote = std::count_if(placement.begin(), placement.end(),
+                                               [node](int pageNode) { return pageNode != node; });
+            m_remoteFractions[node] = static_cast<double>(remote) / placement.size();
+        }
+    }
+}
+
+double Routing::MCSimulation::RemoteFraction() const {
+    if (m_remoteFractions.size() < 2)
+        return 0.0;
+    return m_remoteFractions[NumaTopology::Get().GetCurrentNode()];
+}
+
+Routing::Kernel::RouteView Routing::MCSimulation::LocalRoute() const {
+    Kernel::RouteView route = {m_segmentCount, m_lengths, m_speedProfiles, m_intervalStride, m_secondInterval,
+                               m_aliasShift, m_segmentTimes};
+    if (!m_replicas.empty()) {
+        // Node is looked up for every block, a migrated thread continues with the replica of its new node
+        const Replica &replica = m_replicas[m_replicas.size() > 1 ? NumaTopology::Get().GetCurrentNode() : 0];
+        route.speedProfiles = replica.speedProfiles;
+        route.segmentTimes = replica.segmentTimes;
+    }
+    return route;
+}
+
+void Routing::MCSimulation::SetSeed(uint64_t seed) {
+    m_seed = seed;
+    m_hasSeed = true;
+}
+
+std::vector<float>
+Routing::MCSimulation::ComputeOptimalTravelTime(int startDay, int startHour, int startMinute, bool all) const {
+    if (m_speedProfiles == nullptr || m_lengths == nullptr) {
+        std::cerr << "ERROR: Profiles or segments missing" << std::endl;
+        return {};
+    }
+
+    if (!all) {
         int secs = (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
-        travelTimes[0] = Routing::MCSimulation::GetOptimalTravelTime(secs);
+        std::vector<float> travelTimes(1);
+        OptimalTravelTimes(&secs, 1, travelTimes.data());
+        return travelTimes;
+    }
+
+    int intervals = 7 * static_cast<int>(86400 / m_secondInterval);
+    std::vector<float> travelTimes(intervals);
+#pragma omp parallel for schedule(dynamic)
+    for (int first = 0; first < intervals; first += OPTIMAL_SWEEP_BLOCK) {
+        int starts[OPTIMAL_SWEEP_BLOCK];
+        int count = std::min(OPTIMAL_SWEEP_BLOCK, intervals - first);
+        for (int i = 0; i < count; ++i) {
+            starts[i] = static_cast<int>((first + i) * m_secondInterval);
+        }
+        OptimalTravelTimes(starts, count, &travelTimes[first]);
     }
     return travelTimes;
 }
 
-float Routing::MCSimulation::GetRandomTravelTime(int startSeconds, int *probs) const {
-    int pIdx = 0;
+float Routing::MCSimulation::ComputeFreeFlowTravelTime() const {
+    float travelTime = 0.0f;
+    for (int s = 0; s < m_segmentCount; ++s) {
+        travelTime += m_lengths[s] / m_freeSpeeds[s];
+    }
+    return travelTime;
+}
+
+bool Routing::MCSimulation::ConvolveHistograms(int startDay, int startHour, int startMinute,
+                                               TravelTimeHistogram &histogram, std::size_t maxBins) const {
+    if (m_speedProfiles == nullptr || m_lengths == nullptr) {
+        std::cerr << "ERROR: Profiles or segments missing" << std::endl;
+        return false;
+    }
+
+    // Runs of several routes may be convolved concurrently, the time is merged as the counters of the samples
+    int secs = (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
+    SimulationCounters counters;
+    bool complete = [&]() {
+        PhaseTimer timer(m_counters != nullptr ? &counters.simulateSeconds : nullptr);
+        histogram.Clear();
+        histogram.Add(0.0, 1.0);
+        TravelTimeHistogram next(histogram.GetBinSeconds());
+        std::map<int, std::vector<std::pair<float, float>>> levels;
+        for (int s = 0; s < m_segmentCount; ++s) {
+            next.Clear();
+            levels.clear();
+            for (std::size_t b = 0; b < histogram.GetBinCount(); ++b) {
+                double probability = histogram.GetBinMass(b);
+                if (probability > 0.0)
+                    ConvolveSegment(s, secs, histogram.GetBinValue(b), probability, m_lengths[s], levels, next);
+            }
+            next.Trim();
+            std::swap(histogram, next);
+            if (histogram.GetBinCount() > maxBins)
+                return false;
+        }
+        return true;
+    }();
+
+    if (m_counters != nullptr) {
+#pragma omp critical(simulation_counters)
+        {
+            m_counters->Merge(counters);
+        }
+    }
+    return complete;
+}
+
+float Routing::MCSimulation::GetSecondInterval() const {
+    return m_secondInterval;
+}
+
+int Routing::MCSimulation::GetSegmentCount() const {
+    return m_segmentCount;
+}
+
+void Routing::MCSimulation::ConvolveSegment(int segment, int startSeconds, double travelTime, double probability,
+                                            double remainingLength,
+                                            std::map<int, std::vector<std::pair<float, float>>> &levels,
+                                            TravelTimeHistogram &histogram) const {
+    int intervals = 7 * static_cast<int>(86400 / m_secondInterval);
+    double currentSeconds = std::fmod(startSeconds + travelTime, 604800.0);
+    int interval = std::min(static_cast<int>(currentSeconds / m_secondInterval), intervals - 1);
+    auto it = levels.find(interval);
+    if (it == levels.end()) {
+        it = levels.insert({interval, {}}).first;
+        IntervalLevels(segment, interval, it->second);
+    }
+
+    double secsToNext = (interval + 1) * static_cast<double>(m_secondInterval) - currentSeconds;
+    for (const auto &level : it->second) {
+        // Invalid speed would never leave the segment, the simulation gives infinite travel time
+        if (!(level.first > 0.0f))
+            continue;
+
+        double time = remainingLength / level.first;
+        if (time < secsToNext) {
+            histogram.Add(travelTime + time, probability * level.second);
+        } else {
+            // Rest of the segment at a speed drawn from the next interval
+            ConvolveSegment(segment, startSeconds, travelTime + secsToNext, probability * level.second,
+                            remainingLength - level.first * secsToNext, levels, histogram);
+        }
+    }
+}
+
+void Routing::MCSimulation::IntervalLevels(int segment, int interval,
+                                           std::vector<std::pair<float, float>> &levels) const {
+    const float *profile = m_speedProfiles[segment] + (interval * m_intervalStride);
+    auto add = [&levels](float speed, float probability) {
+        if (probability <= 0.0f)
+            return;
+        auto it = std::find_if(levels.begin(), levels.end(),
+                               [speed](const std::pair<float, float> &level) { return level.first == speed; });
+        if (it != levels.end())
+            it->second += probability;
+        else
+            levels.emplace_back(speed, probability);
+    };
+
+    levels.clear();
+    if (m_aliasShift == 0) {
+        // Every value of the expanded profile is selected by the same share of the random words
+        for (int i = 0; i < INDEX_RESOLUTION; ++i) {
+            add(profile[i], 1.0f / INDEX_RESOLUTION);
+        }
+    } else {
+        // Column is selected uniformly, its threshold splits it between the speed and the alias speed
+        int columns = 1 << m_aliasShift;
+        for (int c = 0; c < columns; ++c) {
+            const float *entry = profile + (c * ALIAS_ENTRY_SIZE);
+            float threshold = std::min(std::max(entry[0] / ALIAS_THRESHOLD_SCALE, 0.0f), 1.0f);
+            add(entry[1], threshold / columns);
+            add(entry[2], (1.0f - threshold) / columns);
+        }
+    }
+}
+
+float Routing::MCSimulation::GetRandomTravelTime(const Kernel::RouteView &route, int startSeconds,
+                                                 const uint32_t *draws, RandomGenerator &rnd, uint32_t sample,
+                                                 uint32_t departure) const {
+    const float *const *speedProfiles = route.speedProfiles;
+    const float *const *segmentTimes = route.segmentTimes;
     float totalTravelTime = 0;
     float currentSeconds = static_cast<float>(startSeconds);
     for (int s = 0; s < m_segmentCount; ++s) {
         float remainingLength = m_lengths[s];
+        int crossing = 0;
         while (remainingLength > 0) {
             int currentInterval = currentSeconds / m_secondInterval;
-            int idx = (currentInterval * INDEX_RESOLUTION) + probs[pIdx++];
-            float velocity = m_speedProfiles[s][idx];
-            float currentTravelTime = remainingLength / velocity; // Rounded to seconds
+            // First word of the segment is generated in advance, crossings draw on demand
+            uint32_t draw = crossing == 0 ? draws[s] : rnd.Draw(sample, departure, s, crossing);
+            bool whole = crossing == 0 && segmentTimes != nullptr;
+            crossing++;
+            const float *const *profiles = segmentTimes != nullptr ? segmentTimes : speedProfiles;
+
+            // Next segment is most likely entered in the same interval
+            if (s + 1 < m_segmentCount)
+                __builtin_prefetch(profiles[s + 1] + (currentInterval * m_intervalStride) +
+                                   Kernel::ProfileOffset(draws[s + 1], m_aliasShift));
+
+            // Time of the whole segment is precomputed, the speed is needed only when leaving the interval
+            float velocity = 0.0f;
+            float currentTravelTime;
+            if (whole) {
+                currentTravelTime = Kernel::SampleSpeed(segmentTimes[s] + (currentInterval * m_intervalStride), draw,
+                                                        m_aliasShift);
+            } else {
+                velocity = Kernel::SampleSpeed(speedProfiles[s] + (currentInterval * m_intervalStride), draw,
+                                               m_aliasShift);
+                currentTravelTime = remainingLength / velocity; // Rounded to seconds
+            }
             float newSeconds = currentSeconds + currentTravelTime;
             int newInterval = newSeconds / m_secondInterval;
 
@@ -165,6 +798,9 @@ float Routing::MCSimulation::GetRandomTravelTime(int startSeconds, int *probs) c
             // Suggest via builtin_expect that this condition will be false in most cases (based on the data)
             if (__builtin_expect(newInterval != currentInterval, 0)) {
                 // If not, compute distance travelled in time remaining to next interval
+                if (whole)
+                    velocity = Kernel::SampleSpeed(speedProfiles[s] + (currentInterval * m_intervalStride), draw,
+                                                   m_aliasShift);
                 int secsToNext = ((currentInterval + 1) * m_secondInterval) - currentSeconds;
                 remainingLength -= (velocity * secsToNext);
                 totalTravelTime += secsToNext;
@@ -189,203 +825,175 @@ float Routing::MCSimulation::GetRandomTravelTime(int startSeconds, int *probs) c
     return totalTravelTime;
 }
 
-void Routing::MCSimulation::LoadSpeedProfile(const std::string speedProfileFile, float **speedProfileData,
-                                             float freeflowSpeed) {
-    const float oneDiv3point6 = 1 / 3.6; // For conversion of km/h to m/s
-    std::ifstream profileFileStream(speedProfileFile);
-    if (!profileFileStream.is_open()) {
-        std::cerr << "ERROR: Cannot open profile file " << speedProfileFile << std::endl;
+void Routing::MCSimulation::LoadSegments(const std::string segmentsFile, const std::string profilesDir) {
+    // Private database holding only the segments of this route
+    m_ownedDatabase = new ProfileDatabase(profilesDir, {segmentsFile}, m_storage);
+    SetRoute(*m_ownedDatabase, Route(*m_ownedDatabase, segmentsFile));
+
+    // Profiles were copied to the arena, the parsed ones are not needed anymore
+    if (m_layout != ProfileLayout::Shared) {
+        delete m_ownedDatabase;
+        m_ownedDatabase = nullptr;
     }
+}
 
-    CSVReader row('|');
-
-    // Get intervals from first two rows of the file
-    std::vector<int> hours(2);
-    std::vector<int> min(2);
+void Routing::MCSimulation::SetRoute(const ProfileDatabase &database, const Route &route) {
+    const std::vector<int> &segments = route.GetSegments();
+    m_secondInterval = database.GetSecondInterval();
+    m_segmentCount = segments.size();
+    if (m_segmentCount < 1)
+        std::cerr << "ERROR: Route has no segments" << std::endl;
 
-    int cnt = 0;
-    while (profileFileStream >> row && cnt < 2) {
-        hours[cnt] = std::stoi(row[1]);
-        min[cnt] = std::stoi(row[2]);
-        cnt++;
-    }
+    // Allocate memory for lengths, freeflow speeds and speed profiles of the route
+    m_lengths = new int[m_segmentCount];
+    m_freeSpeeds = new float[m_segmentCount];
+    m_speedProfiles = new const float *[m_segmentCount];
 
-    if (hours[0] == hours[1]) {
-        // Interval is less than 1 hour
-        m_secondInterval = 60 * (min[1] - min[0]);
-    } else {
-        // Interval is longer than 1 hour
-        m_secondInterval = (hours[1] - hours[0]) * 3600;
+    for (int i = 0; i < m_segmentCount; ++i) {
+        m_lengths[i] = database.GetLength(segments[i]);
+        m_freeSpeeds[i] = database.GetFreeSpeed(segments[i]);
+        m_speedProfiles[i] = database.GetSpeedProfile(segments[i]);
     }
 
-    // Get profile count from number of columns in file
-    int profilesPerInterval =
-            (row.size() - 3) / 2; // Skip first three columns, divide by two values in single SpeedProbability
-    int intervalsPerDay = 86400 / m_secondInterval;
-    *speedProfileData = new float[INDEX_RESOLUTION * 7 * intervalsPerDay];
-
-    // Rewind stream
-    profileFileStream.seekg(0);
-
-    while (profileFileStream >> row) {
-        // Day of week
-        int currentDay = -1;
-        std::string currentDayString = row[0];
-
-        if (currentDayString == "Monday") currentDay = 0; // Monday
-        else if (currentDayString == "Tuesday") currentDay = 1; // Tuesday
-        else if (currentDayString == "Wednesday") currentDay = 2; // Wednesday
-        else if (currentDayString == "Thursday") currentDay = 3; //
-        else if (currentDayString == "Friday") currentDay = 4;
-        else if (currentDayString == "Saturday") currentDay = 5;
-        else if (currentDayString == "Sunday") currentDay = 6;
-
-        if (currentDay == -1)
-            std::cerr << "ERROR: Unknown day of week string " << currentDayString << std::endl;
-
-        // Time interval
-        int hour = std::stoi(row[1]);
-        int min = std::stoi(row[2]);
-        int currentProfileIdx =
-                (((hour * 3600) + (min * 60)) / (int) m_secondInterval) + (currentDay * intervalsPerDay);
-
-        int startIdx = 0;
-        float probabilitySum = 0.0f;
-        float errSum = 0.0f;
-        for (int i = 0; i < profilesPerInterval; i++) {
-
-            int rowIdx = i * 2 + 3; // Skip first three columns
-            std::string velocity_str = row[rowIdx];
-            std::string probability_str = row[rowIdx + 1];
-
-            if (velocity_str == "NaN" || probability_str == "NaN") {
-                // Probability is nan
-                //std::cout << "Day: " << currentDay << ", Index: " << i << " no probability" << std::endl;
-                continue;
-            }
-
-            float velocity = std::stof(velocity_str) * oneDiv3point6; // Convert velocity from km/h to m/s
-            float probability = std::stof(probability_str);
-
-            if (std::floor(probability * INDEX_RESOLUTION) < 1 && probability > 0.0f) {
-                std::cerr << "WARNING: Increase index resolution! (min. p: " << probability << " )" << std::endl;
-            }
+    ArrangeProfiles(database.GetIntervalSize(), database.GetAliasColumns());
+    SetKernel(m_kernel);
+}
 
-            if (velocity <= 0.0f && velocity > 300.0f) {
-                std::cerr << "Invalid velocity value: " << velocity << std::endl;
-            }
+void Routing::MCSimulation::SetRoute(const CachedRoute &route) {
+    m_secondInterval = route.GetSecondInterval();
+    m_segmentCount = route.GetSegmentCount();
+    if (m_segmentCount < 1)
+        std::cerr << "ERROR: Route has no segments" << std::endl;
 
-            if (probability < 0.0f && probability > 1.0f) {
-                std::cerr << "Invalid probability value: " << probability << std::endl;
-            }
+    m_lengths = new int[m_segmentCount];
+    m_freeSpeeds = new float[m_segmentCount];
+    m_speedProfiles = new const float *[m_segmentCount];
 
-            float idxP = INDEX_RESOLUTION * probability;
-            int length = static_cast<int>(idxP);
-            errSum += idxP - length;
+    for (int i = 0; i < m_segmentCount; ++i) {
+        m_lengths[i] = route.GetLength(i);
+        m_freeSpeeds[i] = route.GetFreeSpeed(i);
+        m_speedProfiles[i] = route.GetSpeedProfile(i);
+    }
 
-            if (i == profilesPerInterval - 1) {
-                length += std::round(errSum);
-            }
+    // Cache holds the expanded profiles
+    ArrangeProfiles(INDEX_RESOLUTION, 0);
+    SetKernel(m_kernel);
+}
 
-            for (int j = startIdx; j < (startIdx + length); ++j) {
-                int index = (currentProfileIdx * INDEX_RESOLUTION) + j;
-                (*speedProfileData)[index] = velocity;
+void Routing::MCSimulation::ArrangeProfiles(int intervalSize, int aliasColumns) {
+    // Alias tables have a power of two columns
+    m_aliasShift = 0;
+    while ((1 << m_aliasShift) < aliasColumns)
+        m_aliasShift++;
+
+    m_intervalSize = intervalSize;
+    m_intervalStride = intervalSize;
+    if (m_layout == ProfileLayout::Shared || m_segmentCount < 1)
+        return;
+
+    int intervalsPerWeek = 7 * static_cast<int>(86400 / m_secondInterval);
+
+    // Copy the route profiles to a single arena, the profile pointers then point to the first interval of the segment
+    std::size_t arenaSize = sizeof(float) * static_cast<std::size_t>(m_segmentCount) * intervalsPerWeek *
+                            intervalSize;
+    void *arena = nullptr;
+    if (posix_memalign(&arena, 64, arenaSize) != 0) {
+        std::cerr << "ERROR: Cannot allocate " << arenaSize << " bytes for the profile arena" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    m_profileArena = static_cast<float *>(arena);
+
+    if (m_layout == ProfileLayout::IntervalMajor) {
+        // [interval][segment][interval size]
+        m_intervalStride = static_cast<std::size_t>(m_segmentCount) * intervalSize;
+#pragma omp parallel for schedule(static)
+        for (int t = 0; t < intervalsPerWeek; ++t) {
+            for (int i = 0; i < m_segmentCount; ++i) {
+                std::memcpy(m_profileArena + (static_cast<std::size_t>(t) * m_intervalStride) + (i * intervalSize),
+                            m_speedProfiles[i] + (t * intervalSize), sizeof(float) * intervalSize);
             }
-            startIdx += length;
-            probabilitySum += probability;
         }
-
-        if ((1.0f - probabilitySum) > std::numeric_limits<float>::epsilon()) {
-            std::cerr << "Invalid probability sum: " << probabilitySum << std::endl;
+        for (int i = 0; i < m_segmentCount; ++i) {
+            m_speedProfiles[i] = m_profileArena + (i * intervalSize);
         }
-
-        if (startIdx == 0) {
-            std::cerr << "Day: " << currentDay << " no speed profile, using freeflow speed " << freeflowSpeed << "("
-                      << speedProfileFile << ")" << std::endl;
-            for (int j = 0; j < INDEX_RESOLUTION; ++j) {
-                int index = (currentProfileIdx * INDEX_RESOLUTION) + j;
-                (*speedProfileData)[index] = freeflowSpeed;
-            }
+    } else {
+        // [segment][interval][interval size]
+        std::size_t segmentSize = static_cast<std::size_t>(intervalsPerWeek) * intervalSize;
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < m_segmentCount; ++i) {
+            std::memcpy(m_profileArena + (i * segmentSize), m_speedProfiles[i], sizeof(float) * segmentSize);
+        }
+        for (int i = 0; i < m_segmentCount; ++i) {
+            m_speedProfiles[i] = m_profileArena + (i * segmentSize);
         }
     }
-    profileFileStream.close();
 }
 
-void Routing::MCSimulation::LoadSegments(const std::string segmentsFile, const std::string profilesDir) {
-
-    // Load files in profile directory
-    DIR *dirp = opendir(profilesDir.c_str());
-    struct dirent *entry;
-    std::map<std::string, std::string> profilesByTmcId;
-
-    if (!dirp) {
-        std::cerr << "ERROR: Cannot open directory " << profilesDir << std::endl;
+void Routing::MCSimulation::OptimalTravelTimes(const int *startSeconds, int count, float *travelTimes) const {
+    float seconds[OPTIMAL_SWEEP_BLOCK];
+    float times[OPTIMAL_SWEEP_BLOCK];
+    int crosses[OPTIMAL_SWEEP_BLOCK];
+    for (int d = 0; d < count; ++d) {
+        seconds[d] = static_cast<float>(startSeconds[d]);
+        travelTimes[d] = 0.0f;
     }
 
-    char *fileName = new char[1024];
-    while ((entry = readdir(dirp))) {
-        if (entry->d_type == DT_REG) {
-            // First field in the speed profile file name corresponds to segment ID
-            char *token = strtok(strncpy(fileName, entry->d_name, 1024), PROFILE_FILE_NAME_SEP);
-            profilesByTmcId.emplace(std::string(token), profilesDir + '/' + std::string(entry->d_name));
+    // First speed of the expanded profile, speed of the first column of the alias table
+    int offset = m_aliasShift != 0 ? 1 : 0;
+    int lastInterval = 7 * static_cast<int>(86400 / m_secondInterval) - 1;
+    float secondInterval = m_secondInterval;
+    std::size_t stride = m_intervalStride;
+    for (int s = 0; s < m_segmentCount; ++s) {
+        const float *profile = m_speedProfiles[s] + offset;
+        float length = static_cast<float>(m_lengths[s]);
+
+        // Branch free pass over the departures, compiles to gathers of the interval speeds
+        int anyCrossing = 0;
+        for (int d = 0; d < count; ++d) {
+            int interval = std::min(static_cast<int>(seconds[d] / secondInterval), lastInterval);
+            float time = length / profile[interval * stride];
+            crosses[d] = seconds[d] + time >= (interval + 1) * secondInterval;
+            times[d] = crosses[d] ? 0.0f : time;
+            seconds[d] += times[d];
+            anyCrossing |= crosses[d];
+        }
+        for (int d = 0; d < count; ++d) {
+            travelTimes[d] += times[d];
         }
-    }
-
-    delete[] fileName;
-    m_segmentCount = profilesByTmcId.size();
-    if (m_segmentCount < 1)
-        std::cerr << "ERROR: No segments found in directory " << profilesDir << std::endl;
-
-    // Load segments
-    std::ifstream segmentFileStream(segmentsFile);
-    // Allocate memory for lengths
-    m_lengths = new int[m_segmentCount];
-    m_freeSpeeds = new float[m_segmentCount];
-
-    // Allocate memory for speed profiles
-    m_speedProfiles = new float *[m_segmentCount];
 
-    if (!segmentFileStream.is_open()) {
-        std::cerr << "ERROR: Unable to open file " << segmentsFile << std::endl;
-        std::exit(EXIT_FAILURE);
-    } else {
-        CSVReader row(';');
-        int cnt = 0;
-        segmentFileStream >> row; // Discard the header
-        while (segmentFileStream >> row) {
-            if (row.size() != 3) {
-                std::cerr << "ERROR: Row " << cnt + 1 << " has invalid column count." << std::endl;
-                continue;
-            }
-            std::string tmcId = row[0];
-            if (profilesByTmcId.find(tmcId) == profilesByTmcId.end()) {
-                std::cerr << "ERROR: Profile for segment " << tmcId << " not found in profile directory " << profilesDir
-                          << std::endl;
-                continue;
+        // Departures leaving the interval within the segment are rare
+        if (__builtin_expect(anyCrossing, 0)) {
+            for (int d = 0; d < count; ++d) {
+                if (crosses[d])
+                    travelTimes[d] += OptimalSegmentTime(s, seconds[d]);
             }
-
-            m_lengths[cnt] = std::stoi(row[1]);
-            m_freeSpeeds[cnt] = std::stof(row[2]);
-            LoadSpeedProfile(profilesByTmcId[tmcId], &m_speedProfiles[cnt], m_freeSpeeds[cnt]);
-            cnt++;
         }
-        segmentFileStream.close();
     }
 }
 
-float Routing::MCSimulation::GetOptimalTravelTime(int startSeconds) const {
-    if (m_speedProfiles == nullptr || m_lengths == nullptr) {
-        std::cerr << "ERROR: Profiles or segments missing" << std::endl;
-    }
-
-    int idx = (startSeconds / m_secondInterval * INDEX_RESOLUTION); // Take first velocity in the profile
-    float optimalTravelTime = 0.0f;
+float Routing::MCSimulation::OptimalSegmentTime(int segment, float &currentSeconds) const {
+    int intervals = 7 * static_cast<int>(86400 / m_secondInterval);
+    int interval = std::min(static_cast<int>(currentSeconds / m_secondInterval), intervals - 1);
+    const float *profile = m_speedProfiles[segment] + (m_aliasShift != 0 ? 1 : 0);
+    float remainingLength = static_cast<float>(m_lengths[segment]);
+    float travelTime = 0.0f;
+    while (true) {
+        float velocity = profile[interval * m_intervalStride];
+        float boundary = (interval + 1) * m_secondInterval;
+        float time = remainingLength / velocity;
+        if (currentSeconds + time < boundary) {
+            currentSeconds += time;
+            return travelTime + time;
+        }
 
-    for (int s = 0; s < m_segmentCount; s++) {
-        float velocity = m_speedProfiles[s][idx];
-        float time = m_lengths[s] / velocity; // Rounded to seconds
-        optimalTravelTime += time;
+        // Rest of the interval at the current speed, the remaining length at the speed of the next one
+        remainingLength -= velocity * (boundary - currentSeconds);
+        travelTime += boundary - currentSeconds;
+        currentSeconds = boundary;
+        if (++interval > intervals - 1) {
+            // Wrap around the end of the week
+            interval = 0;
+            currentSeconds = 0.0f;
+        }
     }
-    std::cout << "Optimal travel time " << optimalTravelTime << "s" << std::endl;
-    return optimalTravelTime;
-}
\ No newline at end of file
+}
@@ -1,18 +1,87 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <map>
 #include <vector>
 #include <string>
+#include "NumaTopology.h"
+#include "ProfileDatabase.h"
+#include "RandomGenerator.h"
+#include "SimdKernel.h"
+
+#define ADAPTIVE_SAMPLING_MIN_SAMPLES 100 // Samples of the first chunk of the adaptive simulation
+#define ADAPTIVE_SAMPLING_MAX_GROWTH 4 // Maximum ratio of the sample counts after and before a chunk
+#define ADAPTIVE_SAMPLING_MARGIN 1.1 // Overestimate of the samples predicted to reach the target error
+#define OPTIMAL_SWEEP_BLOCK 64 // Departure times swept together along the route by ComputeOptimalTravelTime
+#define HISTOGRAM_MAX_BINS 2048 // Widest travel time histogram of ConvolveHistograms before falling back to sampling
+
+class QuantileSketch;
+
+class ResultStats;
+
+class TravelTimeHistogram;
 
 namespace Routing {
+    class CachedRoute;
+
+    class Route;
+
+    struct SimulationCounters;
+
+    /**
+     * Memory layout of the speed profiles used by the simulation
+     */
+    enum class ProfileLayout {
+        Shared, // Profiles are used in place, one block per segment owned by the database
+        IntervalMajor, // Single arena [interval][segment][resolution], a route at one interval is contiguous
+        SegmentMajor // Single arena [segment][interval][resolution]
+    };
+
+    /**
+     * Method computing the travel time distribution of a departure
+     */
+    enum class SimulationEngine {
+        MonteCarlo, // Random samples of the travel time
+        Histogram // Convolution of the segment travel time distributions, see MCSimulation::ConvolveHistograms
+    };
+
     class MCSimulation {
     public:
         /**
          * Constructor, loads speed profiles from the supplied files
          * @param segmentsFile CSV file with segment IDs and lengths in meters
          * @param profilesDir Directory with CSV files with probabilistic speed profiles for the segments
+         * or binary profile store created by ptdr-convert
+         * @param layout memory layout of the speed profiles
+         * @param storage representation of the speed profiles
+         */
+        MCSimulation(const std::string segmentsFile, const std::string profilesDir,
+                     ProfileLayout layout = ProfileLayout::IntervalMajor,
+                     ProfileStorage storage = ProfileStorage::Expanded);
+
+        /**
+         * Constructor, simulates the route using profiles of a shared database
+         * @param database profiles of the road network, must outlive the simulation
+         * @param route segments of the route
+         * @param layout memory layout of the speed profiles, Shared avoids copying of the database profiles
+         * (the representation of the profiles is given by the database)
+         */
+        MCSimulation(const ProfileDatabase &database, const Route &route,
+                     ProfileLayout layout = ProfileLayout::IntervalMajor);
+
+        /**
+         * Constructor, simulates the route using profiles held by a profile cache
+         * @param route profiles of the route acquired from the cache, must outlive the simulation for the shared
+         * layout
+         * @param layout memory layout of the speed profiles, Shared avoids copying of the cached profiles
          */
-        MCSimulation(const std::string segmentsFile, const std::string profilesDir);
+        MCSimulation(const CachedRoute &route, ProfileLayout layout = ProfileLayout::IntervalMajor);
+
+        MCSimulation(const MCSimulation &) = delete;
+
+        MCSimulation &operator=(const MCSimulation &) = delete;
 
         /**
          * Destructor frees memory for the loaded segments
@@ -23,6 +92,7 @@ namespace Routing {
          * Loads data from the supplied files
          * @param segmentsFile CSV file with segment IDs and lengths in meters
          * @param profilesDir Directory with CSV files with probabilistic speed profiles for the segments
+         * or binary profile store created by ptdr-convert
          */
         void LoadSegments(const std::string segmentsFile, const std::string profilesDir);
 
@@ -32,15 +102,151 @@ namespace Routing {
          * @param startDay departure day (0-6)
          * @param startHour departure hour (0-23)
          * @param startMinute departure minute (0-59)
-         * @param all if true, iterate over all possible departure intervals
-         * @return vector of travel times of size equal to the samples paramter
+         * @param all if true, iterate over all possible departure intervals. Every sample then uses the same
+         * random numbers for all the departures (common random numbers), so the differences between the intervals
+         * come from the profiles rather than from the sampling noise.
+         * @return vector of travel times of size equal to the samples paramter, for all the departure intervals
+         * one block of samples per interval
          */
         std::vector<float>
         RunMonteCarloSimulation(const int samples, const int startDay, const int startHour, const int startMinute,
                                 bool all) const;
 
         /**
-         * Get optimal travel time for the supplied route.
+         * Runs the simulation for a single departure time without storing the samples, every thread summarizes
+         * its samples in a private sketch merged into the supplied one at the end
+         * @param samples number of samples to take
+         * @param startDay departure day (0-6)
+         * @param startHour departure hour (0-23)
+         * @param startMinute departure minute (0-59)
+         * @param sketch receives travel times of all the samples, its relative error is used by the thread sketches
+         * @param firstSample number of the first sample, a run continuing earlier samples of the same departure
+         * starts after them, so with a fixed seed it never repeats their random numbers
+         */
+        void RunMonteCarloSimulation(const int samples, const int startDay, const int startHour, const int startMinute,
+                                     QuantileSketch &sketch, const int firstSample = 0) const;
+
+        /**
+         * Extend the travel times of a single departure time by further samples. The new samples continue the
+         * numbering of the existing ones, so with a fixed seed they never repeat the earlier samples and the
+         * counter based generator gives the same travel times as a single run of the total size.
+         * @param travelTimes travel times of the previous runs, the new samples are appended
+         * @param samples number of samples to add
+         * @param startDay departure day (0-6)
+         * @param startHour departure hour (0-23)
+         * @param startMinute departure minute (0-59)
+         */
+        void ExtendSimulation(std::vector<float> &travelTimes, const int samples, const int startDay,
+                              const int startHour, const int startMinute) const;
+
+        /**
+         * Simulate consecutive samples of a single departure time on the calling thread, for callers scheduling the
+         * samples of many routes themselves. Chunks may be simulated in any order by any thread, a chunk has its own
+         * generator seeded by RunSeed of its first sample, so with a fixed seed the result does not depend on the
+         * scheduling.
+         * @param firstSample number of the first sample
+         * @param samples number of samples
+         * @param startSeconds departure time in seconds from the beginning of the week
+         * @param travelTimes output travel times of the samples
+         */
+        void SimulateChunk(const int firstSample, const int samples, const int startSeconds, float *travelTimes) const;
+
+        /**
+         * @return number of segments of the route
+         */
+        int GetSegmentCount() const;
+
+        /**
+         * Runs the simulation for a single departure time in growing chunks until the relative standard error of
+         * every percentile (ResultStats::PercentileError) reaches the target. Routes with predictable travel times
+         * stop after a few chunks, the unpredictable ones continue up to the sample limit.
+         * @param maxSamples maximum number of samples
+         * @param startDay departure day (0-6)
+         * @param startHour departure hour (0-23)
+         * @param startMinute departure minute (0-59)
+         * @param targetError relative standard error of the percentiles to reach
+         * @param percentiles percentile values whose error is checked
+         * @param minSamples number of samples of the first chunk
+         * @return travel times of all the taken samples
+         */
+        std::vector<float>
+        RunAdaptiveSimulation(const int maxSamples, const int startDay, const int startHour, const int startMinute,
+                              double targetError, const std::vector<float> &percentiles,
+                              const int minSamples = ADAPTIVE_SAMPLING_MIN_SAMPLES) const;
+
+        /**
+         * Runs the simulation for all departure intervals of the week as a pipeline. Every interval is simulated by
+         * a single thread and only its statistics are kept, the consumer receives them in the order of the
+         * intervals as soon as all the previous intervals are done. Memory is bounded by the intervals in flight.
+         * Sample numbers of every interval restart the random stream, the intervals share common random numbers.
+         * @param samples number of samples per departure interval
+         * @param percentiles percentile values to obtain
+         * @param relativeError relative error of the percentiles summarized by QuantileSketch,
+         * 0 keeps all the samples of the interval and computes exact percentiles
+         * @param consumer called with day, interval of the day and statistics of every departure interval
+         */
+        void SweepWeek(const int samples, const std::vector<float> &percentiles, double relativeError,
+                       const std::function<void(int, int, const ResultStats &)> &consumer) const;
+
+        /**
+         * Runs the simulation for all departure intervals of the week as a pipeline like SweepWeek, but passes the
+         * samples of every interval to the consumer instead of their statistics
+         * @param samples number of samples per departure interval
+         * @param consumer called with day, interval of the day and travel times of every departure interval, the
+         * travel times are valid only during the call
+         */
+        void SweepWeekSamples(const int samples, const std::function<void(int, int, const float *)> &consumer) const;
+
+        /**
+         * Select random number generator backend
+         * @param backend generator backend, RngBackend::Philox makes the result independent of the thread count
+         */
+        void SetRngBackend(RngBackend backend);
+
+        /**
+         * Fix the seed of the random number generator, otherwise every run is seeded by std::rand
+         * @param seed seed used by all subsequent runs
+         */
+        void SetSeed(uint64_t seed);
+
+        /**
+         * Enable collection of the hot path counters, every subsequent run adds its samples, interval crossings,
+         * random words and phase times to the supplied counters
+         * @param counters counters to add to, must outlive the runs, nullptr disables the collection
+         */
+        void SetCounters(SimulationCounters *counters);
+
+        /**
+         * Select implementation of the simulation, the fastest one supported by the CPU is used by default
+         * @param kernel simulation kernel, falls back to the default if not supported by the CPU
+         */
+        void SetKernel(SimulationKernel kernel);
+
+        /**
+         * Precompute travel time of every whole segment at every speed of the profiles. Samples passing a segment
+         * within a single interval then read the time instead of dividing the length by the speed, the division
+         * is left to the segments crossing an interval boundary. Times are computed by the same division, so the
+         * travel times do not change. The table takes as much memory as the profiles of the route.
+         * @param enabled true to build the table, false to free it
+         */
+        void SetSegmentTimes(bool enabled);
+
+        /**
+         * Place the profiles (and the segment times) read by the samples on the NUMA nodes. Replicate copies them to
+         * every node, each block of samples then reads the copy of the node running it. Interleave copies them once,
+         * spread over all the nodes, so no node serves all the reads. Threads should be pinned by
+         * NumaTopology::PinThreads, otherwise a thread migrated within a block reads a remote copy. Copies are made
+         * again by SetSegmentTimes, the travel times do not change. With the counters enabled, the pages of the
+         * placed profiles are queried to estimate the remote reads.
+         * @param mode placement of the profiles, None reads the profiles where they were loaded
+         */
+        void SetNumaMode(NumaMode mode);
+
+        /**
+         * Get optimal travel time for the supplied route. Every segment is passed at the first speed of the profile
+         * valid at the time the car enters it, segments crossing an interval boundary continue at the speed of the
+         * next interval. Departure times are swept along the route in blocks, a single segment is evaluated for the
+         * whole block at once.
          * @param startDay departure day (0-6)
          * @param startHour departure hour (0-23)
          * @param startMinute departure minute (0-59)
@@ -50,29 +256,205 @@ namespace Routing {
         std::vector<float>
         ComputeOptimalTravelTime(const int startDay, const int startHour, const int startMinute, bool all) const;
 
+        /**
+         * Compute the travel time distribution of a single departure time without sampling. The distribution of the
+         * time of leaving every segment is the convolution of the distribution of entering it with the speeds of
+         * the profile interval valid at the entry time. A segment crossing an interval boundary continues from the
+         * boundary at an independent speed of the next interval, as in ComputeOptimalTravelTime. The simulation
+         * looks up the next interval at the time the whole segment would take at the old speed, so the two engines
+         * differ slightly on routes with many crossings. Times are kept in bins of the histogram, the cost grows
+         * with the number of bins times the distinct speeds of the intervals, so routes whose distribution gets
+         * wider than maxBins are left to the sampling.
+         * @param startDay departure day (0-6)
+         * @param startHour departure hour (0-23)
+         * @param startMinute departure minute (0-59)
+         * @param histogram is set to the travel time distribution, its bin width is kept
+         * @param maxBins maximum number of bins of the distribution after any segment
+         * @return false if the distribution got wider than maxBins, the histogram is then incomplete
+         */
+        bool ConvolveHistograms(const int startDay, const int startHour, const int startMinute,
+                                TravelTimeHistogram &histogram, const std::size_t maxBins = HISTOGRAM_MAX_BINS) const;
+
+        /**
+         * Get travel time of the route at the free-flow speeds of the segments, independent of the departure time
+         * @return free-flow travel time in seconds
+         */
+        float ComputeFreeFlowTravelTime() const;
+
+        /**
+         * @return length of time interval for which a single profile is valid in seconds
+         */
+        float GetSecondInterval() const;
+
     private:
         /**
-         * Load single speed profile from the supplied CSV file
-         * @param speedProfileFile path to the CSV file
-         * @param speedProfileData pointer to the beginning of memory to store the profile data in
-         * @param freeflowSpeed default speed to be used when segment does not have a profile
+         * Copy of the profiles read by the samples placed on the NUMA nodes
          */
-        void LoadSpeedProfile(const std::string speedProfileFile, float **speedProfileData, float freeflowSpeed);
+        struct Replica {
+            float *arena; // Mapped memory holding the profiles followed by the segment times
+            std::size_t bytes; // Size of the mapping
+            const float **speedProfiles; // Profiles of the segments in the layout of m_speedProfiles
+            const float **segmentTimes; // Segment times in the layout of m_segmentTimes, null if not enabled
+        };
+
+        /**
+         * Bind the simulation to segments of the route
+         * @param database profiles of the road network
+         * @param route segments of the route
+         */
+        void SetRoute(const ProfileDatabase &database, const Route &route);
+
+        /**
+         * Bind the simulation to profiles of a cached route
+         * @param route profiles of the route
+         */
+        void SetRoute(const CachedRoute &route);
+
+        /**
+         * Set up the profiles of the route bound by SetRoute according to the layout
+         * @param intervalSize number of values per interval of the speed profiles
+         * @param aliasColumns number of alias table columns per interval, 0 for the expanded profiles
+         */
+        void ArrangeProfiles(int intervalSize, int aliasColumns);
+
+        /**
+         * Offset of the first interval of a segment in an arena holding profiles of the route in the layout of
+         * m_speedProfiles, the shared profiles are arranged as the segment major ones
+         * @param segment segment index within the route
+         * @return offset in floats
+         */
+        std::size_t ArenaOffset(int segment) const;
+
+        /**
+         * @return number of floats of an arena holding profiles of the route
+         */
+        std::size_t ArenaSize() const;
+
+        /**
+         * Copy the profiles and the segment times to the replicas of the NUMA mode, frees the previous replicas
+         */
+        void PlaceProfiles();
+
+        /**
+         * Estimate the fraction of remote profile reads of a thread on every node from the placement of the profile
+         * pages read by the samples
+         */
+        void MeasurePlacement();
+
+        /**
+         * @return estimated fraction of remote profile reads of the calling thread, 0 until measured
+         */
+        double RemoteFraction() const;
+
+        /**
+         * Profiles read by a block of samples simulated on the calling thread
+         * @return view of the route with the profiles of the local replica
+         */
+        Kernel::RouteView LocalRoute() const;
+
+        /**
+         * Seed of a simulation run
+         * @param firstSample number of the first sample of the run
+         * @return fixed seed or a random one, stream generators get a distinct seed for runs continuing previous
+         * samples
+         */
+        uint64_t RunSeed(int firstSample) const;
+
+        /**
+         * Generate the first random word of every segment for consecutive samples
+         * @param rnd random number generator of the thread
+         * @param draws buffer for segmentCount words of every sample
+         * @param firstSample number of the first sample
+         * @param count number of samples, at most the number of kernel lanes
+         * @param departure departure interval used as random stream index
+         */
+        void FillDraws(RandomGenerator &rnd, uint32_t *draws, int firstSample, int count, int departure) const;
+
+        /**
+         * Simulate consecutive samples with the selected kernel using pre-generated draws, the same draws may be
+         * simulated for several departure times
+         * @param rnd random number generator of the thread for the interval crossings
+         * @param draws first random word of every segment for all the samples, filled by FillDraws
+         * @param firstSample number of the first sample
+         * @param count number of samples, at most the number of kernel lanes
+         * @param startSeconds departure time in seconds from the beginning of the week
+         * @param departure departure interval used as random stream index of the crossings
+         * @param travelTimes output travel times of the samples
+         */
+        void SimulateDraws(RandomGenerator &rnd, const uint32_t *draws, int firstSample, int count, int startSeconds,
+                           int departure, float *travelTimes) const;
+
+        /**
+         * Simulate consecutive samples with the selected kernel
+         * @param rnd random number generator of the thread
+         * @param draws buffer for the first random word of every segment for all kernel lanes
+         * @param firstSample number of the first sample
+         * @param count number of samples, at most the number of kernel lanes
+         * @param startSeconds departure time in seconds from the beginning of the week
+         * @param departure departure interval used as random stream index
+         * @param travelTimes output travel times of the samples
+         * @param counters counters of the thread, nullptr if the collection is disabled
+         */
+        void SimulateSamples(RandomGenerator &rnd, uint32_t *draws, int firstSample, int count, int startSeconds,
+                             int departure, float *travelTimes, SimulationCounters *counters) const;
+
+        /**
+         * Add the generator statistics to the counters of the thread and merge them into the enabled counters
+         * @param counters counters of the thread, reset after the merge, nullptr if the collection is disabled
+         * @param rnd generator of the thread, its statistics must not have been added yet
+         */
+        void FlushCounters(SimulationCounters *counters, const RandomGenerator &rnd) const;
 
         /**
          * Simulate pass of a single car along the entire route - obtain single MC sample
+         * @param route route with the profiles to read, see LocalRoute
          * @param startSeconds departure time in seconds from the beginning of the week
-         * @param probs random indexes to use
+         * @param draws first random word of every segment
+         * @param rnd random number generator for the interval crossings
+         * @param sample sample number
+         * @param departure departure interval used as random stream index
          * @return random travel time in seconds
          */
-        float GetRandomTravelTime(int startSeconds, int *probs) const;
+        float GetRandomTravelTime(const Kernel::RouteView &route, int startSeconds, const uint32_t *draws,
+                                  RandomGenerator &rnd, uint32_t sample, uint32_t departure) const;
+
+        /**
+         * Pass of cars departing at the given times along the entire route - using only first speed of the profiles
+         * @param startSeconds departure times in seconds from the beginning of the week
+         * @param count number of departures, at most OPTIMAL_SWEEP_BLOCK
+         * @param travelTimes output optimal travel times in seconds
+         */
+        void OptimalTravelTimes(const int *startSeconds, int count, float *travelTimes) const;
 
         /**
-         * Simulate pass of a single car along the entire route - using only first speed profile
+         * Pass of a single segment crossing one or more interval boundaries at the first speed of the profiles
+         * @param segment segment index within the route
+         * @param currentSeconds time of entering the segment, set to the time of leaving it
+         * @return travel time of the segment in seconds
+         */
+        float OptimalSegmentTime(int segment, float &currentSeconds) const;
+
+        /**
+         * Distinct speeds of a single profile interval and their probabilities
+         * @param segment segment index within the route
+         * @param interval interval of the week
+         * @param levels is set to (speed, probability) pairs
+         */
+        void IntervalLevels(int segment, int interval, std::vector<std::pair<float, float>> &levels) const;
+
+        /**
+         * Add the distribution of leaving a segment entered at a single time to the histogram
+         * @param segment segment index within the route
          * @param startSeconds departure time in seconds from the beginning of the week
-         * @return optimal travel time in seconds
+         * @param travelTime travel time of entering the segment
+         * @param probability probability of entering the segment at the time
+         * @param remainingLength length of the segment left to pass
+         * @param levels speed levels of the segment indexed by the interval, filled on demand
+         * @param histogram distribution of the travel times of leaving the segment
          */
-        float GetOptimalTravelTime(int startSeconds) const;
+        void ConvolveSegment(int segment, int startSeconds, double travelTime, double probability,
+                             double remainingLength, std::map<int, std::vector<std::pair<float, float>>> &levels,
+                             TravelTimeHistogram &histogram) const;
 
         /**
          * Members
@@ -89,9 +471,95 @@ namespace Routing {
         int m_segmentCount = 0;
 
         /**
-         * Linear array of speed profiles for all segments
+         * Random number generator backend
+         */
+        RngBackend m_rngBackend = RandomGenerator::DefaultBackend();
+
+        /**
+         * Seed of the random number generator, valid if m_hasSeed is set
+         */
+        uint64_t m_seed = 0;
+
+        /**
+         * True if the seed was fixed by SetSeed
+         */
+        bool m_hasSeed = false;
+
+        /**
+         * Counters enabled by SetCounters, null if disabled
+         */
+        SimulationCounters *m_counters = nullptr;
+
+        /**
+         * Implementation of the simulation
+         */
+        SimulationKernel m_kernel = Kernel::Best();
+
+        /**
+         * Memory layout of the speed profiles
+         */
+        ProfileLayout m_layout = ProfileLayout::IntervalMajor;
+
+        /**
+         * Representation of the profiles loaded by LoadSegments
+         */
+        ProfileStorage m_storage = ProfileStorage::Expanded;
+
+        /**
+         * log2 of the alias table columns, 0 for the expanded profiles
+         */
+        int m_aliasShift = 0;
+
+        /**
+         * Distance between two consecutive intervals of a single segment profile
+         */
+        std::size_t m_intervalStride = 0;
+
+        /**
+         * Number of values per interval of the speed profiles
+         */
+        int m_intervalSize = 0;
+
+        /**
+         * Linear array of speed profiles for all segments, points to the database or to the arena
+         */
+        const float **m_speedProfiles = nullptr;
+
+        /**
+         * Contiguous copy of the route profiles, null for the shared layout
+         */
+        float *m_profileArena = nullptr;
+
+        /**
+         * Travel times of the whole segments in the layout of m_speedProfiles, null unless enabled by
+         * SetSegmentTimes
+         */
+        const float **m_segmentTimes = nullptr;
+
+        /**
+         * Single allocation holding the segment times
+         */
+        float *m_timeArena = nullptr;
+
+        /**
+         * Placement of the profiles on the NUMA nodes
+         */
+        NumaMode m_numaMode = NumaMode::None;
+
+        /**
+         * Placed copies of the profiles, one per node for Replicate, a single one for Interleave
+         */
+        std::vector<Replica> m_replicas;
+
+        /**
+         * Estimated fraction of remote profile reads of a thread on every node, empty until measured
+         */
+        std::vector<double> m_remoteFractions;
+
+        /**
+         * Database created by LoadSegments, null when the database is shared
          */
-        float **m_speedProfiles = nullptr;
+        ProfileDatabase *m_ownedDatabase = nullptr;
 
         /**
          * Lengths of the individual segments
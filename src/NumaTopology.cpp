@@ -0,0 +1,243 @@
+#include "NumaTopology.h"
+#include <omp.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <dirent.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+#define NUMA_SYSFS_NODES "/sys/devices/system/node"
+
+namespace {
+    /**
+     * Parse a sysfs CPU list such as 0-3,8-11
+     */
+    std::vector<int> ParseCpuList(const std::string &list) {
+        std::vector<int> cpus;
+        std::istringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            if (range.empty() || range == "\n")
+                continue;
+            std::size_t dash = range.find('-');
+            try {
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            } catch (const std::exception &) {
+                return {};
+            }
+        }
+        return cpus;
+    }
+}
+
+const Routing::NumaTopology &Routing::NumaTopology::Get() {
+    static const NumaTopology topology;
+    return topology;
+}
+
+std::string Routing::NumaTopology::Name(NumaMode mode) {
+    switch (mode) {
+        case NumaMode::Replicate:
+            return "replicate";
+        case NumaMode::Interleave:
+            return "interleave";
+        default:
+            return "none";
+    }
+}
+
+bool Routing::NumaTopology::FromName(const std::string &name, NumaMode &mode) {
+    if (name == "none") mode = NumaMode::None;
+    else if (name == "replicate") mode = NumaMode::Replicate;
+    else if (name == "interleave") mode = NumaMode::Interleave;
+    else return false;
+    return true;
+}
+
+Routing::NumaTopology::NumaTopology() {
+    // CPUs outside of the affinity mask of the process (taskset, cgroups) are never used
+    std::vector<bool> allowed;
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            allowed.push_back(CPU_ISSET(cpu, &mask));
+        }
+    }
+#endif
+
+    std::vector<int> systemIds;
+    DIR *dirp = opendir(NUMA_SYSFS_NODES);
+    if (dirp != nullptr) {
+        struct dirent *entry;
+        while ((entry = readdir(dirp)) != nullptr) {
+            std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                std::all_of(name.begin() + 4, name.end(), ::isdigit))
+                systemIds.push_back(std::stoi(name.substr(4)));
+        }
+        closedir(dirp);
+    }
+    std::sort(systemIds.begin(), systemIds.end());
+
+    for (int id : systemIds) {
+        std::ifstream file(NUMA_SYSFS_NODES "/node" + std::to_string(id) + "/cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu : ParseCpuList(list)) {
+            if (allowed.empty() || (cpu < static_cast<int>(allowed.size()) && allowed[cpu]))
+                cpus.push_back(cpu);
+        }
+        if (cpus.empty())
+            continue;
+
+        if (static_cast<int>(m_systemNodes.size()) <= id)
+            m_systemNodes.resize(id + 1, -1);
+        m_systemNodes[id] = static_cast<int>(m_nodeCpus.size());
+        m_nodeCpus.push_back(cpus);
+    }
+
+    if (m_nodeCpus.empty()) {
+        // No NUMA information, all the allowed CPUs form a single node
+        std::vector<int> cpus;
+        for (std::size_t cpu = 0; cpu < allowed.size(); ++cpu) {
+            if (allowed[cpu])
+                cpus.push_back(static_cast<int>(cpu));
+        }
+        if (cpus.empty())
+            cpus.push_back(0);
+        m_nodeCpus.push_back(cpus);
+        m_systemNodes.clear();
+    }
+
+    for (std::size_t node = 0; node < m_nodeCpus.size(); ++node) {
+        for (int cpu : m_nodeCpus[node]) {
+            if (static_cast<int>(m_cpuNodes.size()) <= cpu)
+                m_cpuNodes.resize(cpu + 1, -1);
+            m_cpuNodes[cpu] = static_cast<int>(node);
+        }
+    }
+}
+
+int Routing::NumaTopology::GetNodeCount() const {
+    return static_cast<int>(m_nodeCpus.size());
+}
+
+const std::vector<int> &Routing::NumaTopology::GetCpus(int node) const {
+    return m_nodeCpus[node];
+}
+
+int Routing::NumaTopology::GetCurrentNode() const {
+    if (m_nodeCpus.size() < 2)
+        return 0;
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < static_cast<int>(m_cpuNodes.size()) && m_cpuNodes[cpu] >= 0)
+        return m_cpuNodes[cpu];
+#endif
+    return 0;
+}
+
+void Routing::NumaTopology::GetNodesOfAddresses(const std::vector<const void *> &addresses,
+                                                std::vector<int> &nodes) const {
+    nodes.assign(addresses.size(), -1);
+    if (m_nodeCpus.size() < 2) {
+        // Every touched page is on the only node
+        nodes.assign(addresses.size(), 0);
+        return;
+    }
+#ifdef __linux__
+    // move_pages without target nodes only reports the node of every page
+    std::vector<const void *> pages(addresses);
+    std::vector<int> status(addresses.size(), -1);
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+        return;
+    for (std::size_t i = 0; i < status.size(); ++i) {
+        if (status[i] >= 0 && status[i] < static_cast<int>(m_systemNodes.size()))
+            nodes[i] = m_systemNodes[status[i]];
+    }
+#endif
+}
+
+bool Routing::NumaTopology::BindThread(int node) const {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : m_nodeCpus[node]) {
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+void Routing::NumaTopology::PinThreads() const {
+    if (std::getenv("OMP_PROC_BIND") != nullptr || std::getenv("OMP_PLACES") != nullptr)
+        return;
+
+    std::vector<int> order;
+    for (std::size_t i = 0;; ++i) {
+        bool any = false;
+        for (const auto &cpus : m_nodeCpus) {
+            if (i < cpus.size()) {
+                order.push_back(cpus[i]);
+                any = true;
+            }
+        }
+        if (!any)
+            break;
+    }
+
+#ifdef __linux__
+#pragma omp parallel
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(order[omp_get_thread_num() % order.size()], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+}
+
+void Routing::NumaTopology::Place(void *memory, std::size_t bytes, int node) const {
+    char *data = static_cast<char *>(memory);
+    std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    int nodes = GetNodeCount();
+
+    // A thread bound to the node writes every page of its blocks, the kernel allocates the page on the node
+    auto touch = [&](int target) {
+        BindThread(target);
+        for (std::size_t block = 0; block < bytes; block += NUMA_INTERLEAVE_BYTES) {
+            if (node < 0 && static_cast<int>((block / NUMA_INTERLEAVE_BYTES) % nodes) != target)
+                continue;
+            std::size_t end = std::min(bytes, block + NUMA_INTERLEAVE_BYTES);
+            for (std::size_t offset = block; offset < end; offset += page) {
+                data[offset] = 0;
+            }
+        }
+    };
+
+    // Affinity of the calling thread is kept, the touching threads are temporary
+    std::vector<std::thread> threads;
+    for (int target = 0; target < nodes; ++target) {
+        if (node < 0 || node == target)
+            threads.emplace_back(touch, target);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
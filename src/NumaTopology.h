@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define NUMA_INTERLEAVE_BYTES (2u << 20) // Granularity of the interleaved placement, one transparent huge page
+#define NUMA_PLACEMENT_SAMPLES 4096 // Profile pages queried to estimate the remote reads of a placement
+
+namespace Routing {
+
+    /**
+     * Placement of the read-only profiles of a simulation on the NUMA nodes
+     */
+    enum class NumaMode {
+        None, // Profiles stay where they were first touched, usually by the loading thread
+        Replicate, // Every node holds a copy of the profiles, threads read the copy of their node
+        Interleave // Single copy spread over all the nodes in blocks of NUMA_INTERLEAVE_BYTES
+    };
+
+    /**
+     * NUMA nodes of the machine as seen by the process. Nodes are numbered from 0 in the order of the system node
+     * IDs, nodes without any CPU the process may run on are left out. Machines without NUMA information appear as a
+     * single node. Placement relies on the first touch policy of Linux, so the library does not depend on libnuma.
+     */
+    class NumaTopology {
+    public:
+        /**
+         * @return topology of the machine, detected on the first call
+         */
+        static const NumaTopology &Get();
+
+        /**
+         * Get name of the mode
+         * @param mode placement mode
+         * @return name used on the command line
+         */
+        static std::string Name(NumaMode mode);
+
+        /**
+         * Parse the name of a mode
+         * @param name none, replicate or interleave
+         * @param mode is set to the mode on success
+         * @return false if the name is unknown
+         */
+        static bool FromName(const std::string &name, NumaMode &mode);
+
+        /**
+         * @return number of nodes, at least 1
+         */
+        int GetNodeCount() const;
+
+        /**
+         * @param node node number
+         * @return CPUs of the node the process may run on
+         */
+        const std::vector<int> &GetCpus(int node) const;
+
+        /**
+         * @return node of the CPU running the calling thread, 0 if unknown
+         */
+        int GetCurrentNode() const;
+
+        /**
+         * Get nodes holding pages of memory by a single query
+         * @param addresses addresses within the pages
+         * @param nodes is set to the node number of every page, -1 if unknown
+         */
+        void GetNodesOfAddresses(const std::vector<const void *> &addresses, std::vector<int> &nodes) const;
+
+        /**
+         * Restrict the calling thread to the CPUs of a node
+         * @param node node number
+         * @return false if the affinity could not be set
+         */
+        bool BindThread(int node) const;
+
+        /**
+         * Pin every thread of the OpenMP team to a single CPU. CPUs are taken from the nodes in turn, so a team
+         * smaller than the machine is spread evenly over the nodes. Nothing is done if the binding is already set by
+         * OMP_PROC_BIND or OMP_PLACES.
+         */
+        void PinThreads() const;
+
+        /**
+         * Place memory that was not touched yet by touching its pages from threads bound to the nodes
+         * @param memory start of the memory, page aligned, blocks of the interleaved placement count from it
+         * @param bytes size of the memory
+         * @param node node to place all the pages on, -1 to interleave the pages over all the nodes
+         */
+        void Place(void *memory, std::size_t bytes, int node) const;
+
+    private:
+        /**
+         * Constructor, reads the nodes from sysfs
+         */
+        NumaTopology();
+
+        /**
+         * CPUs of every node
+         */
+        std::vector<std::vector<int>> m_nodeCpus;
+
+        /**
+         * Node of every CPU indexed by the CPU number, -1 for CPUs the process may not run on
+         */
+        std::vector<int> m_cpuNodes;
+
+        /**
+         * Node number of every system node ID, -1 for the left out nodes
+         */
+        std::vector<int> m_systemNodes;
+    };
+}
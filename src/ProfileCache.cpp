@@ -0,0 +1,189 @@
+#include "ProfileCache.h"
+#include <iostream>
+#include <sstream>
+#include "Data.h"
+
+Routing::ProfileCache::ProfileCache(const std::string &profilesDir, std::size_t memoryBudget)
+        : m_profilesDir(profilesDir), m_profileFiles(Data::ListSpeedProfiles(profilesDir)),
+          m_memoryBudget(memoryBudget) {
+    if (m_profileFiles.empty())
+        std::cerr << "ERROR: No segments found in directory " << profilesDir << std::endl;
+}
+
+Routing::ProfileCache::~ProfileCache() {
+    for (auto &entry : m_entries) {
+        if (entry.second.references != 0)
+            std::cerr << "ERROR: Profile of segment " << entry.first << " is still in use" << std::endl;
+        delete[] entry.second.profile;
+    }
+}
+
+const float *Routing::ProfileCache::Acquire(const std::string &tmcId, float freeflowSpeed) {
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(tmcId);
+        if (it != m_entries.end()) {
+            Entry &entry = it->second;
+            if (entry.references++ == 0)
+                m_lru.erase(entry.lru);
+            m_hits++;
+            return entry.profile;
+        }
+        m_misses++;
+
+        auto profile = m_profileFiles.find(tmcId);
+        if (profile == m_profileFiles.end()) {
+            std::cerr << "ERROR: Profile for segment " << tmcId << " not found in profile directory "
+                      << m_profilesDir << std::endl;
+            return nullptr;
+        }
+        file = profile->second;
+    }
+
+    // Other threads use the cache while the file is parsed
+    float *speedProfile = nullptr;
+    float secondInterval = 0;
+    std::ostringstream log;
+    bool loaded = Data::LoadSpeedProfile(file, &speedProfile, freeflowSpeed, secondInterval, log);
+    std::cerr << log.str();
+    if (!loaded)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_secondInterval == 0)
+        m_secondInterval = secondInterval;
+    if (secondInterval != m_secondInterval) {
+        std::cerr << "ERROR: Profile file " << file << " has time interval " << secondInterval << " s, expected "
+                  << m_secondInterval << " s" << std::endl;
+        delete[] speedProfile;
+        return nullptr;
+    }
+
+    // Segment may have been loaded concurrently by another thread, its copy is kept
+    auto it = m_entries.find(tmcId);
+    if (it != m_entries.end()) {
+        delete[] speedProfile;
+        Entry &entry = it->second;
+        if (entry.references++ == 0)
+            m_lru.erase(entry.lru);
+        return entry.profile;
+    }
+
+    std::size_t bytes = sizeof(float) * INDEX_RESOLUTION * static_cast<std::size_t>(7 * 86400 / secondInterval);
+    m_entries[tmcId] = {speedProfile, bytes, 1, m_lru.end()};
+    m_residentBytes += bytes;
+    Evict();
+    return speedProfile;
+}
+
+void Routing::ProfileCache::Release(const std::string &tmcId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(tmcId);
+    if (it == m_entries.end() || it->second.references == 0) {
+        std::cerr << "ERROR: Profile of segment " << tmcId << " released without being acquired" << std::endl;
+        return;
+    }
+
+    Entry &entry = it->second;
+    if (--entry.references == 0) {
+        entry.lru = m_lru.insert(m_lru.end(), tmcId);
+        Evict();
+    }
+}
+
+bool Routing::ProfileCache::Invalidate() {
+    std::map<std::string, std::string> profileFiles = Data::ListSpeedProfiles(m_profilesDir);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_lru.size() != m_entries.size()) {
+        std::cerr << "ERROR: Profiles cannot be invalidated while in use" << std::endl;
+        return false;
+    }
+
+    for (auto &entry : m_entries) {
+        delete[] entry.second.profile;
+    }
+    m_entries.clear();
+    m_lru.clear();
+    m_residentBytes = 0;
+    m_secondInterval = 0;
+    m_profileFiles.swap(profileFiles);
+    return true;
+}
+
+void Routing::ProfileCache::Evict() {
+    while (m_residentBytes > m_memoryBudget && !m_lru.empty()) {
+        auto it = m_entries.find(m_lru.front());
+        m_lru.pop_front();
+        m_residentBytes -= it->second.bytes;
+        delete[] it->second.profile;
+        m_entries.erase(it);
+        m_evictions++;
+    }
+}
+
+float Routing::ProfileCache::GetSecondInterval() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_secondInterval;
+}
+
+uint64_t Routing::ProfileCache::GetHits() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+uint64_t Routing::ProfileCache::GetMisses() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+uint64_t Routing::ProfileCache::GetEvictions() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_evictions;
+}
+
+std::size_t Routing::ProfileCache::GetResidentBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_residentBytes;
+}
+
+Routing::CachedRoute::CachedRoute(ProfileCache &cache, const std::string &segmentsFile)
+        : CachedRoute(cache, Data::LoadEdges(segmentsFile)) {}
+
+Routing::CachedRoute::CachedRoute(ProfileCache &cache, const std::vector<Data::Segment> &segments) : m_cache(cache) {
+    for (const auto &segment : segments) {
+        const float *profile = m_cache.Acquire(segment.tmcId, segment.freeSpeed);
+        if (profile == nullptr)
+            continue;
+        m_tmcIds.push_back(segment.tmcId);
+        m_speedProfiles.push_back(profile);
+        m_lengths.push_back(segment.length);
+        m_freeSpeeds.push_back(segment.freeSpeed);
+    }
+}
+
+Routing::CachedRoute::~CachedRoute() {
+    for (const auto &tmcId : m_tmcIds) {
+        m_cache.Release(tmcId);
+    }
+}
+
+float Routing::CachedRoute::GetSecondInterval() const {
+    return m_cache.GetSecondInterval();
+}
+
+int Routing::CachedRoute::GetSegmentCount() const {
+    return static_cast<int>(m_tmcIds.size());
+}
+
+const float *Routing::CachedRoute::GetSpeedProfile(int segment) const {
+    return m_speedProfiles[segment];
+}
+
+int Routing::CachedRoute::GetLength(int segment) const {
+    return m_lengths[segment];
+}
+
+float Routing::CachedRoute::GetFreeSpeed(int segment) const {
+    return m_freeSpeeds[segment];
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Data.h"
+
+#define PROFILE_CACHE_DEFAULT_BUDGET (1024ull << 20) // Default memory budget of the cached profiles in bytes
+
+namespace Routing {
+
+    /**
+     * Cache of expanded speed profiles loaded on demand from a directory of CSV files, for processes serving many
+     * routes of a network too large to keep resident. Profiles are reference counted while a route uses them and
+     * the least recently released ones are evicted when the memory budget is exceeded. Profiles in use are never
+     * evicted, so the budget may be exceeded by the routes being simulated. All methods are thread safe.
+     */
+    class ProfileCache {
+    public:
+        /**
+         * Constructor, lists the profile files of the directory
+         * @param profilesDir directory with CSV speed profiles
+         * @param memoryBudget bytes of the profiles kept resident after release
+         */
+        explicit ProfileCache(const std::string &profilesDir, std::size_t memoryBudget = PROFILE_CACHE_DEFAULT_BUDGET);
+
+        /**
+         * Destructor frees the cached profiles, all of them must be released
+         */
+        ~ProfileCache();
+
+        ProfileCache(const ProfileCache &) = delete;
+
+        ProfileCache &operator=(const ProfileCache &) = delete;
+
+        /**
+         * Get profile of a segment and hold a reference to it, the profile is loaded on a miss
+         * @param tmcId segment ID
+         * @param freeflowSpeed speed of the intervals missing in the profile file
+         * @return expanded speed profile for the whole week valid until Release, nullptr if the segment has no valid
+         * profile
+         */
+        const float *Acquire(const std::string &tmcId, float freeflowSpeed);
+
+        /**
+         * Drop reference to a profile obtained by Acquire
+         * @param tmcId segment ID
+         */
+        void Release(const std::string &tmcId);
+
+        /**
+         * Drop all the cached profiles and list the profile directory again, so changed profile files are loaded on
+         * the next use
+         * @return false if some profiles are acquired, the cache is then left unchanged
+         */
+        bool Invalidate();
+
+        /**
+         * @return length of time interval for which a single profile is valid in seconds, 0 before the first load
+         */
+        float GetSecondInterval() const;
+
+        /**
+         * @return number of Acquire calls served from memory
+         */
+        uint64_t GetHits() const;
+
+        /**
+         * @return number of Acquire calls that loaded the profile file
+         */
+        uint64_t GetMisses() const;
+
+        /**
+         * @return number of profiles evicted to keep the memory budget
+         */
+        uint64_t GetEvictions() const;
+
+        /**
+         * @return bytes of the cached profiles, both in use and released
+         */
+        std::size_t GetResidentBytes() const;
+
+    private:
+        /**
+         * Cached profile of a single segment
+         */
+        struct Entry {
+            float *profile;
+            std::size_t bytes;
+            int references;
+            std::list<std::string>::iterator lru; // Position in m_lru, valid if there are no references
+        };
+
+        /**
+         * Evict released profiles until the budget is kept, the lock must be held
+         */
+        void Evict();
+
+        /**
+         * Directory with CSV speed profiles
+         */
+        std::string m_profilesDir;
+
+        /**
+         * Paths to the profile files indexed by segment ID
+         */
+        std::map<std::string, std::string> m_profileFiles;
+
+        /**
+         * Bytes of the profiles kept resident after release
+         */
+        std::size_t m_memoryBudget;
+
+        /**
+         * Cached profiles indexed by segment ID
+         */
+        std::unordered_map<std::string, Entry> m_entries;
+
+        /**
+         * Released profiles, least recently released first
+         */
+        std::list<std::string> m_lru;
+
+        /**
+         * Bytes of all the cached profiles
+         */
+        std::size_t m_residentBytes = 0;
+
+        /**
+         * Length of time interval of the loaded profiles in seconds
+         */
+        float m_secondInterval = 0;
+
+        /**
+         * Statistics of the cache
+         */
+        uint64_t m_hits = 0;
+        uint64_t m_misses = 0;
+        uint64_t m_evictions = 0;
+
+        /**
+         * Guards all the members, profile files are parsed without holding it
+         */
+        mutable std::mutex m_mutex;
+    };
+
+    /**
+     * Profiles of a route held in the cache for the lifetime of the object
+     */
+    class CachedRoute {
+    public:
+        /**
+         * Constructor, acquires profiles of all the segments of the edges file, segments without a profile are skipped
+         * @param cache profile cache, must outlive the route
+         * @param segmentsFile CSV file with segment IDs, lengths and freeflow speeds of the route
+         */
+        CachedRoute(ProfileCache &cache, const std::string &segmentsFile);
+
+        /**
+         * Constructor, acquires profiles of the supplied segments, segments without a profile are skipped
+         * @param cache profile cache, must outlive the route
+         * @param segments segments of the route read by Data::ReadEdges or Data::LoadEdges
+         */
+        CachedRoute(ProfileCache &cache, const std::vector<Data::Segment> &segments);
+
+        /**
+         * Destructor releases the profiles
+         */
+        ~CachedRoute();
+
+        CachedRoute(const CachedRoute &) = delete;
+
+        CachedRoute &operator=(const CachedRoute &) = delete;
+
+        /**
+         * @return length of time interval for which a single profile is valid in seconds
+         */
+        float GetSecondInterval() const;
+
+        /**
+         * @return number of segments of the route
+         */
+        int GetSegmentCount() const;
+
+        /**
+         * @param segment position of the segment within the route
+         * @return speed profile of the segment for the whole week, INDEX_RESOLUTION values per interval
+         */
+        const float *GetSpeedProfile(int segment) const;
+
+        /**
+         * @param segment position of the segment within the route
+         * @return length of the segment in meters
+         */
+        int GetLength(int segment) const;
+
+        /**
+         * @param segment position of the segment within the route
+         * @return freeflow speed of the segment
+         */
+        float GetFreeSpeed(int segment) const;
+
+    private:
+        /**
+         * Cache holding the profiles
+         */
+        ProfileCache &m_cache;
+
+        /**
+         * Segment IDs of the acquired profiles
+         */
+        std::vector<std::string> m_tmcIds;
+
+        /**
+         * Acquired profiles of the segments
+         */
+        std::vector<const float *> m_speedProfiles;
+
+        /**
+         * Lengths of the segments
+         */
+        std::vector<int> m_lengths;
+
+        /**
+         * Segment freeflow speeds
+         */
+        std::vector<float> m_freeSpeeds;
+    };
+}
@@ -0,0 +1,189 @@
+#include "ProfileDatabase.h"
+#include "Data.h"
+#include "ProfileStore.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+
+Routing::ProfileDatabase::ProfileDatabase(const std::string &profilesPath,
+                                          const std::vector<std::string> &segmentsFiles, ProfileStorage storage)
+        : m_storage(storage) {
+    if (ProfileStore::IsProfileStore(profilesPath)) {
+        // Index, lengths and freeflow speeds are read directly from the mapped store
+        m_store = new ProfileStore(profilesPath);
+        m_secondInterval = m_store->GetSecondInterval();
+        if (m_store->GetSegmentCount() < 1)
+            std::cerr << "ERROR: No segments found in profile store " << profilesPath << std::endl;
+
+        // Column count is common to all the segments, the tables are built by GetSpeedProfile
+        if (m_storage == ProfileStorage::Alias)
+            m_aliasColumns = Data::AliasColumns(m_store->GetMaxLevels());
+        return;
+    }
+
+    std::map<std::string, std::string> profilesByTmcId = Data::ListSpeedProfiles(profilesPath);
+    if (profilesByTmcId.empty())
+        std::cerr << "ERROR: No segments found in directory " << profilesPath << std::endl;
+
+    // Segments of all the edges files in the order of the files
+    std::vector<Data::Segment> segments;
+    std::vector<std::string> profileFiles;
+    std::unordered_set<std::string> listed;
+    for (const auto &segmentsFile : segmentsFiles) {
+        for (const auto &segment : Data::LoadEdges(segmentsFile)) {
+            // Segments shared by several edges files are loaded only once
+            if (!listed.insert(segment.tmcId).second)
+                continue;
+
+            auto profile = profilesByTmcId.find(segment.tmcId);
+            if (profile == profilesByTmcId.end()) {
+                std::cerr << "ERROR: Profile for segment " << segment.tmcId << " not found in profile directory "
+                          << profilesPath << std::endl;
+                continue;
+            }
+            segments.push_back(segment);
+            profileFiles.push_back(profile->second);
+        }
+    }
+
+    // Profile files are parsed concurrently into preallocated slots, messages of every file are collected and
+    // printed afterwards in the order of the segments
+    int count = static_cast<int>(segments.size());
+    std::vector<Data::SpeedLevels> levels(count);
+    std::vector<float *> speedProfiles(count, nullptr);
+    std::vector<float> secondIntervals(count, 0.0f);
+    std::vector<std::string> messages(count);
+    std::vector<char> loaded(count, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; ++i) {
+        std::ostringstream log;
+        if (m_storage == ProfileStorage::Alias) {
+            // Column count depends on all the profiles, tables are built once everything is parsed
+            loaded[i] = Data::LoadSpeedLevels(profileFiles[i], levels[i], segments[i].freeSpeed, secondIntervals[i],
+                                              log);
+        } else {
+            loaded[i] = Data::LoadSpeedProfile(profileFiles[i], &speedProfiles[i], segments[i].freeSpeed,
+                                               secondIntervals[i], log);
+        }
+        messages[i] = log.str();
+    }
+
+    std::vector<Data::SpeedLevels> aliasLevels;
+    for (int i = 0; i < count; ++i) {
+        std::cerr << messages[i];
+        if (!loaded[i])
+            continue;
+
+        if (m_secondInterval == 0) {
+            m_secondInterval = secondIntervals[i];
+        } else if (secondIntervals[i] != m_secondInterval) {
+            std::cerr << "ERROR: Profile " << profileFiles[i] << " has interval " << secondIntervals[i]
+                      << " s, expected " << m_secondInterval << " s" << std::endl;
+            delete[] speedProfiles[i];
+            continue;
+        }
+
+        m_index.emplace(segments[i].tmcId, static_cast<int>(m_lengths.size()));
+        m_lengths.push_back(segments[i].length);
+        m_freeSpeeds.push_back(segments[i].freeSpeed);
+        if (m_storage == ProfileStorage::Alias)
+            aliasLevels.push_back(std::move(levels[i]));
+        else
+            m_speedProfiles.push_back(speedProfiles[i]);
+    }
+
+    if (m_storage == ProfileStorage::Alias)
+        BuildAliasTables(aliasLevels);
+}
+
+void Routing::ProfileDatabase::BuildAliasTables(const std::vector<Data::SpeedLevels> &levels) {
+    // Common column count keeps the interval size equal for all segments
+    int maxLevels = 1;
+    for (const auto &segmentLevels : levels) {
+        maxLevels = std::max(maxLevels, segmentLevels.maxLevels);
+    }
+    m_aliasColumns = Data::AliasColumns(maxLevels);
+
+    int count = static_cast<int>(levels.size());
+    m_speedProfiles.resize(count);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; ++i) {
+        float *aliasTable = new float[levels[i].intervals * GetIntervalSize()];
+        Data::BuildAliasTables(levels[i], m_aliasColumns, aliasTable);
+        m_speedProfiles[i] = aliasTable;
+    }
+}
+
+Routing::ProfileDatabase::~ProfileDatabase() {
+    // Expanded profiles mapped from the store are released together with the store
+    for (auto profile : m_speedProfiles) {
+        delete[] profile;
+    }
+    for (auto &table : m_storeAliasTables) {
+        delete[] table.second;
+    }
+    delete m_store;
+}
+
+int Routing::ProfileDatabase::Find(const std::string &tmcId) const {
+    if (m_store != nullptr) {
+        const ProfileStore::Entry *entry = m_store->Find(tmcId);
+        return entry != nullptr ? static_cast<int>(entry - &m_store->GetEntry(0)) : -1;
+    }
+
+    auto it = m_index.find(tmcId);
+    return it != m_index.end() ? it->second : -1;
+}
+
+const float *Routing::ProfileDatabase::GetSpeedProfile(int segment) const {
+    if (m_store == nullptr)
+        return m_speedProfiles[segment];
+    if (m_storage == ProfileStorage::Expanded)
+        return m_store->GetSpeedProfile(m_store->GetEntry(segment));
+
+    // Stored distributions keep the probabilities rounded away by the expanded profiles
+    std::lock_guard<std::mutex> lock(m_storeAliasMutex);
+    float *&aliasTable = m_storeAliasTables[segment];
+    if (aliasTable == nullptr) {
+        Data::SpeedLevels levels;
+        m_store->GetSpeedLevels(m_store->GetEntry(segment), levels);
+        aliasTable = new float[levels.intervals * GetIntervalSize()];
+        Data::BuildAliasTables(levels, m_aliasColumns, aliasTable);
+    }
+    return aliasTable;
+}
+
+Routing::ProfileStorage Routing::ProfileDatabase::GetStorage() const {
+    return m_storage;
+}
+
+int Routing::ProfileDatabase::GetAliasColumns() const {
+    return m_aliasColumns;
+}
+
+int Routing::ProfileDatabase::GetIntervalSize() const {
+    return m_storage == ProfileStorage::Alias ? m_aliasColumns * ALIAS_ENTRY_SIZE : INDEX_RESOLUTION;
+}
+
+int Routing::ProfileDatabase::GetLength(int segment) const {
+    if (m_store != nullptr)
+        return m_store->GetEntry(segment).length;
+    return m_lengths[segment];
+}
+
+float Routing::ProfileDatabase::GetFreeSpeed(int segment) const {
+    if (m_store != nullptr)
+        return m_store->GetEntry(segment).freeSpeed;
+    return m_freeSpeeds[segment];
+}
+
+float Routing::ProfileDatabase::GetSecondInterval() const {
+    return m_secondInterval;
+}
+
+int Routing::ProfileDatabase::GetSegmentCount() const {
+    if (m_store != nullptr)
+        return static_cast<int>(m_store->GetSegmentCount());
+    return static_cast<int>(m_lengths.size());
+}
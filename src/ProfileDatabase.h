@@ -0,0 +1,157 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Data.h"
+
+namespace Routing {
+    class ProfileStore;
+
+    /**
+     * Representation of the speed distribution of a single interval in memory
+     */
+    enum class ProfileStorage {
+        Expanded, // INDEX_RESOLUTION speeds, every speed repeated proportionally to its probability
+        Alias // Walker alias table, a few columns of (threshold, speed, alias speed), exact probabilities
+    };
+
+    /**
+     * Speed profiles of the whole road network, loaded once and shared by any number of routes.
+     * Segments are addressed by their position in the database, see Find.
+     */
+    class ProfileDatabase {
+    public:
+        /**
+         * Constructor, loads the speed profiles of the network
+         * @param profilesPath binary profile store or directory with CSV speed profiles
+         * @param segmentsFiles CSV files with segment IDs, lengths and freeflow speeds of the network,
+         * required for the CSV profiles, ignored for the profile store
+         * @param storage representation of the profiles in memory, alias tables of the profile store are built from
+         * the speed distributions stored next to its expanded profiles (store version 2), whose rounded probabilities
+         * would give different tables than the CSV files. Tables of the store are built when a segment is first
+         * used, so the start-up does not grow with the network.
+         */
+        explicit ProfileDatabase(const std::string &profilesPath,
+                                 const std::vector<std::string> &segmentsFiles = std::vector<std::string>(),
+                                 ProfileStorage storage = ProfileStorage::Expanded);
+
+        /**
+         * Destructor frees memory for the loaded profiles
+         */
+        ~ProfileDatabase();
+
+        ProfileDatabase(const ProfileDatabase &) = delete;
+
+        ProfileDatabase &operator=(const ProfileDatabase &) = delete;
+
+        /**
+         * Find segment in the database
+         * @param tmcId segment ID
+         * @return position of the segment or -1 if the segment is not in the database
+         */
+        int Find(const std::string &tmcId) const;
+
+        /**
+         * Get the speed profile, the alias table of a profile store segment is built on the first call. Thread safe.
+         * @param segment position of the segment
+         * @return speed profile of the segment for the whole week, GetIntervalSize values per interval
+         */
+        const float *GetSpeedProfile(int segment) const;
+
+        /**
+         * @return representation of the speed profiles
+         */
+        ProfileStorage GetStorage() const;
+
+        /**
+         * @return number of alias table columns per interval, 0 for the expanded profiles
+         */
+        int GetAliasColumns() const;
+
+        /**
+         * @return number of values per interval of the speed profiles
+         */
+        int GetIntervalSize() const;
+
+        /**
+         * @param segment position of the segment
+         * @return length of the segment in meters
+         */
+        int GetLength(int segment) const;
+
+        /**
+         * @param segment position of the segment
+         * @return freeflow speed of the segment
+         */
+        float GetFreeSpeed(int segment) const;
+
+        /**
+         * @return length of time interval for which a single profile is valid in seconds
+         */
+        float GetSecondInterval() const;
+
+        /**
+         * @return number of segments in the database
+         */
+        int GetSegmentCount() const;
+
+    private:
+        /**
+         * Build alias tables of all the segments with a common column count
+         * @param levels speed distributions of the segments in the order of the database
+         */
+        void BuildAliasTables(const std::vector<Data::SpeedLevels> &levels);
+
+        /**
+         * Length of time interval for which a single profile is valid in seconds
+         */
+        float m_secondInterval = 0;
+
+        /**
+         * Representation of the speed profiles
+         */
+        ProfileStorage m_storage;
+
+        /**
+         * Number of alias table columns per interval, 0 for the expanded profiles
+         */
+        int m_aliasColumns = 0;
+
+        /**
+         * Positions of the segments indexed by segment ID, empty for the profile store
+         */
+        std::unordered_map<std::string, int> m_index;
+
+        /**
+         * Speed profiles of the segments, empty for the expanded profiles of the profile store
+         */
+        std::vector<const float *> m_speedProfiles;
+
+        /**
+         * Lengths of the segments
+         */
+        std::vector<int> m_lengths;
+
+        /**
+         * Segment freeflow speeds
+         */
+        std::vector<float> m_freeSpeeds;
+
+        /**
+         * Memory mapped profile store, if the profiles were not loaded from CSV files
+         */
+        ProfileStore *m_store = nullptr;
+
+        /**
+         * Alias tables of the profile store segments used so far, indexed by the position of the segment
+         */
+        mutable std::unordered_map<int, float *> m_storeAliasTables;
+
+        /**
+         * Guards the alias tables of the profile store
+         */
+        mutable std::mutex m_storeAliasMutex;
+    };
+}
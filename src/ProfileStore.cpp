@@ -0,0 +1,274 @@
+#include "ProfileStore.h"
+#include "Data.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    uint64_t AlignOffset(uint64_t offset) {
+        return (offset + PROFILE_STORE_ALIGNMENT - 1) / PROFILE_STORE_ALIGNMENT * PROFILE_STORE_ALIGNMENT;
+    }
+
+    uint64_t LevelsSize(uint64_t intervals, uint64_t maxLevels) {
+        return sizeof(int32_t) * intervals + 2 * sizeof(float) * intervals * maxLevels;
+    }
+}
+
+Routing::ProfileStore::ProfileStore(const std::string &storeFile) {
+    int fd = open(storeFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "ERROR: Cannot open profile store " << storeFile << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+        std::cerr << "ERROR: Profile store " << storeFile << " is truncated" << std::endl;
+        close(fd);
+        std::exit(EXIT_FAILURE);
+    }
+
+    m_size = st.st_size;
+    void *addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "ERROR: Cannot map profile store " << storeFile << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    m_data = static_cast<const char *>(addr);
+    m_header = reinterpret_cast<const Header *>(m_data);
+
+    if (std::memcmp(m_header->magic, PROFILE_STORE_MAGIC, sizeof(m_header->magic)) != 0) {
+        std::cerr << "ERROR: " << storeFile << " is not a profile store" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (m_header->version != PROFILE_STORE_VERSION) {
+        std::cerr << "ERROR: Unsupported profile store version " << m_header->version << " (expected "
+                  << PROFILE_STORE_VERSION << "), convert the profiles again by ptdr-convert" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (m_header->indexResolution != INDEX_RESOLUTION) {
+        std::cerr << "ERROR: Profile store index resolution " << m_header->indexResolution << " differs from "
+                  << INDEX_RESOLUTION << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    uint64_t profileSize = sizeof(float) * INDEX_RESOLUTION * 7 * m_header->intervalsPerDay;
+    uint64_t indexEnd = m_header->indexOffset + m_header->segmentCount * sizeof(Entry);
+    if (m_header->indexOffset > m_size || m_header->segmentCount > m_size / sizeof(Entry) || indexEnd > m_size) {
+        std::cerr << "ERROR: Profile store " << storeFile << " is truncated" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Every entry is checked, so a corrupt index fails here instead of reading out of the mapping later
+    m_index = reinterpret_cast<const Entry *>(m_data + m_header->indexOffset);
+    for (uint64_t i = 0; i < m_header->segmentCount; ++i) {
+        const Entry &entry = m_index[i];
+        bool valid = entry.maxLevels >= 0 && entry.maxLevels <= m_header->maxLevels;
+        uint64_t levelsSize = valid ? LevelsSize(7 * m_header->intervalsPerDay, entry.maxLevels) : 0;
+        if (!valid || entry.dataOffset > m_size || profileSize > m_size - entry.dataOffset ||
+            entry.levelsOffset > m_size || levelsSize > m_size - entry.levelsOffset) {
+            std::cerr << "ERROR: Profile store " << storeFile << " is truncated" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+}
+
+Routing::ProfileStore::~ProfileStore() {
+    if (m_data != nullptr)
+        munmap(const_cast<char *>(m_data), m_size);
+}
+
+const Routing::ProfileStore::Entry *Routing::ProfileStore::Find(const std::string &tmcId) const {
+    const Entry *begin = m_index;
+    const Entry *end = m_index + m_header->segmentCount;
+    const Entry *it = std::lower_bound(begin, end, tmcId, [](const Entry &e, const std::string &id) {
+        return std::strncmp(e.tmcId, id.c_str(), PROFILE_STORE_ID_LENGTH) < 0;
+    });
+    if (it == end || std::strncmp(it->tmcId, tmcId.c_str(), PROFILE_STORE_ID_LENGTH) != 0)
+        return nullptr;
+    return it;
+}
+
+const Routing::ProfileStore::Entry &Routing::ProfileStore::GetEntry(std::size_t i) const {
+    return m_index[i];
+}
+
+const float *Routing::ProfileStore::GetSpeedProfile(const Entry &entry) const {
+    return reinterpret_cast<const float *>(m_data + entry.dataOffset);
+}
+
+void Routing::ProfileStore::GetSpeedLevels(const Entry &entry, Data::SpeedLevels &levels) const {
+    levels.intervals = static_cast<int>(7 * m_header->intervalsPerDay);
+    levels.maxLevels = entry.maxLevels;
+
+    std::size_t values = static_cast<std::size_t>(levels.intervals) * levels.maxLevels;
+    const int32_t *counts = reinterpret_cast<const int32_t *>(m_data + entry.levelsOffset);
+    const float *speeds = reinterpret_cast<const float *>(counts + levels.intervals);
+    const float *probabilities = speeds + values;
+    levels.counts.assign(counts, counts + levels.intervals);
+    levels.speeds.assign(speeds, speeds + values);
+    levels.probabilities.assign(probabilities, probabilities + values);
+}
+
+float Routing::ProfileStore::GetSecondInterval() const {
+    return m_header->secondInterval;
+}
+
+std::size_t Routing::ProfileStore::GetSegmentCount() const {
+    return m_header->segmentCount;
+}
+
+int Routing::ProfileStore::GetMaxLevels() const {
+    return m_header->maxLevels;
+}
+
+bool Routing::ProfileStore::IsProfileStore(const std::string &file) {
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+
+    char magic[8] = {0};
+    std::ifstream stream(file, std::ios::binary);
+    stream.read(magic, sizeof(magic));
+    return stream && std::memcmp(magic, PROFILE_STORE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool Routing::ProfileStore::Convert(std::vector<Source> sources, const std::string &storeFile) {
+    // Index is sorted by segment ID for binary search, duplicates are dropped
+    std::sort(sources.begin(), sources.end(), [](const Source &a, const Source &b) { return a.tmcId < b.tmcId; });
+    sources.erase(std::unique(sources.begin(), sources.end(),
+                              [](const Source &a, const Source &b) { return a.tmcId == b.tmcId; }), sources.end());
+
+    if (sources.empty()) {
+        std::cerr << "ERROR: No segments to convert" << std::endl;
+        return false;
+    }
+
+    for (const auto &src : sources) {
+        if (src.tmcId.size() >= PROFILE_STORE_ID_LENGTH) {
+            std::cerr << "ERROR: Segment ID " << src.tmcId << " is too long" << std::endl;
+            return false;
+        }
+    }
+
+    std::string tempFile = storeFile + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "ERROR: Unable to open file " << tempFile << std::endl;
+        return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PROFILE_STORE_MAGIC, sizeof(header.magic));
+    header.version = PROFILE_STORE_VERSION;
+    header.indexResolution = INDEX_RESOLUTION;
+    header.segmentCount = sources.size();
+    header.indexOffset = AlignOffset(sizeof(Header));
+
+    std::vector<Entry> index(sources.size());
+    uint64_t dataOffset = AlignOffset(header.indexOffset + index.size() * sizeof(Entry));
+    uint64_t profileSize = 0;
+    const char padding[PROFILE_STORE_ALIGNMENT] = {0};
+
+    // Profiles are parsed in parallel in batches and written one after another, only a batch is kept in memory
+    out.seekp(dataOffset);
+    float *batch[PROFILE_STORE_BATCH_SIZE];
+    Data::SpeedLevels batchLevels[PROFILE_STORE_BATCH_SIZE];
+    float secondIntervals[PROFILE_STORE_BATCH_SIZE];
+    char loaded[PROFILE_STORE_BATCH_SIZE];
+    std::vector<std::string> messages(PROFILE_STORE_BATCH_SIZE);
+    for (std::size_t first = 0; first < sources.size(); first += PROFILE_STORE_BATCH_SIZE) {
+        int count = static_cast<int>(std::min<std::size_t>(PROFILE_STORE_BATCH_SIZE, sources.size() - first));
+#pragma omp parallel for schedule(dynamic)
+        for (int b = 0; b < count; ++b) {
+            std::ostringstream log;
+            batch[b] = nullptr;
+            loaded[b] = Data::LoadSpeedLevels(sources[first + b].profileFile, batchLevels[b],
+                                              sources[first + b].freeSpeed, secondIntervals[b], log);
+            if (loaded[b]) {
+                batch[b] = new float[INDEX_RESOLUTION * batchLevels[b].intervals];
+                Data::ExpandSpeedLevels(batchLevels[b], batch[b], log);
+            }
+            messages[b] = log.str();
+        }
+
+        bool valid = true;
+        for (int b = 0; b < count; ++b) {
+            std::size_t i = first + b;
+            std::cerr << messages[b];
+            if (!loaded[b]) {
+                valid = false;
+                break;
+            }
+
+            if (i == 0) {
+                header.secondInterval = secondIntervals[b];
+                header.intervalsPerDay = 86400 / secondIntervals[b];
+                profileSize = sizeof(float) * INDEX_RESOLUTION * 7 * header.intervalsPerDay;
+            } else if (secondIntervals[b] != header.secondInterval) {
+                std::cerr << "ERROR: Profile " << sources[i].profileFile << " has interval " << secondIntervals[b]
+                          << " s, expected " << header.secondInterval << " s" << std::endl;
+                valid = false;
+                break;
+            }
+
+            Entry &entry = index[i];
+            std::memset(&entry, 0, sizeof(entry));
+            std::strncpy(entry.tmcId, sources[i].tmcId.c_str(), PROFILE_STORE_ID_LENGTH - 1);
+            entry.length = sources[i].length;
+            entry.freeSpeed = sources[i].freeSpeed;
+            entry.dataOffset = dataOffset;
+
+            out.write(reinterpret_cast<const char *>(batch[b]), profileSize);
+
+            // Speed distributions follow the expanded profile, alias tables are built from them
+            const Data::SpeedLevels &levels = batchLevels[b];
+            std::vector<int32_t> counts(levels.counts.begin(), levels.counts.end());
+            uint64_t levelsSize = LevelsSize(levels.intervals, levels.maxLevels);
+            entry.levelsOffset = dataOffset + profileSize;
+            entry.maxLevels = levels.maxLevels;
+            header.maxLevels = std::max(header.maxLevels, levels.maxLevels);
+            out.write(reinterpret_cast<const char *>(counts.data()), sizeof(int32_t) * counts.size());
+            out.write(reinterpret_cast<const char *>(levels.speeds.data()), sizeof(float) * levels.speeds.size());
+            out.write(reinterpret_cast<const char *>(levels.probabilities.data()),
+                      sizeof(float) * levels.probabilities.size());
+
+            uint64_t next = AlignOffset(entry.levelsOffset + levelsSize);
+            out.write(padding, next - entry.levelsOffset - levelsSize);
+            dataOffset = next;
+        }
+
+        for (int b = 0; b < count; ++b) {
+            delete[] batch[b];
+        }
+        if (!valid) {
+            out.close();
+            std::remove(tempFile.c_str());
+            return false;
+        }
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.seekp(header.indexOffset);
+    out.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(Entry));
+    out.close();
+
+    if (!out || std::rename(tempFile.c_str(), storeFile.c_str()) != 0) {
+        std::cerr << "ERROR: Failed to write profile store " << storeFile << std::endl;
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Data.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define PROFILE_STORE_MAGIC "PTDRPROF" // File signature of the binary profile store
+#define PROFILE_STORE_VERSION 2 // Current version of the binary profile store layout
+#define PROFILE_STORE_ID_LENGTH 32 // Maximal length of the segment ID including terminating zero
+#define PROFILE_STORE_ALIGNMENT 64 // Alignment of the speed arrays in the file
+#define PROFILE_STORE_BATCH_SIZE 64 // Number of profiles parsed in parallel by Convert
+
+namespace Routing {
+
+    /**
+     * Versioned binary file with expanded speed profiles of many segments, mapped directly into memory.
+     *
+     * Layout: header, segment index sorted by segment ID, speed arrays. Every speed array has the same
+     * layout as the one produced by Data::LoadSpeedProfile, i.e. INDEX_RESOLUTION values per time interval
+     * for all intervals of the week. The speed array of a segment is followed by its speed distributions as
+     * read from the CSV file: number of levels of every interval (int32), then maxLevels speeds and maxLevels
+     * probabilities of every interval (float). Version 1 stores lack the distributions.
+     */
+    class ProfileStore {
+    public:
+        /**
+         * File header
+         */
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t indexResolution;
+            float secondInterval;
+            uint32_t intervalsPerDay;
+            uint64_t segmentCount;
+            uint64_t indexOffset;
+            int32_t maxLevels; // Largest number of speeds in an interval of any segment
+            int32_t reserved;
+        };
+
+        /**
+         * Single entry of the segment index
+         */
+        struct Entry {
+            char tmcId[PROFILE_STORE_ID_LENGTH];
+            int32_t length;
+            float freeSpeed;
+            uint64_t dataOffset;
+            uint64_t levelsOffset;
+            int32_t maxLevels;
+            int32_t reserved;
+        };
+
+        /**
+         * Description of a segment to be written into the store
+         */
+        struct Source {
+            std::string tmcId;
+            std::string profileFile;
+            int length;
+            float freeSpeed;
+        };
+
+        /**
+         * Constructor, maps the store file into memory and validates its header
+         * @param storeFile path to the binary profile store
+         */
+        explicit ProfileStore(const std::string &storeFile);
+
+        /**
+         * Destructor unmaps the store file
+         */
+        ~ProfileStore();
+
+        ProfileStore(const ProfileStore &) = delete;
+
+        ProfileStore &operator=(const ProfileStore &) = delete;
+
+        /**
+         * Find segment in the index
+         * @param tmcId segment ID
+         * @return index entry or nullptr if the segment is not in the store
+         */
+        const Entry *Find(const std::string &tmcId) const;
+
+        /**
+         * Entry of the segment index
+         * @param i position in the index, less than GetSegmentCount
+         * @return index entry
+         */
+        const Entry &GetEntry(std::size_t i) const;
+
+        /**
+         * Speed profile of the segment
+         * @param entry index entry obtained from Find
+         * @return pointer to the mapped speed array
+         */
+        const float *GetSpeedProfile(const Entry &entry) const;
+
+        /**
+         * Speed distributions of the segment, unlike the speed array they keep the exact probabilities
+         * @param entry index entry obtained from Find
+         * @param levels is set to the speed distributions of every interval of the week
+         */
+        void GetSpeedLevels(const Entry &entry, Data::SpeedLevels &levels) const;
+
+        /**
+         * @return length of time interval for which a single profile is valid in seconds
+         */
+        float GetSecondInterval() const;
+
+        /**
+         * @return number of segments in the store
+         */
+        std::size_t GetSegmentCount() const;
+
+        /**
+         * @return largest number of speeds in an interval of any segment, gives the alias table columns
+         */
+        int GetMaxLevels() const;
+
+        /**
+         * Check whether the file starts with the profile store signature
+         * @param file path to the file
+         * @return true if the file is a profile store
+         */
+        static bool IsProfileStore(const std::string &file);
+
+        /**
+         * Parse the CSV speed profiles and write them into a new store. The store is written to a temporary file
+         * renamed to storeFile on success, so a failed conversion never leaves a partial store behind.
+         * @param sources segments to convert
+         * @param storeFile path of the store to write
+         * @return true on success
+         */
+        static bool Convert(std::vector<Source> sources, const std::string &storeFile);
+
+    private:
+        /**
+         * Beginning of the mapped file
+         */
+        const char *m_data = nullptr;
+
+        /**
+         * Size of the mapped file in bytes
+         */
+        std::size_t m_size = 0;
+
+        /**
+         * Header at the beginning of the mapped file
+         */
+        const Header *m_header = nullptr;
+
+        /**
+         * Segment index sorted by segment ID
+         */
+        const Entry *m_index = nullptr;
+    };
+}
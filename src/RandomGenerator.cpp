@@ -0,0 +1,158 @@
+#include "RandomGenerator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#if defined USE_MKL || defined __INTEL_COMPILER // If we are using Intel compiler, MKL will be most certainly available as well
+#define INTEL_RND
+#include <mkl_vsl.h>
+#include <mkl.h>
+#endif
+
+#include <random>
+
+Routing::RandomGenerator::RandomGenerator(RngBackend backend, uint64_t seed, int thread) : m_backend(backend) {
+    m_key[0] = static_cast<uint32_t>(seed);
+    m_key[1] = static_cast<uint32_t>(seed >> 32);
+
+    switch (m_backend) {
+        case RngBackend::GNU:
+            m_stream = new std::mt19937_64(seed + thread);
+            break;
+        case RngBackend::MKL:
+#ifdef INTEL_RND
+        {
+            VSLStreamStatePtr rndStream;
+            vslNewStream(&rndStream, VSL_BRNG_MT2203 + thread, static_cast<MKL_UINT>(seed));
+            m_stream = rndStream;
+        }
+#else
+            std::cerr << "ERROR: MKL random number generator is not available, rebuild with USE_MKL" << std::endl;
+            std::exit(EXIT_FAILURE);
+#endif
+            break;
+        case RngBackend::Philox:
+            break;
+    }
+}
+
+Routing::RandomGenerator::~RandomGenerator() {
+    if (m_stream == nullptr)
+        return;
+
+    if (m_backend == RngBackend::GNU) {
+        delete static_cast<std::mt19937_64 *>(m_stream);
+    }
+#ifdef INTEL_RND
+    else if (m_backend == RngBackend::MKL) {
+        VSLStreamStatePtr rndStream = static_cast<VSLStreamStatePtr>(m_stream);
+        vslDeleteStream(&rndStream);
+    }
+#endif
+}
+
+void Routing::RandomGenerator::Fill(uint32_t *draws, int segmentCount, uint32_t sample, uint32_t departure) {
+    switch (m_backend) {
+        case RngBackend::GNU: {
+            // Upper half of the 64-bit output has the better statistical quality
+            std::mt19937_64 &rnd = *static_cast<std::mt19937_64 *>(m_stream);
+            for (int r = 0; r < segmentCount; ++r) {
+                draws[r] = static_cast<uint32_t>(rnd() >> 32);
+            }
+            m_wordsGenerated += 2 * static_cast<uint64_t>(segmentCount);
+            break;
+        }
+        case RngBackend::MKL:
+#ifdef INTEL_RND
+            viRngUniformBits32(VSL_RNG_METHOD_UNIFORMBITS32_STD, static_cast<VSLStreamStatePtr>(m_stream),
+                               segmentCount, reinterpret_cast<unsigned int *>(draws));
+#endif
+            m_wordsGenerated += segmentCount;
+            break;
+        case RngBackend::Philox: {
+            // Counter (segment block, crossing, departure, sample) - the draws do not depend on the thread executing
+            // the sample. Blocks are independent, so the loop is generated in batches of four words.
+            uint32_t counter[4] = {0, 0, departure, sample};
+            uint32_t words[4];
+            for (int r = 0; r < segmentCount; r += 4) {
+                counter[0] = static_cast<uint32_t>(r / 4);
+                Philox4x32::Generate(counter, m_key, words);
+                for (int w = 0; w < 4 && r + w < segmentCount; ++w) {
+                    draws[r + w] = words[w];
+                }
+                m_wordsGenerated += 4;
+            }
+            break;
+        }
+    }
+}
+
+uint32_t Routing::RandomGenerator::Draw(uint32_t sample, uint32_t departure, int segment, int crossing) {
+    m_crossingDraws++;
+    switch (m_backend) {
+        case RngBackend::GNU:
+            m_wordsGenerated += 2;
+            return static_cast<uint32_t>((*static_cast<std::mt19937_64 *>(m_stream))() >> 32);
+        case RngBackend::MKL:
+#ifdef INTEL_RND
+            if (m_bufferPos == RNG_BUFFER_SIZE) {
+                viRngUniformBits32(VSL_RNG_METHOD_UNIFORMBITS32_STD, static_cast<VSLStreamStatePtr>(m_stream),
+                                   RNG_BUFFER_SIZE, reinterpret_cast<unsigned int *>(m_buffer));
+                m_bufferPos = 0;
+                m_wordsGenerated += RNG_BUFFER_SIZE;
+            }
+            return m_buffer[m_bufferPos++];
+#endif
+            break;
+        case RngBackend::Philox: {
+            // Same block structure as Fill, neighbouring segments crossing in the same step share the block
+            uint32_t counter[4] = {static_cast<uint32_t>(segment / 4), static_cast<uint32_t>(crossing), departure,
+                                   sample};
+            if (!m_cached || counter[0] != m_counter[0] || counter[1] != m_counter[1] ||
+                counter[2] != m_counter[2] || counter[3] != m_counter[3]) {
+                Philox4x32::Generate(counter, m_key, m_words);
+                std::copy(counter, counter + 4, m_counter);
+                m_cached = true;
+                m_wordsGenerated += 4;
+            }
+            return m_words[segment % 4];
+        }
+    }
+    return 0;
+}
+
+uint64_t Routing::RandomGenerator::GetWordsGenerated() const {
+    return m_wordsGenerated;
+}
+
+uint64_t Routing::RandomGenerator::GetCrossingDraws() const {
+    return m_crossingDraws;
+}
+
+Routing::RngBackend Routing::RandomGenerator::DefaultBackend() {
+#ifdef INTEL_RND
+    return RngBackend::MKL;
+#else
+    return RngBackend::GNU;
+#endif
+}
+
+std::string Routing::RandomGenerator::Name(RngBackend backend) {
+    switch (backend) {
+        case RngBackend::GNU:
+            return "GNU";
+        case RngBackend::MKL:
+            return "Intel MKL";
+        case RngBackend::Philox:
+            return "Philox4x32-10";
+    }
+    return "unknown";
+}
+
+bool Routing::RandomGenerator::FromName(const std::string &name, RngBackend &backend) {
+    if (name == "gnu") backend = RngBackend::GNU;
+    else if (name == "mkl") backend = RngBackend::MKL;
+    else if (name == "philox") backend = RngBackend::Philox;
+    else return false;
+    return true;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#define RNG_BUFFER_SIZE 1024 // Number of words generated at once by the MKL backend
+
+namespace Routing {
+
+    /**
+     * Random number generator backends available for the simulation
+     */
+    enum class RngBackend {
+        GNU, // std::mt19937_64, one sequential stream per thread
+        MKL, // Intel MKL VSL_BRNG_MT2203, one sequential stream per thread, only when built with MKL
+        Philox // Counter based Philox4x32-10, draws depend only on (seed, sample, departure, segment, crossing)
+    };
+
+    /**
+     * Counter based Philox4x32-10 generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC'11).
+     * Stateless, every 128-bit counter is mapped to four independent 32-bit random words.
+     */
+    struct Philox4x32 {
+        /**
+         * Generate four random words for the counter
+         * @param counter 128-bit counter
+         * @param key 64-bit key (seed)
+         * @param out four random words
+         */
+        static inline void Generate(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+            uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+            uint32_t k0 = key[0], k1 = key[1];
+            for (int r = 0; r < 10; ++r) {
+                uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+                uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+                uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+                uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+                c1 = static_cast<uint32_t>(p1);
+                c3 = static_cast<uint32_t>(p0);
+                c0 = n0;
+                c2 = n2;
+                k0 += 0x9E3779B9u;
+                k1 += 0xBB67AE85u;
+            }
+            out[0] = c0;
+            out[1] = c1;
+            out[2] = c2;
+            out[3] = c3;
+        }
+    };
+
+    /**
+     * Per-thread source of random 32-bit words selecting the speed from the profile. Every pass of a segment consumes
+     * one word for the first interval (crossing 0) and one more for every interval boundary crossed on the segment.
+     * The first words of all segments are always used and are generated at once by Fill, words of the crossings are
+     * generated on demand by Draw. Mapping of the words to the profile is left to the simulation, see
+     * Kernel::SampleSpeed.
+     */
+    class RandomGenerator {
+    public:
+        /**
+         * Constructor, initializes the stream of the thread
+         * @param backend generator backend
+         * @param seed seed of the simulation run
+         * @param thread thread number, selects independent stream of the sequential backends
+         */
+        RandomGenerator(RngBackend backend, uint64_t seed, int thread);
+
+        /**
+         * Destructor frees the backend stream
+         */
+        ~RandomGenerator();
+
+        RandomGenerator(const RandomGenerator &) = delete;
+
+        RandomGenerator &operator=(const RandomGenerator &) = delete;
+
+        /**
+         * Fill the array with the first random word of every segment
+         * @param draws array to fill
+         * @param segmentCount number of segments
+         * @param sample sample number, used only by the counter based backend
+         * @param departure departure interval, used only by the counter based backend
+         */
+        void Fill(uint32_t *draws, int segmentCount, uint32_t sample, uint32_t departure = 0);
+
+        /**
+         * Draw random word for an interval crossing
+         * @param sample sample number, used only by the counter based backend
+         * @param departure departure interval, used only by the counter based backend
+         * @param segment segment of the route
+         * @param crossing number of the crossing on the segment, starting from 1
+         * @return random word
+         */
+        uint32_t Draw(uint32_t sample, uint32_t departure, int segment, int crossing);
+
+        /**
+         * @return number of 32-bit words produced by the backend, including the unused half of the 64-bit GNU output
+         * and the unused words of the blocks and buffers
+         */
+        uint64_t GetWordsGenerated() const;
+
+        /**
+         * @return number of Draw calls, i.e. interval crossings
+         */
+        uint64_t GetCrossingDraws() const;
+
+        /**
+         * @return backend used when none is selected, MKL if available
+         */
+        static RngBackend DefaultBackend();
+
+        /**
+         * @param backend generator backend
+         * @return human readable name of the backend
+         */
+        static std::string Name(RngBackend backend);
+
+        /**
+         * Parse backend from the command line name
+         * @param name one of gnu, mkl, philox
+         * @param backend is set to the parsed backend
+         * @return false if the name is unknown
+         */
+        static bool FromName(const std::string &name, RngBackend &backend);
+
+    private:
+        /**
+         * Selected backend
+         */
+        RngBackend m_backend;
+
+        /**
+         * Key of the counter based backend
+         */
+        uint32_t m_key[2];
+
+        /**
+         * Stream of the sequential backend
+         */
+        void *m_stream = nullptr;
+
+        /**
+         * Words generated in advance by the MKL backend
+         */
+        uint32_t m_buffer[RNG_BUFFER_SIZE];
+
+        /**
+         * Position of the next unused word in the buffer
+         */
+        int m_bufferPos = RNG_BUFFER_SIZE;
+
+        /**
+         * Counter of the last block generated by the counter based backend
+         */
+        uint32_t m_counter[4] = {0, 0, 0, 0};
+
+        /**
+         * Words of the last block generated by the counter based backend
+         */
+        uint32_t m_words[4] = {0, 0, 0, 0};
+
+        /**
+         * True if m_words hold the block of m_counter
+         */
+        bool m_cached = false;
+
+        /**
+         * Statistics of the generator, see GetWordsGenerated and GetCrossingDraws
+         */
+        uint64_t m_wordsGenerated = 0;
+        uint64_t m_crossingDraws = 0;
+    };
+}
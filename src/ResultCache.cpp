@@ -0,0 +1,99 @@
+#include "ResultCache.h"
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+namespace {
+    /**
+     * Add bytes to the FNV-1a hash
+     */
+    inline void HashBytes(uint64_t &hash, const void *data, std::size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * FNV_PRIME;
+        }
+    }
+}
+
+Routing::ResultCache::ResultCache(std::size_t memoryBudget) : m_memoryBudget(memoryBudget) {}
+
+uint64_t Routing::ResultCache::Fingerprint(const std::vector<Data::Segment> &segments) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const auto &segment : segments) {
+        // Terminating zero separates the IDs, so concatenations of different IDs do not collide
+        HashBytes(hash, segment.tmcId.c_str(), segment.tmcId.size() + 1);
+        HashBytes(hash, &segment.length, sizeof(segment.length));
+        HashBytes(hash, &segment.freeSpeed, sizeof(segment.freeSpeed));
+    }
+    return hash;
+}
+
+bool Routing::ResultCache::Lookup(const Key &key, std::vector<float> &travelTimes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        m_misses++;
+        return false;
+    }
+
+    m_hits++;
+    m_lru.splice(m_lru.end(), m_lru, it->second.lru);
+    travelTimes = it->second.travelTimes;
+    return true;
+}
+
+void Routing::ResultCache::Insert(const Key &key, const std::vector<float> &travelTimes) {
+    std::size_t bytes = travelTimes.size() * sizeof(float);
+    if (bytes > m_memoryBudget)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        // Result computed concurrently by another query is replaced
+        m_residentBytes -= it->second.travelTimes.size() * sizeof(float);
+        m_lru.erase(it->second.lru);
+        m_entries.erase(it);
+    }
+
+    m_entries[key] = {travelTimes, m_lru.insert(m_lru.end(), key)};
+    m_residentBytes += bytes;
+    Evict();
+}
+
+void Routing::ResultCache::Invalidate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_residentBytes = 0;
+}
+
+void Routing::ResultCache::Evict() {
+    while (m_residentBytes > m_memoryBudget && !m_lru.empty()) {
+        auto it = m_entries.find(m_lru.front());
+        m_lru.pop_front();
+        m_residentBytes -= it->second.travelTimes.size() * sizeof(float);
+        m_entries.erase(it);
+        m_evictions++;
+    }
+}
+
+uint64_t Routing::ResultCache::GetHits() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+uint64_t Routing::ResultCache::GetMisses() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+uint64_t Routing::ResultCache::GetEvictions() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_evictions;
+}
+
+std::size_t Routing::ResultCache::GetResidentBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_residentBytes;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Data.h"
+
+#define RESULT_CACHE_DEFAULT_BUDGET (64ull << 20) // Default memory budget of the cached results in bytes
+
+namespace Routing {
+
+    /**
+     * Cache of simulated travel times for repeated queries. Results are keyed by the route fingerprint, the profile
+     * interval of the departure and the number of samples, so all departures within one interval share the result
+     * of the first one. Least recently used results are evicted when the memory budget is exceeded, Invalidate drops
+     * all of them when the profiles change. All methods are thread safe.
+     */
+    class ResultCache {
+    public:
+        /**
+         * Key of a cached result
+         */
+        struct Key {
+            uint64_t route; // Fingerprint of the route
+            int interval; // Departure interval of the week
+            int samples; // Number of samples
+
+            bool operator==(const Key &other) const {
+                return route == other.route && interval == other.interval && samples == other.samples;
+            }
+        };
+
+        /**
+         * Constructor
+         * @param memoryBudget bytes of the cached travel times
+         */
+        explicit ResultCache(std::size_t memoryBudget = RESULT_CACHE_DEFAULT_BUDGET);
+
+        ResultCache(const ResultCache &) = delete;
+
+        ResultCache &operator=(const ResultCache &) = delete;
+
+        /**
+         * Fingerprint of the route, 64-bit FNV-1a hash of the ordered segment IDs, lengths and freeflow speeds
+         * @param segments segments of the route
+         * @return fingerprint
+         */
+        static uint64_t Fingerprint(const std::vector<Data::Segment> &segments);
+
+        /**
+         * Find the result of a query
+         * @param key route, departure interval and number of samples
+         * @param travelTimes is set to the cached travel times on a hit
+         * @return false on a miss
+         */
+        bool Lookup(const Key &key, std::vector<float> &travelTimes);
+
+        /**
+         * Store the result of a query, results larger than the budget are not stored
+         * @param key route, departure interval and number of samples
+         * @param travelTimes travel times of the samples
+         */
+        void Insert(const Key &key, const std::vector<float> &travelTimes);
+
+        /**
+         * Drop all the cached results
+         */
+        void Invalidate();
+
+        /**
+         * @return number of Lookup calls that found the result
+         */
+        uint64_t GetHits() const;
+
+        /**
+         * @return number of Lookup calls that did not find the result
+         */
+        uint64_t GetMisses() const;
+
+        /**
+         * @return number of results evicted to keep the memory budget
+         */
+        uint64_t GetEvictions() const;
+
+        /**
+         * @return bytes of the cached travel times
+         */
+        std::size_t GetResidentBytes() const;
+
+    private:
+        /**
+         * Hash of the key, the route is already a hash
+         */
+        struct KeyHash {
+            std::size_t operator()(const Key &key) const {
+                return static_cast<std::size_t>(key.route ^ (static_cast<uint64_t>(key.interval) << 32) ^
+                                                static_cast<uint64_t>(key.samples) * 0x9E3779B97F4A7C15ULL);
+            }
+        };
+
+        /**
+         * Cached result of a single query
+         */
+        struct Entry {
+            std::vector<float> travelTimes;
+            std::list<Key>::iterator lru; // Position in m_lru
+        };
+
+        /**
+         * Evict least recently used results until the budget is kept, the lock must be held
+         */
+        void Evict();
+
+        /**
+         * Bytes of the cached travel times
+         */
+        std::size_t m_memoryBudget;
+
+        /**
+         * Cached results
+         */
+        std::unordered_map<Key, Entry, KeyHash> m_entries;
+
+        /**
+         * Keys of the results, least recently used first
+         */
+        std::list<Key> m_lru;
+
+        /**
+         * Bytes of all the cached travel times
+         */
+        std::size_t m_residentBytes = 0;
+
+        /**
+         * Statistics of the cache
+         */
+        uint64_t m_hits = 0;
+        uint64_t m_misses = 0;
+        uint64_t m_evictions = 0;
+
+        /**
+         * Guards all the members
+         */
+        mutable std::mutex m_mutex;
+    };
+}
@@ -0,0 +1,205 @@
+#include "ResultSink.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+bool Routing::ResultSink::Write(const ResultInfo &info, const std::vector<float> &travelTimes) {
+    Begin(info);
+    for (int i = 0; i < info.intervals; ++i) {
+        WriteInterval(travelTimes.data() + static_cast<std::size_t>(i) * info.samples);
+    }
+    return End();
+}
+
+Routing::TextResultSink::TextResultSink(const std::string &file) : m_file(file), m_out(file),
+                                                                   m_buffer(RESULT_SINK_BUFFER_SIZE) {
+    if (!m_out.is_open())
+        std::cerr << "ERROR: Unable to open file " << file << std::endl;
+}
+
+void Routing::TextResultSink::Begin(const ResultInfo &info) {
+    m_info = info;
+    m_interval = 0;
+    if (m_info.intervals == 1)
+        return;
+
+    // Header
+    Append("day;interval", 12);
+    for (int j = 1; j <= m_info.samples; ++j) {
+        Append(";", 1);
+        AppendInt(j);
+    }
+    Append("\n", 1);
+}
+
+void Routing::TextResultSink::WriteInterval(const float *travelTimes) {
+    char number[RESULT_FLOAT_MAX_CHARS];
+    if (m_info.intervals == 1) {
+        for (int s = 0; s < m_info.samples; ++s) {
+            Append(number, FormatFloat(travelTimes[s], number));
+            Append("\n", 1);
+        }
+        m_interval++;
+        return;
+    }
+
+    int intervalsPerDay = static_cast<int>(86400 / m_info.secondInterval);
+    int departure = static_cast<int>(m_info.firstDeparture / m_info.secondInterval) + m_interval++;
+    AppendInt(departure / intervalsPerDay);
+    Append(";", 1);
+    AppendInt(departure % intervalsPerDay);
+    Append(";", 1);
+    for (int s = 0; s < m_info.samples; ++s) {
+        if (s != 0)
+            Append(";", 1);
+        Append(number, FormatFloat(travelTimes[s], number));
+    }
+    Append("\n", 1);
+}
+
+bool Routing::TextResultSink::End() {
+    Flush();
+    m_out.close();
+    if (m_out.fail()) {
+        std::cerr << "ERROR: Failed to write result " << m_file << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Routing::TextResultSink::Append(const char *text, int length) {
+    if (m_used + length > m_buffer.size())
+        Flush();
+    std::memcpy(m_buffer.data() + m_used, text, length);
+    m_used += length;
+}
+
+void Routing::TextResultSink::AppendInt(int value) {
+    char number[RESULT_FLOAT_MAX_CHARS];
+    Append(number, std::snprintf(number, sizeof(number), "%d", value));
+}
+
+void Routing::TextResultSink::Flush() {
+    m_out.write(m_buffer.data(), m_used);
+    m_used = 0;
+}
+
+Routing::BinaryResultSink::BinaryResultSink(const std::string &file)
+        : m_file(file), m_out(file, std::ios::binary | std::ios::trunc) {
+    if (!m_out.is_open())
+        std::cerr << "ERROR: Unable to open file " << file << std::endl;
+}
+
+void Routing::BinaryResultSink::Begin(const ResultInfo &info) {
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RESULT_FILE_MAGIC, sizeof(header.magic));
+    header.version = RESULT_FILE_VERSION;
+    header.samples = static_cast<uint32_t>(info.samples);
+    header.intervals = static_cast<uint32_t>(info.intervals);
+    header.firstDeparture = info.firstDeparture;
+    header.secondInterval = info.secondInterval;
+    if (info.routeId.size() >= RESULT_ROUTE_ID_LENGTH)
+        std::cerr << "WARNING: Route ID " << info.routeId << " is truncated to " << RESULT_ROUTE_ID_LENGTH - 1
+                  << " characters" << std::endl;
+    std::strncpy(header.routeId, info.routeId.c_str(), RESULT_ROUTE_ID_LENGTH - 1);
+
+    m_samples = info.samples;
+    m_out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void Routing::BinaryResultSink::WriteInterval(const float *travelTimes) {
+    m_out.write(reinterpret_cast<const char *>(travelTimes), sizeof(float) * m_samples);
+}
+
+bool Routing::BinaryResultSink::End() {
+    m_out.close();
+    if (m_out.fail()) {
+        std::cerr << "ERROR: Failed to write result " << m_file << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Routing::BinaryResultSink::Read(const std::string &file, ResultInfo &info, std::vector<float> &travelTimes) {
+    std::ifstream in(file, std::ios::binary);
+    Header header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, RESULT_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << "ERROR: " << file << " is not a binary result" << std::endl;
+        return false;
+    }
+    if (header.version != RESULT_FILE_VERSION) {
+        std::cerr << "ERROR: Unsupported binary result version " << header.version << " of " << file << std::endl;
+        return false;
+    }
+
+    header.routeId[RESULT_ROUTE_ID_LENGTH - 1] = '\0';
+    info.routeId = header.routeId;
+    info.samples = static_cast<int>(header.samples);
+    info.intervals = static_cast<int>(header.intervals);
+    info.firstDeparture = header.firstDeparture;
+    info.secondInterval = header.secondInterval;
+
+    travelTimes.resize(static_cast<std::size_t>(header.samples) * header.intervals);
+    if (!in.read(reinterpret_cast<char *>(travelTimes.data()), sizeof(float) * travelTimes.size())) {
+        std::cerr << "ERROR: Binary result " << file << " is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int Routing::FormatFloat(float value, char *buffer) {
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+    double v = std::fabs(static_cast<double>(value));
+    int exponent = v > 0.0 && std::isfinite(v) ? static_cast<int>(std::floor(std::log10(v))) : 0;
+    if (!std::isfinite(v) || v == 0.0 || exponent < -4 || exponent > 5) {
+        // Special values and the exponential notation are rare for travel times
+        return std::snprintf(buffer, RESULT_FLOAT_MAX_CHARS, "%g", value);
+    }
+
+    // Six significant digits, rounded half to even like printf, log10 may be off by one near powers of ten
+    double digits = std::nearbyint(v * powers[5 - exponent]);
+    if (digits >= 1e6 && exponent < 5) {
+        exponent++;
+        digits = std::nearbyint(v * powers[5 - exponent]);
+    } else if (digits < 1e5 && exponent > -4) {
+        exponent--;
+        digits = std::nearbyint(v * powers[5 - exponent]);
+    }
+    if (digits >= 1e6 || digits < 1e5)
+        return std::snprintf(buffer, RESULT_FLOAT_MAX_CHARS, "%g", value);
+
+    char significant[6];
+    uint32_t d = static_cast<uint32_t>(digits);
+    for (int i = 5; i >= 0; --i) {
+        significant[i] = static_cast<char>('0' + d % 10);
+        d /= 10;
+    }
+    // Trailing zeros of the fraction are not printed
+    int count = 6;
+    while (count > exponent + 1 && count > 1 && significant[count - 1] == '0')
+        count--;
+
+    int pos = 0;
+    if (std::signbit(value))
+        buffer[pos++] = '-';
+    if (exponent >= 0) {
+        for (int i = 0; i < count; ++i) {
+            if (i == exponent + 1)
+                buffer[pos++] = '.';
+            buffer[pos++] = significant[i];
+        }
+    } else {
+        buffer[pos++] = '0';
+        buffer[pos++] = '.';
+        for (int i = 0; i < -exponent - 1; ++i)
+            buffer[pos++] = '0';
+        for (int i = 0; i < count; ++i)
+            buffer[pos++] = significant[i];
+    }
+    return pos;
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define RESULT_FILE_MAGIC "PTDRRSLT" // File signature of the binary result
+#define RESULT_FILE_VERSION 1 // Current version of the binary result layout
+#define RESULT_ROUTE_ID_LENGTH 64 // Maximal length of the route ID including terminating zero
+#define RESULT_SINK_BUFFER_SIZE (1 << 20) // Bytes collected by the text sink before writing to the file
+#define RESULT_FLOAT_MAX_CHARS 24 // Upper bound of the characters written by FormatFloat
+
+namespace Routing {
+
+    /**
+     * Description of a simulation result, travel times of consecutive departure intervals
+     */
+    struct ResultInfo {
+        std::string routeId;
+        int samples;
+        int intervals; // Number of departure intervals, 1 for a single departure
+        int firstDeparture; // Departure of the first interval in seconds from the beginning of the week
+        float secondInterval; // Length of the departure interval in seconds
+    };
+
+    /**
+     * Destination of the simulation results. Travel times are written interval by interval, so a sink never needs
+     * the whole result in memory.
+     */
+    class ResultSink {
+    public:
+        virtual ~ResultSink() {}
+
+        /**
+         * Start writing of a result
+         * @param info description of the result
+         */
+        virtual void Begin(const ResultInfo &info) = 0;
+
+        /**
+         * Write travel times of the next departure interval
+         * @param travelTimes info.samples travel times
+         */
+        virtual void WriteInterval(const float *travelTimes) = 0;
+
+        /**
+         * Finish the result and flush the output
+         * @return false if the output could not be written
+         */
+        virtual bool End() = 0;
+
+        /**
+         * Write the whole result at once
+         * @param info description of the result
+         * @param travelTimes info.samples travel times for every interval, interval after interval
+         * @return false if the output could not be written
+         */
+        bool Write(const ResultInfo &info, const std::vector<float> &travelTimes);
+    };
+
+    /**
+     * CSV output compatible with Data::WriteResultSingle (one travel time per line) for a single departure and with
+     * Data::WriteResultAll (header and one row per departure interval) otherwise. Numbers are formatted by FormatFloat
+     * into a large buffer, the stream is written only when the buffer is full.
+     */
+    class TextResultSink : public ResultSink {
+    public:
+        /**
+         * Constructor, opens the output file
+         * @param file path to write
+         */
+        explicit TextResultSink(const std::string &file);
+
+        void Begin(const ResultInfo &info) override;
+
+        void WriteInterval(const float *travelTimes) override;
+
+        bool End() override;
+
+    private:
+        /**
+         * Append characters to the buffer
+         */
+        void Append(const char *text, int length);
+
+        /**
+         * Append integer to the buffer
+         */
+        void AppendInt(int value);
+
+        /**
+         * Write the buffer to the file
+         */
+        void Flush();
+
+        /**
+         * Path of the output file
+         */
+        std::string m_file;
+
+        /**
+         * Output file stream
+         */
+        std::ofstream m_out;
+
+        /**
+         * Formatted text waiting to be written
+         */
+        std::vector<char> m_buffer;
+
+        /**
+         * Number of used characters of the buffer
+         */
+        std::size_t m_used = 0;
+
+        /**
+         * Description of the written result
+         */
+        ResultInfo m_info;
+
+        /**
+         * Number of intervals written so far
+         */
+        int m_interval = 0;
+    };
+
+    /**
+     * Raw binary output. Layout: Header, then info.samples little endian floats for every departure interval,
+     * i.e. one column of the sample matrix after another.
+     */
+    class BinaryResultSink : public ResultSink {
+    public:
+        /**
+         * File header
+         */
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t samples;
+            uint32_t intervals;
+            int32_t firstDeparture;
+            float secondInterval;
+            char routeId[RESULT_ROUTE_ID_LENGTH];
+        };
+
+        /**
+         * Constructor, opens the output file
+         * @param file path to write
+         */
+        explicit BinaryResultSink(const std::string &file);
+
+        void Begin(const ResultInfo &info) override;
+
+        void WriteInterval(const float *travelTimes) override;
+
+        bool End() override;
+
+        /**
+         * Read result written by the sink
+         * @param file path to the binary result
+         * @param info is set to the description of the result
+         * @param travelTimes is set to the travel times, interval after interval
+         * @return false if the file is not a valid binary result
+         */
+        static bool Read(const std::string &file, ResultInfo &info, std::vector<float> &travelTimes);
+
+    private:
+        /**
+         * Path of the output file
+         */
+        std::string m_file;
+
+        /**
+         * Output file stream
+         */
+        std::ofstream m_out;
+
+        /**
+         * Number of travel times of a single interval
+         */
+        int m_samples = 0;
+    };
+
+    /**
+     * Format float like std::ostream with the default precision (%g, 6 significant digits) without locale and
+     * stream overhead
+     * @param value number to format
+     * @param buffer at least RESULT_FLOAT_MAX_CHARS characters, not terminated
+     * @return number of written characters
+     */
+    int FormatFloat(float value, char *buffer);
+}
@@ -1,7 +1,231 @@
 #include "ResultStats.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
+#include <iostream>
+#include <limits>
+
+QuantileSketch::QuantileSketch(double relativeError) : m_relativeError(relativeError) {
+    if (relativeError <= 0.0 || relativeError >= 1.0) {
+        std::cerr << "ERROR: Invalid relative error of the quantile sketch " << relativeError << ", using "
+                  << QUANTILE_SKETCH_DEFAULT_ERROR << std::endl;
+        m_relativeError = QUANTILE_SKETCH_DEFAULT_ERROR;
+    }
+    m_gamma = (1.0 + m_relativeError) / (1.0 - m_relativeError);
+    m_logGamma = std::log(m_gamma);
+}
+
+int QuantileSketch::BucketIndex(double value) const {
+    return static_cast<int>(std::ceil(std::log(value) / m_logGamma));
+}
+
+void QuantileSketch::Reserve(int index) {
+    if (m_buckets.empty()) {
+        m_offset = index;
+        m_buckets.resize(1, 0);
+    } else if (index < m_offset) {
+        m_buckets.insert(m_buckets.begin(), m_offset - index, 0);
+        m_offset = index;
+    } else if (index >= m_offset + static_cast<int>(m_buckets.size())) {
+        m_buckets.resize(index - m_offset + 1, 0);
+    }
+}
+
+void QuantileSketch::Add(float value) {
+    if (!std::isfinite(value))
+        return;
+
+    if (value > 0.0f) {
+        int index = BucketIndex(value);
+        Reserve(index);
+        m_buckets[index - m_offset]++;
+    } else {
+        m_zeroCount++;
+    }
+
+    // Welford's update of the mean and the sum of squares
+    m_count++;
+    double delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_sumSquares += delta * (value - m_mean);
+    m_min = m_count == 1 ? value : std::min<double>(m_min, value);
+    m_max = m_count == 1 ? value : std::max<double>(m_max, value);
+}
+
+void QuantileSketch::Merge(const QuantileSketch &other) {
+    if (other.m_relativeError != m_relativeError) {
+        std::cerr << "ERROR: Cannot merge quantile sketches with different relative errors" << std::endl;
+        return;
+    }
+    if (other.m_count == 0)
+        return;
+
+    if (!other.m_buckets.empty()) {
+        Reserve(other.m_offset);
+        Reserve(other.m_offset + static_cast<int>(other.m_buckets.size()) - 1);
+        for (std::size_t i = 0; i < other.m_buckets.size(); ++i) {
+            m_buckets[other.m_offset - m_offset + i] += other.m_buckets[i];
+        }
+    }
+    m_zeroCount += other.m_zeroCount;
+
+    // Chan's parallel combination of the mean and the sum of squares
+    double count = static_cast<double>(m_count + other.m_count);
+    double delta = other.m_mean - m_mean;
+    m_sumSquares += other.m_sumSquares + delta * delta * m_count * other.m_count / count;
+    m_mean += delta * other.m_count / count;
+    m_min = m_count == 0 ? other.m_min : std::min(m_min, other.m_min);
+    m_max = m_count == 0 ? other.m_max : std::max(m_max, other.m_max);
+    m_count += other.m_count;
+}
+
+double QuantileSketch::Quantile(double p) const {
+    if (m_count == 0)
+        return 0.0;
+
+    uint64_t rank = std::min(static_cast<uint64_t>(m_count * p), m_count - 1);
+    if (rank < m_zeroCount)
+        return m_min;
+
+    uint64_t cumulative = m_zeroCount;
+    for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+        cumulative += m_buckets[i];
+        if (cumulative > rank) {
+            // Value with the same relative distance to both bounds of the bucket
+            double estimate = 2.0 * std::pow(m_gamma, m_offset + static_cast<int>(i)) / (m_gamma + 1.0);
+            return std::max(m_min, std::min(m_max, estimate));
+        }
+    }
+    return m_max;
+}
+
+uint64_t QuantileSketch::GetCount() const {
+    return m_count;
+}
+
+double QuantileSketch::GetMean() const {
+    return m_mean;
+}
+
+double QuantileSketch::GetSampleDev() const {
+    return m_count > 1 ? std::sqrt(m_sumSquares / (m_count - 1)) : 0.0;
+}
+
+double QuantileSketch::GetRelativeError() const {
+    return m_relativeError;
+}
+
+std::size_t QuantileSketch::GetBucketCount() const {
+    return m_buckets.size();
+}
+
+TravelTimeHistogram::TravelTimeHistogram(double binSeconds) : m_binSeconds(binSeconds) {
+    if (!(binSeconds > 0.0)) {
+        std::cerr << "ERROR: Invalid bin width of the travel time histogram " << binSeconds << ", using "
+                  << HISTOGRAM_BIN_SECONDS << std::endl;
+        m_binSeconds = HISTOGRAM_BIN_SECONDS;
+    }
+}
+
+void TravelTimeHistogram::Add(double value, double probability) {
+    int index = static_cast<int>(std::floor(value / m_binSeconds));
+    if (m_mass.empty()) {
+        m_offset = index;
+        m_mass.resize(1, 0.0);
+        m_moment.resize(1, 0.0);
+    } else if (index < m_offset) {
+        m_mass.insert(m_mass.begin(), m_offset - index, 0.0);
+        m_moment.insert(m_moment.begin(), m_offset - index, 0.0);
+        m_offset = index;
+    } else if (index >= m_offset + static_cast<int>(m_mass.size())) {
+        m_mass.resize(index - m_offset + 1, 0.0);
+        m_moment.resize(index - m_offset + 1, 0.0);
+    }
+    m_mass[index - m_offset] += probability;
+    m_moment[index - m_offset] += probability * value;
+}
+
+void TravelTimeHistogram::Clear() {
+    m_offset = 0;
+    m_mass.clear();
+    m_moment.clear();
+}
+
+void TravelTimeHistogram::Trim(double tailProbability) {
+    std::size_t first = 0;
+    double lower = 0.0;
+    while (first < m_mass.size() && lower + m_mass[first] <= tailProbability) {
+        lower += m_mass[first++];
+    }
+    std::size_t last = m_mass.size();
+    double upper = 0.0;
+    while (last > first && upper + m_mass[last - 1] <= tailProbability) {
+        upper += m_mass[--last];
+    }
+
+    m_mass.erase(m_mass.begin() + last, m_mass.end());
+    m_moment.erase(m_moment.begin() + last, m_moment.end());
+    m_mass.erase(m_mass.begin(), m_mass.begin() + first);
+    m_moment.erase(m_moment.begin(), m_moment.begin() + first);
+    m_offset += static_cast<int>(first);
+}
+
+double TravelTimeHistogram::Quantile(double p) const {
+    double rank = GetMass() * p;
+    double cumulative = 0.0;
+    for (std::size_t i = 0; i < m_mass.size(); ++i) {
+        cumulative += m_mass[i];
+        if (cumulative > rank && m_mass[i] > 0.0)
+            return GetBinValue(i);
+    }
+
+    // Rounding errors of the cumulative probability, the highest value
+    for (std::size_t i = m_mass.size(); i > 0; --i) {
+        if (m_mass[i - 1] > 0.0)
+            return GetBinValue(i - 1);
+    }
+    return 0.0;
+}
+
+double TravelTimeHistogram::GetMass() const {
+    return std::accumulate(m_mass.begin(), m_mass.end(), 0.0);
+}
+
+double TravelTimeHistogram::GetMean() const {
+    double mass = GetMass();
+    return mass > 0.0 ? std::accumulate(m_moment.begin(), m_moment.end(), 0.0) / mass : 0.0;
+}
+
+double TravelTimeHistogram::GetDeviation() const {
+    double mass = GetMass();
+    if (mass <= 0.0)
+        return 0.0;
+
+    double mean = GetMean();
+    double sumSquares = 0.0;
+    for (std::size_t i = 0; i < m_mass.size(); ++i) {
+        if (m_mass[i] > 0.0)
+            sumSquares += m_mass[i] * std::pow(GetBinValue(i) - mean, 2);
+    }
+    return std::sqrt(sumSquares / mass);
+}
+
+std::size_t TravelTimeHistogram::GetBinCount() const {
+    return m_mass.size();
+}
+
+double TravelTimeHistogram::GetBinMass(std::size_t bin) const {
+    return m_mass[bin];
+}
+
+double TravelTimeHistogram::GetBinValue(std::size_t bin) const {
+    return m_moment[bin] / m_mass[bin];
+}
+
+double TravelTimeHistogram::GetBinSeconds() const {
+    return m_binSeconds;
+}
 
 ResultStats::ResultStats(std::vector<float> &travelTimes, const std::vector<float> inputPercentiles) {
 
@@ -26,14 +250,60 @@ ResultStats::ResultStats(std::vector<float> &travelTimes, const std::vector<floa
 
     std::sort(travelTimes.begin(), travelTimes.end());
     for (const auto &p : inputPercentiles) {
-        this->percentiles[p] = travelTimes[static_cast<int>(travelTimes.size() * p)];
+        // Percentile 1 is the largest sample
+        std::size_t index = std::min(static_cast<std::size_t>(travelTimes.size() * p), travelTimes.size() - 1);
+        this->percentiles[p] = travelTimes[index];
+    }
+}
+
+ResultStats::ResultStats(const QuantileSketch &sketch, const std::vector<float> inputPercentiles) {
+    this->mean = sketch.GetMean();
+    this->sampleDev = sketch.GetSampleDev();
+    this->variationCoeff = this->sampleDev / this->mean;
+    this->percentileError = sketch.GetRelativeError();
+    for (const auto &p : inputPercentiles) {
+        this->percentiles[p] = sketch.Quantile(p);
+    }
+}
+
+ResultStats::ResultStats(const TravelTimeHistogram &histogram, const std::vector<float> inputPercentiles) {
+    this->mean = histogram.GetMean();
+    this->sampleDev = histogram.GetDeviation();
+    this->variationCoeff = this->sampleDev / this->mean;
+    for (const auto &p : inputPercentiles) {
+        this->percentiles[p] = histogram.Quantile(p);
+    }
+    if (!this->percentiles.empty() && this->percentiles.begin()->second > 0.0)
+        this->percentileError = 0.5 * histogram.GetBinSeconds() / this->percentiles.begin()->second;
+}
+
+double ResultStats::PercentileError(const std::vector<float> &sortedTravelTimes,
+                                    const std::vector<float> &inputPercentiles) {
+    std::size_t n = sortedTravelTimes.size();
+    if (n < 2)
+        return std::numeric_limits<double>::infinity();
+
+    double error = 0.0;
+    for (const auto &p : inputPercentiles) {
+        double rank = n * static_cast<double>(p);
+        // At least one rank on both sides, extreme percentiles of few samples would look exact otherwise
+        double deviation = std::max(std::sqrt(rank * (1.0 - p)), 1.0);
+        std::size_t lower = static_cast<std::size_t>(std::max(std::floor(rank - deviation), 0.0));
+        std::size_t upper = std::min(static_cast<std::size_t>(std::ceil(rank + deviation)), n - 1);
+        double value = sortedTravelTimes[std::min(static_cast<std::size_t>(rank), n - 1)];
+        if (value > 0.0)
+            error = std::max(error, (sortedTravelTimes[upper] - sortedTravelTimes[lower]) / (2.0 * value));
     }
+    return error;
 }
 
 std::ostream &operator<<(std::ostream &os, const ResultStats &st) {
     os << "sample dev: " << st.sampleDev << "  mean: " << st.mean << "  variation coeff.: " << st.variationCoeff
        << std::endl;
-    os << "Percentiles: " << std::endl;
+    os << "Percentiles: ";
+    if (st.percentileError > 0.0)
+        os << "(relative error " << st.percentileError * 100.0 << "%)";
+    os << std::endl;
     for (const auto &p : st.percentiles) {
         os << p.first * 100.0f << "% " << p.second << std::endl;
     }
@@ -1,10 +1,236 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <ostream>
 #include <vector>
 #include <numeric>
 
+#define QUANTILE_SKETCH_DEFAULT_ERROR 0.005 // Default relative error of the percentiles estimated by QuantileSketch
+#define HISTOGRAM_BIN_SECONDS 1.0 // Default width of the bins of TravelTimeHistogram in seconds
+#define HISTOGRAM_TAIL_PROBABILITY 1e-9 // Probability of each tail dropped by TravelTimeHistogram::Trim
+
+/**
+ * Mergeable streaming summary of travel times with memory independent of the sample count. Positive values are
+ * counted in logarithmic buckets (Masson et al., "DDSketch: A fast and fully-mergeable quantile sketch with
+ * relative-error guarantees", VLDB 2019), every percentile is within the relative error of the exact value.
+ * Bucket counts do not depend on the order of insertion and merging.
+ */
+class QuantileSketch {
+public:
+    /**
+     * Constructor, creates an empty sketch
+     * @param relativeError maximum relative error of the estimated percentiles, in range (0, 1)
+     */
+    explicit QuantileSketch(double relativeError = QUANTILE_SKETCH_DEFAULT_ERROR);
+
+    /**
+     * Add single travel time, values that are not finite are ignored
+     * @param value travel time
+     */
+    void Add(float value);
+
+    /**
+     * Add all values of other sketch
+     * @param other sketch with the same relative error
+     */
+    void Merge(const QuantileSketch &other);
+
+    /**
+     * Estimate percentile, same rank as ResultStats computes from the sorted samples
+     * @param p percentile in range [0, 1]
+     * @return estimated value, 0 for an empty sketch
+     */
+    double Quantile(double p) const;
+
+    /**
+     * @return number of added values
+     */
+    uint64_t GetCount() const;
+
+    /**
+     * @return mean of the added values
+     */
+    double GetMean() const;
+
+    /**
+     * @return sample deviation of the added values
+     */
+    double GetSampleDev() const;
+
+    /**
+     * @return maximum relative error of the estimated percentiles
+     */
+    double GetRelativeError() const;
+
+    /**
+     * @return number of allocated buckets, memory of the sketch is proportional to it
+     */
+    std::size_t GetBucketCount() const;
+
+private:
+    /**
+     * @param value positive value
+     * @return index of the bucket containing the value
+     */
+    int BucketIndex(double value) const;
+
+    /**
+     * Make sure the buckets cover the index
+     * @param index bucket index
+     */
+    void Reserve(int index);
+
+    /**
+     * Maximum relative error of the estimated percentiles
+     */
+    double m_relativeError;
+
+    /**
+     * Ratio of the upper and lower bound of a bucket
+     */
+    double m_gamma;
+
+    /**
+     * Natural logarithm of m_gamma
+     */
+    double m_logGamma;
+
+    /**
+     * Index of the first bucket in m_buckets
+     */
+    int m_offset = 0;
+
+    /**
+     * Counts of the buckets, bucket i holds values in (gamma^(i-1), gamma^i]
+     */
+    std::vector<uint64_t> m_buckets;
+
+    /**
+     * Number of values lower than or equal to zero
+     */
+    uint64_t m_zeroCount = 0;
+
+    /**
+     * Number of added values
+     */
+    uint64_t m_count = 0;
+
+    /**
+     * Running mean of the added values
+     */
+    double m_mean = 0.0;
+
+    /**
+     * Running sum of squared differences from the mean
+     */
+    double m_sumSquares = 0.0;
+
+    /**
+     * Lowest and highest added value, bound the estimates
+     */
+    double m_min = 0.0;
+    double m_max = 0.0;
+};
+
+/**
+ * Discrete distribution of travel times with probabilities in bins of fixed width. Every bin keeps its probability
+ * and the probability weighted mean of the added values, so the mean of the distribution is exact and the values
+ * of the bins are not rounded to the bin boundaries.
+ */
+class TravelTimeHistogram {
+public:
+    /**
+     * Constructor, creates an empty histogram
+     * @param binSeconds width of the bins in seconds
+     */
+    explicit TravelTimeHistogram(double binSeconds = HISTOGRAM_BIN_SECONDS);
+
+    /**
+     * Add probability of a single travel time
+     * @param value travel time in seconds, not negative
+     * @param probability probability of the travel time
+     */
+    void Add(double value, double probability);
+
+    /**
+     * Remove all the values, the bin width is kept
+     */
+    void Clear();
+
+    /**
+     * Drop the lowest and the highest bins up to the given probability of each tail. Tails of many convolved
+     * distributions have negligible probability, but span most of the bins.
+     * @param tailProbability maximum probability removed from either end
+     */
+    void Trim(double tailProbability = HISTOGRAM_TAIL_PROBABILITY);
+
+    /**
+     * Percentile of the distribution, same rank as ResultStats computes from the sorted samples
+     * @param p percentile in range [0, 1]
+     * @return mean value of the first bin whose cumulative probability exceeds p, 0 for an empty histogram
+     */
+    double Quantile(double p) const;
+
+    /**
+     * @return total probability of the added values
+     */
+    double GetMass() const;
+
+    /**
+     * @return mean of the distribution
+     */
+    double GetMean() const;
+
+    /**
+     * @return standard deviation of the distribution
+     */
+    double GetDeviation() const;
+
+    /**
+     * @return number of bins between the lowest and the highest value including the empty ones
+     */
+    std::size_t GetBinCount() const;
+
+    /**
+     * @param bin bin index in range [0, GetBinCount())
+     * @return probability of the bin
+     */
+    double GetBinMass(std::size_t bin) const;
+
+    /**
+     * @param bin bin index in range [0, GetBinCount())
+     * @return mean value of the bin, undefined for an empty bin
+     */
+    double GetBinValue(std::size_t bin) const;
+
+    /**
+     * @return width of the bins in seconds
+     */
+    double GetBinSeconds() const;
+
+private:
+    /**
+     * Width of the bins in seconds
+     */
+    double m_binSeconds;
+
+    /**
+     * Index of the first bin in m_mass, bin i holds values in [i * m_binSeconds, (i + 1) * m_binSeconds)
+     */
+    int m_offset = 0;
+
+    /**
+     * Probabilities of the bins
+     */
+    std::vector<double> m_mass;
+
+    /**
+     * Probability weighted sums of the values of the bins
+     */
+    std::vector<double> m_moment;
+};
+
 class ResultStats {
 public:
     /**
@@ -15,6 +241,23 @@ public:
     ResultStats(std::vector<float> &travelTimes,
                 const std::vector<float> inputPercentiles = {0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95});
 
+    /**
+     * Constructor, reads the statistics from a streaming summary of the travel times
+     * @param sketch summary of the travel times
+     * @param inputPercentiles percentile values to obtain
+     */
+    ResultStats(const QuantileSketch &sketch,
+                const std::vector<float> inputPercentiles = {0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95});
+
+    /**
+     * Constructor, reads the statistics from a travel time distribution, the deviation is the one of the
+     * distribution
+     * @param histogram distribution of the travel times
+     * @param inputPercentiles percentile values to obtain
+     */
+    ResultStats(const TravelTimeHistogram &histogram,
+                const std::vector<float> inputPercentiles = {0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95});
+
     /**
      * Sample deviation
      */
@@ -35,6 +278,24 @@ public:
      */
     std::map<float, double> percentiles;
 
+    /**
+     * Maximum relative error of the percentiles, zero if computed from all samples, half of the bin width relative
+     * to the lowest percentile for a histogram
+     */
+    double percentileError = 0.0;
+
+    /**
+     * Estimate the standard error of the percentiles computed from the samples, relative to the percentile value.
+     * The rank of a sample percentile has binomial deviation sqrt(n p (1 - p)), the samples at one deviation
+     * around the percentile rank bound the interval of a single standard error (distribution free, no repetitions
+     * of the simulation are needed).
+     * @param sortedTravelTimes travel times sorted in ascending order
+     * @param inputPercentiles percentile values to check
+     * @return maximum relative standard error over the percentiles, infinity for less than two samples
+     */
+    static double PercentileError(const std::vector<float> &sortedTravelTimes,
+                                  const std::vector<float> &inputPercentiles);
+
     /**
      * Overloaded stream write operator for simple readable output
      */
@@ -0,0 +1,32 @@
+#include "Route.h"
+#include "Data.h"
+#include "ProfileDatabase.h"
+#include <iostream>
+
+Routing::Route::Route(const ProfileDatabase &database, const std::string &segmentsFile) {
+    std::vector<std::string> tmcIds;
+    for (const auto &segment : Data::LoadEdges(segmentsFile)) {
+        tmcIds.push_back(segment.tmcId);
+    }
+    Resolve(database, tmcIds);
+}
+
+Routing::Route::Route(const ProfileDatabase &database, const std::vector<std::string> &tmcIds) {
+    Resolve(database, tmcIds);
+}
+
+const std::vector<int> &Routing::Route::GetSegments() const {
+    return m_segments;
+}
+
+void Routing::Route::Resolve(const ProfileDatabase &database, const std::vector<std::string> &tmcIds) {
+    m_segments.reserve(tmcIds.size());
+    for (const auto &tmcId : tmcIds) {
+        int segment = database.Find(tmcId);
+        if (segment < 0) {
+            std::cerr << "ERROR: Profile for segment " << tmcId << " not found in profile database" << std::endl;
+            continue;
+        }
+        m_segments.push_back(segment);
+    }
+}
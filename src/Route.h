@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Routing {
+    class ProfileDatabase;
+
+    /**
+     * Route through the road network, references segments of a shared ProfileDatabase
+     */
+    class Route {
+    public:
+        /**
+         * Constructor, resolves segments of the edges file in the database
+         * @param database profiles of the road network
+         * @param segmentsFile CSV file with segment IDs of the route
+         */
+        Route(const ProfileDatabase &database, const std::string &segmentsFile);
+
+        /**
+         * Constructor, resolves the segment IDs in the database
+         * @param database profiles of the road network
+         * @param tmcIds ordered segment IDs of the route
+         */
+        Route(const ProfileDatabase &database, const std::vector<std::string> &tmcIds);
+
+        /**
+         * @return positions of the route segments in the database
+         */
+        const std::vector<int> &GetSegments() const;
+
+    private:
+        /**
+         * Resolve the segment IDs in the database, unknown segments are skipped
+         */
+        void Resolve(const ProfileDatabase &database, const std::vector<std::string> &tmcIds);
+
+        /**
+         * Positions of the route segments in the database
+         */
+        std::vector<int> m_segments;
+    };
+}
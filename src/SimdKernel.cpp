@@ -0,0 +1,321 @@
+#include "SimdKernel.h"
+#include "RandomGenerator.h"
+#include <cstdlib>
+#include <iostream>
+
+#if defined __x86_64__ || defined __i386__
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#ifdef X86_KERNELS
+namespace {
+
+    /**
+     * Random words of the lanes crossing an interval boundary, other lanes get zero
+     */
+    inline void DrawCrossings(Routing::RandomGenerator &rnd, const uint32_t *samples, uint32_t departure, int segment,
+                              int crossing, int mask, int lanes, uint32_t *draws) {
+        for (int l = 0; l < lanes; ++l) {
+            draws[l] = (mask >> l) & 1 ? rnd.Draw(samples[l], departure, segment, crossing) : 0;
+        }
+    }
+
+    /**
+     * Speeds of the active lanes selected by the random words, Kernel::SampleSpeed of 8 lanes. Inactive lanes get 1.
+     */
+    __attribute__((target("avx2")))
+    inline __m256 SampleSpeedsAVX2(const float *profile, __m256i base, __m256i draw, __m256 active, int aliasShift) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        if (aliasShift == 0) {
+            // Multiply-shift of the even and odd words, the indexes are the high halves of the 64-bit products
+            const __m256i resolution = _mm256_set1_epi32(INDEX_RESOLUTION);
+            __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(draw, resolution), 32);
+            __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(draw, 32), resolution);
+            __m256i idx = _mm256_add_epi32(base, _mm256_blend_epi32(even, odd, 0xAA));
+            return _mm256_mask_i32gather_ps(one, profile, idx, active, 4);
+        }
+
+        __m256i column = _mm256_srl_epi32(draw, _mm_cvtsi32_si128(32 - aliasShift));
+        __m256i idx = _mm256_add_epi32(base, _mm256_mullo_epi32(column, _mm256_set1_epi32(ALIAS_ENTRY_SIZE)));
+        __m256 threshold = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), profile, idx, active, 4);
+        __m256 speed = _mm256_mask_i32gather_ps(one, profile + 1, idx, active, 4);
+        __m256 alias = _mm256_mask_i32gather_ps(one, profile + 2, idx, active, 4);
+        __m256i bits = _mm256_srli_epi32(_mm256_sll_epi32(draw, _mm_cvtsi32_si128(aliasShift)), 8);
+        __m256 fraction = _mm256_cvtepi32_ps(bits);
+        return _mm256_blendv_ps(alias, speed, _mm256_cmp_ps(fraction, threshold, _CMP_LT_OQ));
+    }
+
+    /**
+     * Speeds of the active lanes selected by the random words, Kernel::SampleSpeed of 16 lanes. Inactive lanes get 1.
+     */
+    __attribute__((target("avx512f")))
+    inline __m512 SampleSpeedsAVX512(const float *profile, __m512i base, __m512i draw, __mmask16 active,
+                                     int aliasShift) {
+        const __m512 one = _mm512_set1_ps(1.0f);
+        if (aliasShift == 0) {
+            // Multiply-shift of the even and odd words, the indexes are the high halves of the 64-bit products
+            const __m512i resolution = _mm512_set1_epi32(INDEX_RESOLUTION);
+            __m512i even = _mm512_srli_epi64(_mm512_mul_epu32(draw, resolution), 32);
+            __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(draw, 32), resolution);
+            __m512i idx = _mm512_add_epi32(base, _mm512_mask_blend_epi32(0xAAAA, even, odd));
+            return _mm512_mask_i32gather_ps(one, active, idx, profile, 4);
+        }
+
+        __m512i column = _mm512_srl_epi32(draw, _mm_cvtsi32_si128(32 - aliasShift));
+        __m512i idx = _mm512_add_epi32(base, _mm512_mullo_epi32(column, _mm512_set1_epi32(ALIAS_ENTRY_SIZE)));
+        __m512 threshold = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), active, idx, profile, 4);
+        __m512 speed = _mm512_mask_i32gather_ps(one, active, idx, profile + 1, 4);
+        __m512 alias = _mm512_mask_i32gather_ps(one, active, idx, profile + 2, 4);
+        __m512i bits = _mm512_srli_epi32(_mm512_sll_epi32(draw, _mm_cvtsi32_si128(aliasShift)), 8);
+        __m512 fraction = _mm512_cvtepi32_ps(bits);
+        return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(fraction, threshold, _CMP_LT_OQ), alias, speed);
+    }
+
+    /**
+     * 8 lanes of the scalar simulation. Lanes leaving the interval take the masked slow path, the loop over
+     * a segment ends when no lane has remaining length.
+     */
+    __attribute__((target("avx2")))
+    void TravelTimesAVX2(const Routing::Kernel::RouteView &route, const int *startSeconds, const uint32_t *draws,
+                         Routing::RandomGenerator &rnd, const uint32_t *samples, uint32_t departure,
+                         float *travelTimes) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 secondInterval = _mm256_set1_ps(route.secondInterval);
+        const __m256 week = _mm256_set1_ps(604800.0f);
+        const __m256i weekSeconds = _mm256_set1_epi32(604800);
+        const __m256i stride = _mm256_set1_epi32(static_cast<int>(route.intervalStride));
+        const __m256i nextInterval = _mm256_set1_epi32(1);
+
+        // Every lane reads its own block of random words
+        __m256i pIdx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                          _mm256_set1_epi32(route.segmentCount));
+        alignas(32) uint32_t crossingDraws[8];
+        __m256 total = zero;
+        __m256 current = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(startSeconds)));
+
+        for (int s = 0; s < route.segmentCount; ++s) {
+            const float *profile = route.speedProfiles[s];
+            __m256 remaining = _mm256_set1_ps(static_cast<float>(route.lengths[s]));
+            __m256 active = _mm256_cmp_ps(remaining, zero, _CMP_GT_OQ);
+
+            for (int crossing = 0; !_mm256_testz_ps(active, active); ++crossing) {
+                __m256i activeMask = _mm256_castps_si256(active);
+                __m256i interval = _mm256_cvttps_epi32(_mm256_div_ps(current, secondInterval));
+                __m256i draw;
+                if (crossing == 0) {
+                    draw = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(draws),
+                                                       pIdx, activeMask, 4);
+                } else {
+                    DrawCrossings(rnd, samples, departure, s, crossing, _mm256_movemask_ps(active), 8, crossingDraws);
+                    draw = _mm256_load_si256(reinterpret_cast<const __m256i *>(crossingDraws));
+                }
+                __m256i base = _mm256_mullo_epi32(interval, stride);
+                bool whole = crossing == 0 && route.segmentTimes != nullptr;
+                __m256 velocity, currentTravelTime;
+                if (whole) {
+                    // Time of the whole segment is precomputed, the speed is needed only when leaving the interval
+                    velocity = zero;
+                    currentTravelTime = SampleSpeedsAVX2(route.segmentTimes[s], base, draw, active, route.aliasShift);
+                } else {
+                    velocity = SampleSpeedsAVX2(profile, base, draw, active, route.aliasShift);
+                    currentTravelTime = _mm256_div_ps(remaining, velocity);
+                }
+                __m256 newSeconds = _mm256_add_ps(current, currentTravelTime);
+                __m256i newInterval = _mm256_cvttps_epi32(_mm256_div_ps(newSeconds, secondInterval));
+                __m256 crossed = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(newInterval, interval)),
+                                                  active);
+
+                // Lanes within single interval finish the segment
+                __m256 finished = _mm256_andnot_ps(crossed, active);
+                total = _mm256_blendv_ps(total, _mm256_add_ps(total, currentTravelTime), finished);
+                current = _mm256_blendv_ps(current, newSeconds, finished);
+
+                if (__builtin_expect(!_mm256_testz_ps(crossed, crossed), 0)) {
+                    if (whole)
+                        velocity = SampleSpeedsAVX2(profile, base, draw, crossed, route.aliasShift);
+
+                    // Distance travelled in time remaining to the next interval
+                    __m256 nextStart = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(interval, nextInterval)),
+                                                     secondInterval);
+                    __m256 secsToNext = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_sub_ps(nextStart, current)));
+                    remaining = _mm256_blendv_ps(remaining,
+                                                 _mm256_sub_ps(remaining, _mm256_mul_ps(velocity, secsToNext)),
+                                                 crossed);
+                    total = _mm256_blendv_ps(total, _mm256_add_ps(total, secsToNext), crossed);
+
+                    // Resolve wrapping of the week
+                    __m256i weekOverlap = _mm256_cvttps_epi32(_mm256_div_ps(newSeconds, week));
+                    __m256 wrapped = _mm256_sub_ps(newSeconds,
+                                                   _mm256_cvtepi32_ps(_mm256_mullo_epi32(weekOverlap, weekSeconds)));
+                    __m256 newCurrent = _mm256_blendv_ps(newSeconds, wrapped,
+                                                         _mm256_cmp_ps(newSeconds, week, _CMP_GE_OQ));
+                    current = _mm256_blendv_ps(current, newCurrent, crossed);
+                }
+                active = _mm256_and_ps(crossed, _mm256_cmp_ps(remaining, zero, _CMP_GT_OQ));
+            }
+            pIdx = _mm256_add_epi32(pIdx, _mm256_set1_epi32(1));
+        }
+        _mm256_storeu_ps(travelTimes, total);
+    }
+
+    /**
+     * 16 lanes of the scalar simulation using AVX-512 mask registers
+     */
+    __attribute__((target("avx512f")))
+    void TravelTimesAVX512(const Routing::Kernel::RouteView &route, const int *startSeconds, const uint32_t *draws,
+                           Routing::RandomGenerator &rnd, const uint32_t *samples, uint32_t departure,
+                           float *travelTimes) {
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 secondInterval = _mm512_set1_ps(route.secondInterval);
+        const __m512 week = _mm512_set1_ps(604800.0f);
+        const __m512i weekSeconds = _mm512_set1_epi32(604800);
+        const __m512i stride = _mm512_set1_epi32(static_cast<int>(route.intervalStride));
+        const __m512i nextInterval = _mm512_set1_epi32(1);
+
+        // Every lane reads its own block of random words
+        __m512i pIdx = _mm512_mullo_epi32(
+                _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                _mm512_set1_epi32(route.segmentCount));
+        alignas(64) uint32_t crossingDraws[16];
+        __m512 total = zero;
+        __m512 current = _mm512_cvtepi32_ps(_mm512_loadu_si512(startSeconds));
+
+        for (int s = 0; s < route.segmentCount; ++s) {
+            const float *profile = route.speedProfiles[s];
+            __m512 remaining = _mm512_set1_ps(static_cast<float>(route.lengths[s]));
+            __mmask16 active = _mm512_cmp_ps_mask(remaining, zero, _CMP_GT_OQ);
+
+            for (int crossing = 0; active; ++crossing) {
+                __m512i interval = _mm512_cvttps_epi32(_mm512_div_ps(current, secondInterval));
+                __m512i draw;
+                if (crossing == 0) {
+                    draw = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), active, pIdx, draws, 4);
+                } else {
+                    DrawCrossings(rnd, samples, departure, s, crossing, active, 16, crossingDraws);
+                    draw = _mm512_load_si512(crossingDraws);
+                }
+                __m512i base = _mm512_mullo_epi32(interval, stride);
+                bool whole = crossing == 0 && route.segmentTimes != nullptr;
+                __m512 velocity, currentTravelTime;
+                if (whole) {
+                    // Time of the whole segment is precomputed, the speed is needed only when leaving the interval
+                    velocity = zero;
+                    currentTravelTime = SampleSpeedsAVX512(route.segmentTimes[s], base, draw, active,
+                                                           route.aliasShift);
+                } else {
+                    velocity = SampleSpeedsAVX512(profile, base, draw, active, route.aliasShift);
+                    currentTravelTime = _mm512_div_ps(remaining, velocity);
+                }
+                __m512 newSeconds = _mm512_add_ps(current, currentTravelTime);
+                __m512i newInterval = _mm512_cvttps_epi32(_mm512_div_ps(newSeconds, secondInterval));
+                __mmask16 crossed = _mm512_mask_cmpneq_epi32_mask(active, newInterval, interval);
+
+                // Lanes within single interval finish the segment
+                __mmask16 finished = active & ~crossed;
+                total = _mm512_mask_add_ps(total, finished, total, currentTravelTime);
+                current = _mm512_mask_mov_ps(current, finished, newSeconds);
+
+                if (__builtin_expect(crossed != 0, 0)) {
+                    if (whole)
+                        velocity = SampleSpeedsAVX512(profile, base, draw, crossed, route.aliasShift);
+
+                    // Distance travelled in time remaining to the next interval
+                    __m512 nextStart = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(interval, nextInterval)),
+                                                     secondInterval);
+                    __m512 secsToNext = _mm512_cvtepi32_ps(_mm512_cvttps_epi32(_mm512_sub_ps(nextStart, current)));
+                    remaining = _mm512_mask_sub_ps(remaining, crossed, remaining,
+                                                   _mm512_mul_ps(velocity, secsToNext));
+                    total = _mm512_mask_add_ps(total, crossed, total, secsToNext);
+
+                    // Resolve wrapping of the week
+                    __m512i weekOverlap = _mm512_cvttps_epi32(_mm512_div_ps(newSeconds, week));
+                    __m512 wrapped = _mm512_sub_ps(newSeconds,
+                                                   _mm512_cvtepi32_ps(_mm512_mullo_epi32(weekOverlap, weekSeconds)));
+                    __mmask16 wraps = _mm512_cmp_ps_mask(newSeconds, week, _CMP_GE_OQ);
+                    current = _mm512_mask_mov_ps(current, crossed, _mm512_mask_mov_ps(newSeconds, wraps, wrapped));
+                }
+                active = _mm512_mask_cmp_ps_mask(crossed, remaining, zero, _CMP_GT_OQ);
+            }
+            pIdx = _mm512_add_epi32(pIdx, _mm512_set1_epi32(1));
+        }
+        _mm512_storeu_ps(travelTimes, total);
+    }
+}
+#endif
+
+Routing::SimulationKernel Routing::Kernel::Best() {
+    if (IsSupported(SimulationKernel::AVX512))
+        return SimulationKernel::AVX512;
+    if (IsSupported(SimulationKernel::AVX2))
+        return SimulationKernel::AVX2;
+    return SimulationKernel::Scalar;
+}
+
+bool Routing::Kernel::IsSupported(SimulationKernel kernel) {
+    switch (kernel) {
+        case SimulationKernel::Scalar:
+            return true;
+#ifdef X86_KERNELS
+        case SimulationKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case SimulationKernel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+int Routing::Kernel::Lanes(SimulationKernel kernel) {
+    switch (kernel) {
+        case SimulationKernel::AVX2:
+            return 8;
+        case SimulationKernel::AVX512:
+            return 16;
+        default:
+            return 1;
+    }
+}
+
+std::string Routing::Kernel::Name(SimulationKernel kernel) {
+    switch (kernel) {
+        case SimulationKernel::Scalar:
+            return "scalar";
+        case SimulationKernel::AVX2:
+            return "avx2";
+        case SimulationKernel::AVX512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+bool Routing::Kernel::FitsGatherIndex(int intervals, std::size_t intervalStride) {
+    return static_cast<uint64_t>(intervals) * intervalStride <= static_cast<uint64_t>(INT32_MAX);
+}
+
+bool Routing::Kernel::FromName(const std::string &name, SimulationKernel &kernel) {
+    if (name == "scalar") kernel = SimulationKernel::Scalar;
+    else if (name == "avx2") kernel = SimulationKernel::AVX2;
+    else if (name == "avx512") kernel = SimulationKernel::AVX512;
+    else return false;
+    return true;
+}
+
+void Routing::Kernel::TravelTimes(SimulationKernel kernel, const RouteView &route, const int *startSeconds,
+                                  const uint32_t *draws, RandomGenerator &rnd, const uint32_t *samples, uint32_t departure,
+                                  float *travelTimes) {
+    switch (kernel) {
+#ifdef X86_KERNELS
+        case SimulationKernel::AVX2:
+            TravelTimesAVX2(route, startSeconds, draws, rnd, samples, departure, travelTimes);
+            return;
+        case SimulationKernel::AVX512:
+            TravelTimesAVX512(route, startSeconds, draws, rnd, samples, departure, travelTimes);
+            return;
+#endif
+        default:
+            std::cerr << "ERROR: Kernel " << Name(kernel) << " is not available" << std::endl;
+            std::exit(EXIT_FAILURE);
+    }
+}
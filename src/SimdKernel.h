@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Data.h"
+
+#define SIMD_KERNEL_MAX_LANES 16 // Number of samples simulated together by the widest kernel
+
+namespace Routing {
+    class RandomGenerator;
+
+    /**
+     * Implementations of the travel time simulation
+     */
+    enum class SimulationKernel {
+        Scalar, // One sample at a time
+        AVX2, // 8 samples in lockstep, requires AVX2
+        AVX512 // 16 samples in lockstep, requires AVX-512F
+    };
+
+    namespace Kernel {
+
+        /**
+         * Route data read by the kernels
+         */
+        struct RouteView {
+            int segmentCount;
+            const int *lengths;
+            const float *const *speedProfiles;
+            std::size_t intervalStride; // Vector kernels require intervals of the week times stride below INT32_MAX
+            float secondInterval;
+            int aliasShift; // log2 of the alias table columns, 0 for the expanded profiles
+            const float *const *segmentTimes; // Times of the whole segments in the layout of the profiles, or null
+        };
+
+        /**
+         * Offset of the value selected by the random word within a single interval of the speed profile
+         * @param draw random word
+         * @param aliasShift log2 of the alias table columns, 0 for the expanded profiles
+         * @return offset of the speed for the expanded profiles, offset of the column for the alias tables
+         */
+        inline int ProfileOffset(uint32_t draw, int aliasShift) {
+            // Multiply-shift maps the word to the index range without division, top bits select the alias column
+            if (aliasShift == 0)
+                return static_cast<int>((static_cast<uint64_t>(draw) * INDEX_RESOLUTION) >> 32);
+            return static_cast<int>(draw >> (32 - aliasShift)) * ALIAS_ENTRY_SIZE;
+        }
+
+        /**
+         * Sample speed from a single interval of the speed profile
+         * @param interval first value of the interval
+         * @param draw random word
+         * @param aliasShift log2 of the alias table columns, 0 for the expanded profiles
+         * @return random speed
+         */
+        inline float SampleSpeed(const float *interval, uint32_t draw, int aliasShift) {
+            const float *entry = interval + ProfileOffset(draw, aliasShift);
+            if (aliasShift == 0)
+                return *entry;
+            // Bits below the column choose between the column speed and its alias
+            float fraction = static_cast<float>((draw << aliasShift) >> 8);
+            return fraction < entry[0] ? entry[1] : entry[2];
+        }
+
+        /**
+         * @return fastest kernel supported by the CPU executing the program
+         */
+        SimulationKernel Best();
+
+        /**
+         * @param kernel simulation kernel
+         * @return true if the CPU executing the program supports the kernel
+         */
+        bool IsSupported(SimulationKernel kernel);
+
+        /**
+         * @param kernel simulation kernel
+         * @return number of samples simulated by a single call of the kernel
+         */
+        int Lanes(SimulationKernel kernel);
+
+        /**
+         * @param kernel simulation kernel
+         * @return human readable name of the kernel
+         */
+        std::string Name(SimulationKernel kernel);
+
+        /**
+         * Parse kernel from the command line name
+         * @param name one of scalar, avx2, avx512
+         * @param kernel is set to the parsed kernel
+         * @return false if the name is unknown
+         */
+        bool FromName(const std::string &name, SimulationKernel &kernel);
+
+        /**
+         * Vector kernels gather the profiles by 32-bit indexes relative to the first interval of a segment
+         * @param intervals number of intervals of the week
+         * @param intervalStride distance between two consecutive intervals of a segment profile
+         * @return true if every index of the profiles fits in 32 bits
+         */
+        bool FitsGatherIndex(int intervals, std::size_t intervalStride);
+
+        /**
+         * Simulate Lanes(kernel) samples along the route in lockstep, equivalent to the scalar
+         * MCSimulation::GetRandomTravelTime called for every lane
+         * @param kernel vector kernel, must be supported by the CPU
+         * @param route route data
+         * @param startSeconds departure time of every lane in seconds from the beginning of the week
+         * @param draws first random word of every segment, segmentCount consecutive values for every lane
+         * @param rnd random number generator for the interval crossings
+         * @param samples sample number of every lane
+         * @param departure departure interval used as random stream index
+         * @param travelTimes travel time of every lane in seconds
+         */
+        void TravelTimes(SimulationKernel kernel, const RouteView &route, const int *startSeconds, const uint32_t *draws,
+                         RandomGenerator &rnd, const uint32_t *samples, uint32_t departure, float *travelTimes);
+    }
+}
@@ -0,0 +1,38 @@
+#include "SimulationCounters.h"
+
+void Routing::SimulationCounters::Merge(const SimulationCounters &other) {
+    samples += other.samples;
+    segments += other.segments;
+    crossings += other.crossings;
+    wordsConsumed += other.wordsConsumed;
+    wordsGenerated += other.wordsGenerated;
+    remoteSegments += other.remoteSegments;
+    loadSeconds += other.loadSeconds;
+    rngSeconds += other.rngSeconds;
+    simulateSeconds += other.simulateSeconds;
+    statsSeconds += other.statsSeconds;
+    writeSeconds += other.writeSeconds;
+}
+
+void Routing::SimulationCounters::WriteJson(std::ostream &out) const {
+    // Ratios of empty runs are reported as 0
+    double crossingsPerSegment = segments > 0 ? static_cast<double>(crossings) / segments : 0.0;
+    double remotePerSegment = segments > 0 ? remoteSegments / segments : 0.0;
+    double wordsPerGenerated = wordsGenerated > 0 ? static_cast<double>(wordsConsumed) / wordsGenerated : 0.0;
+    double threadSeconds = rngSeconds + simulateSeconds;
+    double samplesPerSecond = threadSeconds > 0.0 ? samples / threadSeconds : 0.0;
+
+    out << "{\n";
+    out << "  \"samples\": " << samples << ",\n";
+    out << "  \"segments\": " << segments << ",\n";
+    out << "  \"crossings\": " << crossings << ",\n";
+    out << "  \"crossings_per_segment\": " << crossingsPerSegment << ",\n";
+    out << "  \"random_words\": {\"consumed\": " << wordsConsumed << ", \"generated\": " << wordsGenerated
+        << ", \"consumed_per_generated\": " << wordsPerGenerated << "},\n";
+    out << "  \"numa\": {\"remote_segments\": " << remoteSegments << ", \"remote_per_segment\": " << remotePerSegment
+        << "},\n";
+    out << "  \"samples_per_thread_second\": " << samplesPerSecond << ",\n";
+    out << "  \"seconds\": {\"load\": " << loadSeconds << ", \"rng\": " << rngSeconds << ", \"simulate\": "
+        << simulateSeconds << ", \"stats\": " << statsSeconds << ", \"write\": " << writeSeconds << "}\n";
+    out << "}\n";
+}
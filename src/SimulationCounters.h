@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace Routing {
+
+    /**
+     * Counters of the simulation hot paths, collected only when enabled by MCSimulation::SetCounters. Every thread
+     * counts into a private copy merged at the end of a run, so the counting does not contend. Times of the rng and
+     * simulate phases are summed over the threads, draws of the interval crossings count as simulation.
+     */
+    struct SimulationCounters {
+        uint64_t samples = 0; // Simulated travel times, every departure of a sample counts
+        uint64_t segments = 0; // Segments traversed by the samples
+        uint64_t crossings = 0; // Interval boundaries crossed within a segment, the slow path of the simulation
+        uint64_t wordsConsumed = 0; // Random words used to select a speed, reused draws count every use
+        uint64_t wordsGenerated = 0; // 32-bit random words produced by the generator backend
+        double remoteSegments = 0.0; // Estimated segments whose profile was read from another NUMA node
+
+        double loadSeconds = 0.0; // Loading of the route and the profiles
+        double rngSeconds = 0.0; // Generation of the first random word of every segment
+        double simulateSeconds = 0.0; // Passes along the route including the draws of the crossings
+        double statsSeconds = 0.0; // Statistics of the samples
+        double writeSeconds = 0.0; // Output of the results
+
+        /**
+         * Add counts and times of other counters
+         * @param other counters of a thread or of another run
+         */
+        void Merge(const SimulationCounters &other);
+
+        /**
+         * Write the counters and the derived ratios as a JSON object
+         * @param out output stream
+         */
+        void WriteJson(std::ostream &out) const;
+    };
+
+    /**
+     * Adds the lifetime of the object to a phase time, does not read the clock for a null phase
+     */
+    class PhaseTimer {
+    public:
+        /**
+         * Constructor, starts the measurement
+         * @param seconds phase time to add to, nullptr disables the measurement
+         */
+        explicit PhaseTimer(double *seconds) : m_seconds(seconds) {
+            if (m_seconds != nullptr)
+                m_start = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * Destructor adds the elapsed time
+         */
+        ~PhaseTimer() {
+            if (m_seconds != nullptr)
+                *m_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        }
+
+        PhaseTimer(const PhaseTimer &) = delete;
+
+        PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+    private:
+        /**
+         * Phase time to add to
+         */
+        double *m_seconds;
+
+        /**
+         * Start of the measurement
+         */
+        std::chrono::steady_clock::time_point m_start;
+    };
+}
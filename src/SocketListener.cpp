@@ -0,0 +1,104 @@
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "SocketListener.h"
+#include "TravelTimeServer.h"
+
+/**
+ * Client connected to the socket, closed when the reader and all the pending replies release it
+ */
+struct Routing::SocketListener::Connection {
+    int fd;
+    std::mutex mutex;
+
+    explicit Connection(int socket) : fd(socket) {}
+
+    ~Connection() {
+        close(fd);
+    }
+
+    /**
+     * Send a reply line, replies of the dispatcher and of the reader are serialized
+     * @param line reply without the line end
+     */
+    void Send(const std::string &line) {
+        std::string data = line + '\n';
+        std::lock_guard<std::mutex> lock(mutex);
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return; // Client is gone, the reply is dropped
+            sent += n;
+        }
+    }
+};
+
+Routing::SocketListener::SocketListener(TravelTimeServer &server, int listenFd)
+        : m_server(server), m_listenFd(listenFd) {}
+
+void Routing::SocketListener::Run(const std::atomic<bool> &stop) {
+    while (!stop) {
+        pollfd listening = {m_listenFd, POLLIN, 0};
+        if (poll(&listening, 1, SERVER_POLL_MS) <= 0)
+            continue;
+        int fd = accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        auto connection = std::make_shared<Connection>(fd);
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            id = m_accepted++;
+            m_connections.emplace(id, connection);
+        }
+        std::thread(&SocketListener::Read, this, id, std::move(connection)).detach();
+    }
+
+    // Readers of the open connections are woken up and leave once they see the end of the stream
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (const auto &entry : m_connections) {
+        if (auto connection = entry.second.lock())
+            shutdown(connection->fd, SHUT_RD);
+    }
+    m_closed.wait(lock, [this]() { return m_connections.empty(); });
+    lock.unlock();
+    m_server.Close();
+}
+
+std::size_t Routing::SocketListener::GetOpenConnections() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_connections.size();
+}
+
+uint64_t Routing::SocketListener::GetAcceptedConnections() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_accepted;
+}
+
+void Routing::SocketListener::Read(uint64_t id, std::shared_ptr<Connection> connection) {
+    std::string pending;
+    char buffer[SERVER_READ_SIZE];
+    ssize_t n;
+    while ((n = recv(connection->fd, buffer, sizeof(buffer), 0)) > 0) {
+        pending.append(buffer, n);
+        std::size_t start = 0, end;
+        while ((end = pending.find('\n', start)) != std::string::npos) {
+            std::string line = pending.substr(start, end - start);
+            start = end + 1;
+            if (line.empty() || line == "\r")
+                continue;
+            m_server.Submit(line, [connection](const std::string &reply) {
+                connection->Send(reply);
+            });
+        }
+        pending.erase(0, start);
+    }
+
+    // Pending replies keep the connection open, otherwise it is closed here
+    connection.reset();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_connections.erase(id);
+    m_closed.notify_all();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define SERVER_POLL_MS 200 // Period of checking the stop flag while waiting for connections
+#define SERVER_READ_SIZE 4096 // Bytes read from a connection at once
+
+namespace Routing {
+    class TravelTimeServer;
+
+    /**
+     * Clients of the travel time server on a listening socket. Every connection is read by its own detached thread,
+     * which submits the request lines and drops its reference to the connection when the client closes it, so the
+     * socket is closed once the pending replies are sent. Only weak references are kept to wake up the readers of
+     * the open connections on stop.
+     */
+    class SocketListener {
+    public:
+        /**
+         * Constructor
+         * @param server server answering the requests, must outlive the listener
+         * @param listenFd listening socket, owned by the caller
+         */
+        SocketListener(TravelTimeServer &server, int listenFd);
+
+        SocketListener(const SocketListener &) = delete;
+
+        SocketListener &operator=(const SocketListener &) = delete;
+
+        /**
+         * Accept connections until the stop flag is set, then stop reading the clients, wait for the readers and
+         * close the server. Replies of the queued requests are still sent.
+         * @param stop stop flag, may be set by a signal handler
+         */
+        void Run(const std::atomic<bool> &stop);
+
+        /**
+         * @return number of connections whose reader is running
+         */
+        std::size_t GetOpenConnections() const;
+
+        /**
+         * @return number of connections accepted so far
+         */
+        uint64_t GetAcceptedConnections() const;
+
+    private:
+        struct Connection;
+
+        /**
+         * Read request lines of a connection until the client closes it or the listener stops
+         * @param id key of the connection among the open ones
+         * @param connection connection, released before the reader leaves the open connections
+         */
+        void Read(uint64_t id, std::shared_ptr<Connection> connection);
+
+        TravelTimeServer &m_server;
+        int m_listenFd;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_closed; // Signaled when a reader finishes
+        std::unordered_map<uint64_t, std::weak_ptr<Connection>> m_connections; // Connections of the running readers
+        uint64_t m_accepted = 0;
+    };
+}
@@ -0,0 +1,297 @@
+#include "TravelTimeServer.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "CSVReader.h"
+#include "Data.h"
+#include "MCSimulation.h"
+#include "ProfileCache.h"
+#include "ResultCache.h"
+#include "ResultStats.h"
+#include <sys/stat.h>
+
+Routing::TravelTimeServer::TravelTimeServer(ProfileCache &cache, ResultCache *results)
+        : m_cache(cache), m_results(results) {}
+
+void Routing::TravelTimeServer::SetRngBackend(RngBackend backend) {
+    m_rngBackend = backend;
+}
+
+void Routing::TravelTimeServer::SetSeed(uint64_t seed) {
+    m_seed = seed;
+    m_hasSeed = true;
+}
+
+void Routing::TravelTimeServer::Submit(const std::string &line,
+                                       const std::function<void(const std::string &)> &reply) {
+    Request request;
+    std::string error;
+    request.reload = line == "reload";
+    if (request.reload) {
+        request.id = line;
+    } else if (!Parse(line, request, error)) {
+        reply(request.id + ";ERROR;" + error);
+        return;
+    }
+    request.received = std::chrono::steady_clock::now();
+    request.reply = reply;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed) {
+            reply(request.id + ";ERROR;server is closing");
+            return;
+        }
+        m_queue.push_back(request);
+    }
+    m_queued.notify_one();
+}
+
+void Routing::TravelTimeServer::Close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_queued.notify_one();
+}
+
+void Routing::TravelTimeServer::Serve() {
+    while (true) {
+        std::deque<Request> pending;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queued.wait(lock, [this]() { return !m_queue.empty() || m_closed; });
+            if (m_queue.empty())
+                return;
+            pending.swap(m_queue);
+        }
+
+        // Requests queued during the previous batch are grouped by route and departure in the order of arrival,
+        // requests before a reload are answered with the old profiles
+        std::vector<std::vector<Request>> batches;
+        std::map<std::string, std::size_t> batchIndex;
+        for (auto &request : pending) {
+            if (request.reload) {
+                for (const auto &batch : batches) {
+                    Simulate(batch);
+                }
+                batches.clear();
+                batchIndex.clear();
+                Reload(request);
+                continue;
+            }
+
+            std::ostringstream key;
+            key << request.routeFile << ";" << request.startDay << ";" << request.startHour << ";"
+                << request.startMinute;
+            auto it = batchIndex.find(key.str());
+            if (it == batchIndex.end()) {
+                it = batchIndex.insert({key.str(), batches.size()}).first;
+                batches.emplace_back();
+            }
+            batches[it->second].push_back(std::move(request));
+        }
+
+        for (const auto &batch : batches) {
+            Simulate(batch);
+        }
+    }
+}
+
+uint64_t Routing::TravelTimeServer::GetRequestCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_requests;
+}
+
+uint64_t Routing::TravelTimeServer::GetBatchCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_batches;
+}
+
+bool Routing::TravelTimeServer::Parse(const std::string &line, Request &request, std::string &error) {
+    std::istringstream lineStream(line);
+    CSVReader row(';');
+    if (!(lineStream >> row) || row.size() == 0) {
+        error = "empty request";
+        return false;
+    }
+    request.id = row[0];
+    if (row.size() != 6 && row.size() != 7) {
+        error = "invalid column count";
+        return false;
+    }
+
+    try {
+        request.routeFile = row[1];
+        request.startDay = row[2].ToInt();
+        request.startHour = row[3].ToInt();
+        request.startMinute = row[4].ToInt();
+        request.samples = row[5].ToInt();
+        if (row.size() == 7) {
+            std::istringstream percentileStream(static_cast<std::string>(row[6]));
+            CSVReader percentiles(',');
+            percentileStream >> percentiles;
+            for (std::size_t i = 0; i < percentiles.size(); ++i) {
+                request.percentiles.push_back(percentiles[i].ToFloat());
+            }
+        } else {
+            request.percentiles = {0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95};
+        }
+    } catch (const std::exception &) {
+        error = "invalid number";
+        return false;
+    }
+
+    if (request.startDay < 0 || request.startDay > 6 || request.startHour < 0 || request.startHour > 23 ||
+        request.startMinute < 0 || request.startMinute > 59) {
+        error = "invalid departure";
+        return false;
+    }
+    if (request.samples < 1 || request.samples > SERVER_MAX_SAMPLES) {
+        error = "invalid number of samples";
+        return false;
+    }
+    for (const auto &p : request.percentiles) {
+        if (!(p >= 0.0f && p <= 1.0f)) {
+            error = "invalid percentile";
+            return false;
+        }
+    }
+    return true;
+}
+
+void Routing::TravelTimeServer::Simulate(const std::vector<Request> &batch) {
+    const Request &first = batch.front();
+    std::vector<const Request *> simulated;
+    std::size_t answered = 0;
+    auto fail = [&simulated, &answered](const std::string &error) {
+        for (std::size_t i = answered; i < simulated.size(); ++i) {
+            simulated[i]->reply(simulated[i]->id + ";ERROR;" + error);
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests += batch.size();
+    }
+
+    // Departure interval is known once the first profiles are loaded
+    std::string error;
+    const RouteInfo *info = GetRouteInfo(first.routeFile, error);
+    int startSeconds = (first.startDay * 86400) + (first.startHour * 3600) + (first.startMinute * 60);
+    float secondInterval = m_cache.GetSecondInterval();
+    std::vector<float> taken;
+    for (const auto &request : batch) {
+        if (info != nullptr && m_results != nullptr && secondInterval > 0 &&
+            m_results->Lookup({info->fingerprint, static_cast<int>(startSeconds / secondInterval), request.samples},
+                              taken))
+            Answer(request, taken, 0);
+        else
+            simulated.push_back(&request);
+    }
+    if (info == nullptr) {
+        fail(error);
+        return;
+    }
+    if (simulated.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_batches++;
+    }
+
+    // Failure of a single batch is answered by its requests, the server continues with the next one
+    try {
+        // Segments without a profile are skipped by the cached route, the travel time would miss them
+        CachedRoute route(m_cache, info->segments);
+        if (route.GetSegmentCount() == 0 ||
+            static_cast<std::size_t>(route.GetSegmentCount()) != info->segments.size()) {
+            fail("route has segments without a valid profile");
+            return;
+        }
+
+        int samples = 0;
+        for (const auto request : simulated) {
+            samples = std::max(samples, request->samples);
+        }
+
+        // Profiles are used in place, they stay acquired by the route for the whole batch
+        MCSimulation mc(route, ProfileLayout::Shared);
+        mc.SetRngBackend(m_rngBackend);
+        if (m_hasSeed)
+            mc.SetSeed(m_seed);
+        std::vector<float> travelTimes = mc.RunMonteCarloSimulation(samples, first.startDay, first.startHour,
+                                                                    first.startMinute, false);
+
+        int interval = static_cast<int>(startSeconds / mc.GetSecondInterval());
+        for (; answered < simulated.size(); ++answered) {
+            const Request *request = simulated[answered];
+            // Statistics sort the samples, every request gets a copy of the prefix it asked for
+            taken.assign(travelTimes.begin(), travelTimes.begin() + request->samples);
+            if (m_results != nullptr)
+                m_results->Insert({info->fingerprint, interval, request->samples}, taken);
+            Answer(*request, taken, simulated.size());
+        }
+    } catch (const std::exception &e) {
+        fail(std::string("simulation failed: ") + e.what());
+    }
+}
+
+void Routing::TravelTimeServer::Answer(const Request &request, std::vector<float> &travelTimes, std::size_t batch) {
+    ResultStats stats(travelTimes, request.percentiles);
+    double latency = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - request.received).count();
+
+    std::ostringstream reply;
+    reply << request.id << ";OK;" << request.samples << ";" << stats.mean << ";" << stats.sampleDev << ";";
+    for (auto it = stats.percentiles.begin(); it != stats.percentiles.end(); ++it) {
+        reply << (it == stats.percentiles.begin() ? "" : ",") << it->first << ":" << it->second;
+    }
+    reply << ";" << latency << ";" << batch;
+    request.reply(reply.str());
+}
+
+void Routing::TravelTimeServer::Reload(const Request &request) {
+    // Dispatcher holds no route between the batches, so none of the profiles is in use
+    if (!m_cache.Invalidate()) {
+        request.reply(request.id + ";ERROR;profiles are in use");
+        return;
+    }
+    if (m_results != nullptr)
+        m_results->Invalidate();
+    m_routes.clear();
+    request.reply(request.id + ";OK");
+}
+
+const Routing::TravelTimeServer::RouteInfo *Routing::TravelTimeServer::GetRouteInfo(const std::string &routeFile,
+                                                                                   std::string &error) {
+    struct stat status;
+    if (stat(routeFile.c_str(), &status) != 0) {
+        error = "unable to open route file";
+        return nullptr;
+    }
+
+    auto it = m_routes.find(routeFile);
+    if (it != m_routes.end() && it->second.modified.tv_sec == status.st_mtim.tv_sec &&
+        it->second.modified.tv_nsec == status.st_mtim.tv_nsec)
+        return &it->second;
+
+    // File is read once, it may change or disappear after the stat, the next request then reads it again
+    std::ifstream routeStream(routeFile);
+    std::vector<Data::Segment> segments;
+    if (!routeStream.is_open()) {
+        error = "unable to open route file";
+    } else if (!Data::ReadEdges(routeStream, segments)) {
+        error = "invalid route file";
+    } else if (segments.empty()) {
+        error = "route has no segments";
+    } else {
+        RouteInfo &info = m_routes[routeFile];
+        info = {status.st_mtim, ResultCache::Fingerprint(segments), std::move(segments)};
+        return &info;
+    }
+    m_routes.erase(routeFile);
+    return nullptr;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Data.h"
+#include "RandomGenerator.h"
+
+#define SERVER_MAX_SAMPLES 10000000 // Largest number of samples of a single request
+
+namespace Routing {
+    class ProfileCache;
+
+    class ResultCache;
+
+    /**
+     * Resident travel time service answering requests of a line protocol. A request is a single line
+     *
+     *     id;route edges file;day;hour;minute;samples(;percentiles separated by commas)
+     *
+     * and the reply is the line
+     *
+     *     id;OK;samples;mean;sample_dev;percentile:value,...;latency_ms;batch
+     *
+     * or id;ERROR;message. Requests are queued by any number of threads and simulated by a single dispatcher in
+     * batches, requests of the same route and departure time queued while the previous batch runs are coalesced into
+     * one simulation of the largest sample count, smaller requests use its first samples. Profiles of the routes are
+     * kept resident by the profile cache. With a result cache, requests of a route, departure interval and sample
+     * count simulated before are answered from the cache with batch 0. The line reload drops both caches after the
+     * requests queued before it are answered, so changed profile files take effect.
+     */
+    class TravelTimeServer {
+    public:
+        /**
+         * Constructor
+         * @param cache profiles of the road network, must outlive the server
+         * @param results cache of the simulated travel times, must outlive the server, nullptr disables caching
+         */
+        explicit TravelTimeServer(ProfileCache &cache, ResultCache *results = nullptr);
+
+        TravelTimeServer(const TravelTimeServer &) = delete;
+
+        TravelTimeServer &operator=(const TravelTimeServer &) = delete;
+
+        /**
+         * Select random number generator backend of the simulations
+         * @param backend generator backend
+         */
+        void SetRngBackend(RngBackend backend);
+
+        /**
+         * Fix the seed of the simulations, otherwise every batch is seeded by std::rand
+         * @param seed seed of all the batches
+         */
+        void SetSeed(uint64_t seed);
+
+        /**
+         * Parse and queue a request. Thread safe.
+         * @param line request line
+         * @param reply called with the reply line (without the line end) from the dispatcher thread, invalid
+         * requests are answered immediately on the calling thread
+         */
+        void Submit(const std::string &line, const std::function<void(const std::string &)> &reply);
+
+        /**
+         * Stop accepting requests, Serve returns once the queued ones are answered. Thread safe.
+         */
+        void Close();
+
+        /**
+         * Dispatch the queued requests on the calling thread until the server is closed
+         */
+        void Serve();
+
+        /**
+         * @return number of answered requests
+         */
+        uint64_t GetRequestCount() const;
+
+        /**
+         * @return number of simulated batches, coalesced requests share a batch
+         */
+        uint64_t GetBatchCount() const;
+
+    private:
+        /**
+         * Single queued request
+         */
+        struct Request {
+            std::string id;
+            std::string routeFile;
+            int startDay;
+            int startHour;
+            int startMinute;
+            int samples;
+            std::vector<float> percentiles;
+            std::chrono::steady_clock::time_point received;
+            std::function<void(const std::string &)> reply;
+            bool reload; // Drop the caches instead of simulating
+        };
+
+        /**
+         * Route file read by the dispatcher
+         */
+        struct RouteInfo {
+            timespec modified; // Modification time of the file when it was read
+            uint64_t fingerprint; // See ResultCache::Fingerprint
+            std::vector<Data::Segment> segments; // Segments of the file
+        };
+
+        /**
+         * Parse request line
+         * @param line request line
+         * @param request is set to the parsed request
+         * @param error is set to the reason of failure
+         * @return false if the line is not a valid request
+         */
+        static bool Parse(const std::string &line, Request &request, std::string &error);
+
+        /**
+         * Simulate requests of the same route and departure time as a single batch and answer them, failures are
+         * answered by error replies of the requests
+         * @param batch coalesced requests
+         */
+        void Simulate(const std::vector<Request> &batch);
+
+        /**
+         * Compute statistics of the travel times and send the reply
+         * @param request answered request
+         * @param travelTimes travel times of the request, sorted in place
+         * @param batch number of requests sharing the simulation, 0 for a cached result
+         */
+        static void Answer(const Request &request, std::vector<float> &travelTimes, std::size_t batch);
+
+        /**
+         * Drop the profile and result caches and answer the reload request
+         * @param request reload request
+         */
+        void Reload(const Request &request);
+
+        /**
+         * Get fingerprint and segments of a route file, the file is read again only when modified. Invalid files do
+         * not terminate the server.
+         * @param routeFile route edges file
+         * @param error is set to the reason of failure
+         * @return information about the route, nullptr if the file cannot be read or has an invalid row
+         */
+        const RouteInfo *GetRouteInfo(const std::string &routeFile, std::string &error);
+
+        /**
+         * Profiles of the road network
+         */
+        ProfileCache &m_cache;
+
+        /**
+         * Simulated travel times, null if caching is disabled
+         */
+        ResultCache *m_results;
+
+        /**
+         * Routes read by the dispatcher indexed by the file name, used only by the dispatcher thread
+         */
+        std::map<std::string, RouteInfo> m_routes;
+
+        /**
+         * Random number generator backend of the simulations
+         */
+        RngBackend m_rngBackend = RandomGenerator::DefaultBackend();
+
+        /**
+         * Seed of the simulations, valid if m_hasSeed is set
+         */
+        uint64_t m_seed = 0;
+
+        /**
+         * True if the seed was fixed by SetSeed
+         */
+        bool m_hasSeed = false;
+
+        /**
+         * Requests waiting for the dispatcher
+         */
+        std::deque<Request> m_queue;
+
+        /**
+         * True once Close was called
+         */
+        bool m_closed = false;
+
+        /**
+         * Statistics of the server
+         */
+        uint64_t m_requests = 0;
+        uint64_t m_batches = 0;
+
+        /**
+         * Guards the queue, the closed flag and the statistics
+         */
+        mutable std::mutex m_mutex;
+
+        /**
+         * Signals queued requests and closing to the dispatcher
+         */
+        std::condition_variable m_queued;
+    };
+}
@@ -3,13 +3,16 @@
 #include <vector>
 #include "Data.h"
 #include "MCSimulation.h"
+#include "NumaTopology.h"
+#include "ResultSink.h"
 #include "ResultStats.h"
+#include "SimulationCounters.h"
 
 #include <margot.hpp>
 
 void printHelp() {
     std::cout
-            << "Usage: ptdr -n [number of samples] -e [edges_file.csv] -p [profiles directory] -o [output_file.csv] (-l, -a) -d [start day] -h [start hour] -m [start minute]"
+            << "Usage: ptdr -n [number of samples] -e [edges_file.csv] -p [profiles directory] -o [output_file.csv] (-l, -a) -d [start day] -h [start hour] -m [start minute] (-g [rng] -s [seed] -c -q [error] -t [error] -b -x -w -u [numa] -j [report.json])"
             << std::endl;
     std::cout << "\t Arguments:" << std::endl;
     std::cout << "\t\t -n: number of Monte Carlo samples to execute" << std::endl;
@@ -19,9 +22,46 @@ void printHelp() {
     std::cout << "\t\t -d: Start day (0-6)" << std::endl;
     std::cout << "\t\t -h: Start hour (0-23)" << std::endl;
     std::cout << "\t\t -m: Start minute (0-59)" << std::endl;
+    std::cout << "\t\t -g: Random number generator (gnu, mkl, philox)" << std::endl;
+    std::cout << "\t\t -s: Random seed, makes the philox results independent of thread count" << std::endl;
+    std::cout << "\t\t -q: Summarize the samples by a streaming sketch with the given relative percentile error,"
+              << " the samples are not stored nor written to the output file" << std::endl;
+    std::cout << "\t\t -t: Take samples until the relative standard error of the percentiles is below the given"
+              << " target (e.g. 0.03) instead of the mArgot sample count, -n is the maximum number of samples"
+              << std::endl;
+    std::cout << "\t\t -u: Placement of the profiles on the NUMA nodes (none, replicate, interleave), threads are"
+              << " pinned to the nodes unless OMP_PROC_BIND or OMP_PLACES is set" << std::endl;
+    std::cout << "\t\t -j: Write hot path counters and phase times of the run as JSON" << std::endl;
     std::cout << "\t Flags:" << std::endl;
     std::cout << "\t\t -l: Compute optimal travel time" << std::endl;
-    std::cout << "\t\t -a: Compute for all week intervals (ignores start times)" << std::endl;
+    std::cout << "\t\t -a: Compute for all week intervals (ignores start times), with -q writes statistics of every"
+              << " interval instead of the samples" << std::endl;
+    std::cout << "\t\t -b: Write the samples as a binary result instead of CSV" << std::endl;
+    std::cout << "\t\t -c: Store speed profiles as compact alias tables with exact probabilities" << std::endl;
+    std::cout << "\t\t -w: Precompute travel times of the whole segments at every speed, avoids divisions on short routes"
+              << std::endl;
+    std::cout << "\t\t -x: Convolve histograms of the segment travel times instead of sampling a single departure,"
+              << " writes the statistics instead of the samples, routes with too wide histograms are sampled"
+              << " (not with -a)" << std::endl;
+}
+
+/**
+ * Write the counters of the run if a report was requested
+ * @param reportFile path to the JSON report, empty if not requested
+ * @param counters counters of the run
+ * @return false if the report cannot be written
+ */
+bool writeReport(const std::string &reportFile, const Routing::SimulationCounters &counters) {
+    if (reportFile.empty())
+        return true;
+
+    std::ofstream report(reportFile);
+    counters.WriteJson(report);
+    if (report.fail()) {
+        std::cerr << "ERROR: Failed to write report " << reportFile << std::endl;
+        return false;
+    }
+    return true;
 }
 
 int main(int argc, char *argv[]) {
@@ -33,9 +73,19 @@ int main(int argc, char *argv[]) {
     }
 
     char **largv = argv;
-    std::string edgesPath, profilePath, outputFile;
+    std::string edgesPath, profilePath, outputFile, reportFile;
     int samples = 0, startDay = -1, startHour = -1, startMinute = -1;
     bool optimal = false, all = false;
+    Routing::RngBackend rngBackend = Routing::RandomGenerator::DefaultBackend();
+    uint64_t seed = 0;
+    bool hasSeed = false;
+    Routing::ProfileStorage storage = Routing::ProfileStorage::Expanded;
+    double sketchError = 0.0;
+    double targetError = 0.0;
+    bool binary = false;
+    bool segmentTimes = false;
+    Routing::NumaMode numaMode = Routing::NumaMode::None;
+    Routing::SimulationEngine engine = Routing::SimulationEngine::MonteCarlo;
     while (*++largv) {
         switch ((*largv)[1]) {
             case 'n':
@@ -59,9 +109,51 @@ int main(int argc, char *argv[]) {
             case 'm':
                 startMinute = std::stoi(*++largv);
                 break;
+            case 'g':
+                if (!Routing::RandomGenerator::FromName(*++largv, rngBackend)) {
+                    std::cerr << "Unknown random number generator " << *largv << std::endl;
+                    printHelp();
+                    std::exit(1);
+                }
+                break;
+            case 's':
+                seed = std::stoull(*++largv);
+                hasSeed = true;
+                break;
             case 'l':
                 optimal = true;
                 break;
+            case 'a':
+                all = true;
+                break;
+            case 'c':
+                storage = Routing::ProfileStorage::Alias;
+                break;
+            case 'b':
+                binary = true;
+                break;
+            case 'q':
+                sketchError = std::stod(*++largv);
+                break;
+            case 't':
+                targetError = std::stod(*++largv);
+                break;
+            case 'w':
+                segmentTimes = true;
+                break;
+            case 'x':
+                engine = Routing::SimulationEngine::Histogram;
+                break;
+            case 'u':
+                if (!Routing::NumaTopology::FromName(*++largv, numaMode)) {
+                    std::cerr << "Unknown NUMA mode " << *largv << std::endl;
+                    printHelp();
+                    std::exit(1);
+                }
+                break;
+            case 'j':
+                reportFile = *++largv;
+                break;
             default:
                 printHelp();
                 std::exit(1);
@@ -74,11 +166,30 @@ int main(int argc, char *argv[]) {
         std::exit(1);
     }
 
+    if (all && binary && sketchError > 0.0) {
+        std::cerr << "Options -b and -q cannot be combined with -a, the binary result needs the samples." << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
+    if (all && engine == Routing::SimulationEngine::Histogram) {
+        std::cerr << "Option -x cannot be combined with -a, histograms are convolved for a single departure."
+                  << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
     std::cout << "Samples: " << samples << std::endl;
     std::cout << "Edges file: " << edgesPath << std::endl;
     std::cout << "Profiles directory: " << profilePath << std::endl;
     std::cout << "Output file: " << outputFile << std::endl;
     std::cout << "Compute optimal travel time: " << (optimal ? std::string("Yes") : std::string("No")) << std::endl;
+    std::cout << "RNG: " << Routing::RandomGenerator::Name(rngBackend) << std::endl;
+    std::cout << "Profile storage: "
+              << (storage == Routing::ProfileStorage::Alias ? std::string("Alias tables") : std::string("Expanded"))
+              << std::endl;
+    std::cout << "NUMA: " << Routing::NumaTopology::Name(numaMode) << " ("
+              << Routing::NumaTopology::Get().GetNodeCount() << " nodes)" << std::endl;
     if (!all)
         std::cout << "Start day: " << startDay << " at " << startHour << ":" << startMinute << std::endl;
 
@@ -86,47 +197,188 @@ int main(int argc, char *argv[]) {
     std::cout << "Loading data...";
     std::cout.flush();
     auto startTime = std::chrono::high_resolution_clock::now();
-    Routing::MCSimulation mc(edgesPath, profilePath);
+    Routing::MCSimulation mc(edgesPath, profilePath, Routing::ProfileLayout::IntervalMajor, storage);
+    mc.SetRngBackend(rngBackend);
+    if (hasSeed)
+        mc.SetSeed(seed);
+    mc.SetSegmentTimes(segmentTimes);
+    if (numaMode != Routing::NumaMode::None) {
+        Routing::NumaTopology::Get().PinThreads();
+        mc.SetNumaMode(numaMode);
+    }
+    Routing::SimulationCounters counters;
+    if (!reportFile.empty())
+        mc.SetCounters(&counters);
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::high_resolution_clock::now() - startTime).count();
+    counters.loadSeconds = elapsed / 1000.0;
     std::cout << "OK" << std::endl;
     std::cout << "Elapsed time: " << elapsed << " ms" << std::endl;
 
-    // Initialize margot
-    margot::init();
+    if (optimal) {
+        // Deterministic travel times of the first profile speeds, one per departure interval with -a
+        std::cout << "Computing optimal travel time..." << std::flush;
+        std::vector<float> result = mc.ComputeOptimalTravelTime(startDay, startHour, startMinute, all);
+        std::cout << "OK" << std::endl;
+        std::cout << "Free-flow travel time: " << mc.ComputeFreeFlowTravelTime() << " s" << std::endl;
+        if (!all)
+            std::cout << "Optimal travel time: " << result[0] << " s" << std::endl;
 
-    // Run simulation
-    std::cout << "Runnning simulation..." << std::flush;
-    std::vector<float> result;
+        int startSeconds = all ? 0 : (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
+        Routing::ResultInfo info = {edgesPath, 1, static_cast<int>(result.size()), startSeconds,
+                                    mc.GetSecondInterval()};
+        {
+            Routing::PhaseTimer timer(&counters.writeSeconds);
+            if (binary) {
+                Routing::BinaryResultSink sink(outputFile);
+                sink.Write(info, result);
+            } else {
+                Routing::TextResultSink sink(outputFile);
+                sink.Write(info, result);
+            }
+        }
+        return writeReport(reportFile, counters) ? 0 : 1;
+    }
+
+    const std::vector<float> percentiles = {0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95};
+
+    if (all && sketchError > 0.0) {
+        // Week sweep streams the statistics of every departure interval to the output file
+        std::cout << "Runnning week sweep..." << std::flush;
+        std::ofstream rfile(outputFile);
+        Routing::Data::WriteIntervalSummaryHeader(rfile, percentiles);
+        mc.SweepWeek(samples, percentiles, sketchError, [&rfile](int day, int interval, const ResultStats &stats) {
+            Routing::Data::WriteIntervalSummary(rfile, day, interval, stats);
+        });
+        rfile.close();
+        std::cout << "OK" << std::endl;
+        return writeReport(reportFile, counters) ? 0 : 1;
+    }
 
-    // Extract the data features - unpredictability
-    auto travelTimesFeatNew = mc.RunMonteCarloSimulation(100, startDay, startHour, startMinute, false);
-    ResultStats featStats(travelTimesFeatNew, {});
+    if (all) {
+        // Samples of every departure interval are streamed to the sink, one row per interval as WriteResultAll
+        std::cout << "Runnning week sweep..." << std::flush;
+        Routing::ResultSink *sink;
+        if (binary)
+            sink = new Routing::BinaryResultSink(outputFile);
+        else
+            sink = new Routing::TextResultSink(outputFile);
+        int intervals = static_cast<int>(7 * 86400 / mc.GetSecondInterval());
+        sink->Begin({edgesPath, samples, intervals, 0, mc.GetSecondInterval()});
+        mc.SweepWeekSamples(samples, [sink](int, int, const float *travelTimes) {
+            sink->WriteInterval(travelTimes);
+        });
+        bool written = sink->End();
+        delete sink;
+        if (!written)
+            return 1;
+        std::cout << "OK" << std::endl;
+        return writeReport(reportFile, counters) ? 0 : 1;
+    }
+
+    if (engine == Routing::SimulationEngine::Histogram) {
+        std::cout << "Convolving histograms..." << std::flush;
+        TravelTimeHistogram histogram;
+        if (mc.ConvolveHistograms(startDay, startHour, startMinute, histogram)) {
+            std::cout << "OK" << std::endl;
+            std::cout << "Histogram bins: " << histogram.GetBinCount() << std::endl;
+            ResultStats stats = [&]() {
+                Routing::PhaseTimer timer(&counters.statsSeconds);
+                return ResultStats(histogram, percentiles);
+            }();
+            std::cout << stats << std::endl;
 
-    // Update the application knobs, if needed
-    if (margot::travel::update(samples, featStats.variationCoeff)) {
-        margot::travel::manager.configuration_applied();
+            // Distribution has no samples to write
+            Routing::PhaseTimer timer(&counters.writeSeconds);
+            int interval = static_cast<int>(((startHour * 3600) + (startMinute * 60)) / mc.GetSecondInterval());
+            std::ofstream rfile(outputFile);
+            Routing::Data::WriteIntervalSummaryHeader(rfile, percentiles);
+            Routing::Data::WriteIntervalSummary(rfile, startDay, interval, stats);
+            return writeReport(reportFile, counters) ? 0 : 1;
+        }
+        std::cout << "histogram too wide, sampling" << std::endl;
     }
 
-    // Obtain additional samples if required
-    std::vector<float> travelTimesNew;
-    if (samples != 100) {
-        travelTimesNew = mc.RunMonteCarloSimulation(samples - 100, startDay, startHour, startMinute, false);
-        travelTimesNew.insert(travelTimesNew.end(), travelTimesFeatNew.begin(), travelTimesFeatNew.end());
-    } else
-        result = travelTimesFeatNew;
+    std::vector<float> result;
+    if (targetError > 0.0) {
+        // Sample count follows the unpredictability of the route without the design space exploration
+        std::cout << "Runnning adaptive simulation..." << std::flush;
+        result = mc.RunAdaptiveSimulation(samples, startDay, startHour, startMinute, targetError, percentiles);
+        std::cout << "OK" << std::endl;
+        std::cout << "Used samples: " << result.size() << std::endl;
+
+        Routing::PhaseTimer timer(&counters.statsSeconds);
+        ResultStats stats(result, percentiles);
+        std::cout << stats << std::endl;
+        std::cout << "Percentile standard error: " << ResultStats::PercentileError(result, percentiles) * 100.0
+                  << "%" << std::endl;
+    } else {
+        // Initialize margot
+        margot::init();
 
-    std::cout << "Used samples: " << samples << std::endl;
+        // Run simulation
+        std::cout << "Runnning simulation..." << std::flush;
 
-    // Obtain stats
-    ResultStats stats(result);
-    std::cout << stats << std::endl;
-    margot::travel::log();
+        // Extract the data features - unpredictability
+        result = mc.RunMonteCarloSimulation(100, startDay, startHour, startMinute, false);
+        std::vector<float> featureTimes = result;
+        ResultStats featStats = [&]() {
+            Routing::PhaseTimer timer(&counters.statsSeconds);
+            return ResultStats(featureTimes, {});
+        }();
+
+        // Update the application knobs, if needed
+        if (margot::travel::update(samples, featStats.variationCoeff)) {
+            margot::travel::manager.configuration_applied();
+        }
+
+        if (sketchError > 0.0) {
+            // Memory of the run does not depend on the number of samples
+            QuantileSketch sketch(sketchError);
+            for (const auto &t : result) {
+                sketch.Add(t);
+            }
+            if (samples > 100)
+                mc.RunMonteCarloSimulation(samples - 100, startDay, startHour, startMinute, sketch, 100);
+
+            std::cout << "Used samples: " << sketch.GetCount() << std::endl;
+            {
+                Routing::PhaseTimer timer(&counters.statsSeconds);
+                ResultStats stats(sketch, percentiles);
+                std::cout << stats << std::endl;
+            }
+            margot::travel::log();
+            return writeReport(reportFile, counters) ? 0 : 1;
+        }
+
+        // Obtain additional samples if required, they continue after the feature samples
+        mc.ExtendSimulation(result, samples - 100, startDay, startHour, startMinute);
+
+        std::cout << "Used samples: " << result.size() << std::endl;
+
+        // Obtain stats, the samples are sorted in place
+        {
+            Routing::PhaseTimer timer(&counters.statsSeconds);
+            ResultStats stats(result, percentiles);
+            std::cout << stats << std::endl;
+        }
+        margot::travel::log();
+    }
 
     // Write results
     std::cout << "Writing result..." << std::flush;
-    Routing::Data::WriteResultSingle(result, outputFile);
+    {
+        Routing::PhaseTimer timer(&counters.writeSeconds);
+        if (binary) {
+            Routing::BinaryResultSink sink(outputFile);
+            int startSeconds = (startDay * 86400) + (startHour * 3600) + (startMinute * 60);
+            sink.Write({edgesPath, static_cast<int>(result.size()), 1, startSeconds, mc.GetSecondInterval()},
+                       result);
+        } else {
+            Routing::Data::WriteResultSingle(result, outputFile);
+        }
+    }
     std::cout << "OK" << std::endl;
 
-    return 0;
+    return writeReport(reportFile, counters) ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
+#include <chrono>
+#include "BatchSimulation.h"
+#include "Data.h"
+#include "MCSimulation.h"
+#include "ProfileDatabase.h"
+#include "ResultStats.h"
+#include "Route.h"
+#include "SimulationCounters.h"
+
+void printHelp() {
+    std::cout
+            << "Usage: ptdr-batch -n [number of samples] -f [manifest.csv] -p [profiles directory] -o [output_file.csv] (-g [rng] -s [seed] -c -x -k -j [report.json])"
+            << std::endl;
+    std::cout << "\t Arguments:" << std::endl;
+    std::cout << "\t\t -n: number of Monte Carlo samples of every route" << std::endl;
+    std::cout << "\t\t -f: Manifest (CSV) with rows route edges file;day;hour;minute" << std::endl;
+    std::cout << "\t\t -p: Directory with speed profiles or binary profile store" << std::endl;
+    std::cout << "\t\t -o: Output file (CSV), statistics of every manifest row" << std::endl;
+    std::cout << "\t\t -g: Random number generator (gnu, mkl, philox)" << std::endl;
+    std::cout << "\t\t -s: Random seed, i-th distinct route of the manifest is seeded by seed + i" << std::endl;
+    std::cout << "\t\t -j: Write hot path counters and phase times of the run as JSON" << std::endl;
+    std::cout << "\t Flags:" << std::endl;
+    std::cout << "\t\t -c: Store speed profiles as compact alias tables with exact probabilities" << std::endl;
+    std::cout << "\t\t -x: Convolve histograms of the segment travel times instead of sampling, routes with too wide"
+              << " histograms are sampled" << std::endl;
+    std::cout << "\t\t -k: Compare both engines on every manifest row, the output file receives their run times and"
+              << " differences of the statistics" << std::endl;
+}
+
+/**
+ * Run every request by both engines one after another and write their run times and the differences of their
+ * statistics. Histogram is taken as the reference, the sampling error of the percentiles shows whether the
+ * difference is explained by the sampling noise.
+ * @param database profiles of all the routes
+ * @param requests routes and departure times
+ * @param samples number of Monte Carlo samples of every request
+ * @param percentiles percentile values to compare
+ * @param rngBackend random number generator backend
+ * @param seed seed of the first route, i-th distinct route is seeded by seed + i, only if hasSeed is set
+ * @param hasSeed true if the seed is fixed
+ * @param output comparison CSV
+ */
+void compareEngines(const Routing::ProfileDatabase &database, const std::vector<Routing::Data::BatchEntry> &requests,
+                    int samples, const std::vector<float> &percentiles, Routing::RngBackend rngBackend, uint64_t seed,
+                    bool hasSeed, std::ostream &output) {
+    output << "route;day;hour;minute;segments;samples;mc_ms;histogram_ms;histogram_bins;mc_mean;histogram_mean;"
+           << "max_percentile_diff;mc_percentile_error" << std::endl;
+
+    std::map<std::string, Routing::MCSimulation *> simulations;
+    for (const auto &request : requests) {
+        auto it = simulations.find(request.routeFile);
+        if (it == simulations.end()) {
+            it = simulations.insert({request.routeFile, new Routing::MCSimulation(
+                    database, Routing::Route(database, request.routeFile), Routing::ProfileLayout::Shared)}).first;
+            it->second->SetRngBackend(rngBackend);
+            it->second->SetSeed(hasSeed ? seed + simulations.size() - 1 : static_cast<uint64_t>(std::rand()));
+        }
+        Routing::MCSimulation &mc = *it->second;
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<float> travelTimes = mc.RunMonteCarloSimulation(samples, request.startDay, request.startHour,
+                                                                    request.startMinute, false);
+        ResultStats mcStats(travelTimes, percentiles);
+        double mcTime = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - startTime).count();
+
+        // Comparison needs the complete histogram however wide it gets
+        startTime = std::chrono::high_resolution_clock::now();
+        TravelTimeHistogram histogram;
+        mc.ConvolveHistograms(request.startDay, request.startHour, request.startMinute, histogram,
+                              static_cast<std::size_t>(-1));
+        ResultStats histogramStats(histogram, percentiles);
+        double histogramTime = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - startTime).count();
+
+        double difference = 0.0;
+        for (const auto &p : percentiles) {
+            double reference = histogramStats.percentiles[p];
+            if (reference > 0.0)
+                difference = std::max(difference, std::fabs(mcStats.percentiles[p] - reference) / reference);
+        }
+
+        // Samples were sorted by the statistics
+        output << request.routeFile << ";" << request.startDay << ";" << request.startHour << ";"
+               << request.startMinute << ";" << mc.GetSegmentCount() << ";" << samples << ";" << mcTime << ";"
+               << histogramTime << ";" << histogram.GetBinCount() << ";" << mcStats.mean << ";"
+               << histogramStats.mean << ";" << difference << ";"
+               << ResultStats::PercentileError(travelTimes, percentiles) << std::endl;
+    }
+
+    for (auto &simulation : simulations) {
+        delete simulation.second;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 9) {
+        // Assuming n f p o
+        std::cerr << "Invalid argument count." << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
+    char **largv = argv;
+    std::string manifestPath, profilePath, outputFile, reportFile;
+    int samples = 0;
+    Routing::RngBackend rngBackend = Routing::RandomGenerator::DefaultBackend();
+    uint64_t seed = 0;
+    bool hasSeed = false;
+    Routing::ProfileStorage storage = Routing::ProfileStorage::Expanded;
+    Routing::SimulationEngine engine = Routing::SimulationEngine::MonteCarlo;
+    bool compare = false;
+    while (*++largv) {
+        switch ((*largv)[1]) {
+            case 'n':
+                samples = std::stoi(*++largv);
+                break;
+            case 'f':
+                manifestPath = *++largv;
+                break;
+            case 'p':
+                profilePath = *++largv;
+                break;
+            case 'o':
+                outputFile = *++largv;
+                break;
+            case 'g':
+                if (!Routing::RandomGenerator::FromName(*++largv, rngBackend)) {
+                    std::cerr << "Unknown random number generator " << *largv << std::endl;
+                    printHelp();
+                    std::exit(1);
+                }
+                break;
+            case 's':
+                seed = std::stoull(*++largv);
+                hasSeed = true;
+                break;
+            case 'c':
+                storage = Routing::ProfileStorage::Alias;
+                break;
+            case 'x':
+                engine = Routing::SimulationEngine::Histogram;
+                break;
+            case 'k':
+                compare = true;
+                break;
+            case 'j':
+                reportFile = *++largv;
+                break;
+            default:
+                printHelp();
+                std::exit(1);
+        }
+    }
+
+    std::vector<Routing::Data::BatchEntry> requests = Routing::Data::LoadBatchManifest(manifestPath);
+    std::set<std::string> routeFiles;
+    for (const auto &request : requests) {
+        routeFiles.insert(request.routeFile);
+    }
+
+    std::cout << "Samples: " << samples << std::endl;
+    std::cout << "Manifest: " << manifestPath << " (" << requests.size() << " requests, " << routeFiles.size()
+              << " routes)" << std::endl;
+    std::cout << "Profiles directory: " << profilePath << std::endl;
+    std::cout << "Output file: " << outputFile << std::endl;
+    std::cout << "RNG: " << Routing::RandomGenerator::Name(rngBackend) << std::endl;
+    std::cout << "Engine: " << (compare ? "comparison" : engine == Routing::SimulationEngine::Histogram
+                                                         ? "histogram convolution" : "Monte Carlo") << std::endl;
+
+    // Single database holds the profiles of all the routes
+    std::cout << "Loading data..." << std::flush;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    Routing::ProfileDatabase database(profilePath, std::vector<std::string>(routeFiles.begin(), routeFiles.end()),
+                                      storage);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+    Routing::SimulationCounters counters;
+    counters.loadSeconds = elapsed / 1000.0;
+    std::cout << "OK" << std::endl;
+    std::cout << "Elapsed time: " << elapsed << " ms" << std::endl;
+
+    const std::vector<float> percentiles = {0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95};
+    std::ofstream rfile(outputFile);
+    if (compare) {
+        std::cout << "Comparing engines..." << std::flush;
+        compareEngines(database, requests, samples, percentiles, rngBackend, seed, hasSeed, rfile);
+        rfile.close();
+        std::cout << "OK" << std::endl;
+        if (rfile.fail()) {
+            std::cerr << "ERROR: Failed to write result " << outputFile << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Simulations of the routes are needed only by the batch, the comparison builds its own. Loading the routes counts
+    // to the load time.
+    startTime = std::chrono::high_resolution_clock::now();
+    Routing::BatchSimulation batch(database, requests);
+    batch.SetRngBackend(rngBackend);
+    batch.SetEngine(engine);
+    if (hasSeed)
+        batch.SetSeed(seed);
+    if (!reportFile.empty())
+        batch.SetCounters(&counters);
+    counters.loadSeconds += std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count() / 1000.0;
+
+    std::cout << "Runnning batch..." << std::flush;
+    startTime = std::chrono::high_resolution_clock::now();
+    Routing::Data::WriteBatchSummaryHeader(rfile, percentiles);
+    batch.Run(samples, percentiles, [&rfile, &requests, samples](int request, const ResultStats &stats) {
+        Routing::Data::WriteBatchSummary(rfile, requests[request], samples, stats);
+    });
+    rfile.close();
+    elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+    std::cout << "OK" << std::endl;
+    std::cout << "Elapsed time: " << elapsed << " ms" << std::endl;
+
+    if (rfile.fail()) {
+        std::cerr << "ERROR: Failed to write result " << outputFile << std::endl;
+        return 1;
+    }
+
+    if (!reportFile.empty()) {
+        std::ofstream report(reportFile);
+        counters.WriteJson(report);
+        if (report.fail()) {
+            std::cerr << "ERROR: Failed to write report " << reportFile << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
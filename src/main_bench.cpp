@@ -0,0 +1,151 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "MCSimulation.h"
+#include "NumaTopology.h"
+#include "ProfileDatabase.h"
+#include "Route.h"
+
+void printHelp() {
+    std::cout
+            << "Usage: ptdr-bench -n [number of samples] -e [edges_file.csv] -p [profiles directory] -r [repetitions] -d [start day] -h [start hour] -m [start minute] -g [rng] -s [seed] -u [numa]"
+            << std::endl;
+    std::cout << "\t Arguments:" << std::endl;
+    std::cout << "\t\t -n: number of Monte Carlo samples per repetition" << std::endl;
+    std::cout << "\t\t -e: Edges file (CSV)" << std::endl;
+    std::cout << "\t\t -p: Directory with speed profiles or binary profile store" << std::endl;
+    std::cout << "\t\t -r: Number of measured repetitions (default 5)" << std::endl;
+    std::cout << "\t\t -d: Start day (0-6)" << std::endl;
+    std::cout << "\t\t -h: Start hour (0-23)" << std::endl;
+    std::cout << "\t\t -m: Start minute (0-59)" << std::endl;
+    std::cout << "\t\t -g: Random number generator (gnu, mkl, philox)" << std::endl;
+    std::cout << "\t\t -s: Random seed" << std::endl;
+    std::cout << "\t\t -u: Placement of the profiles on the NUMA nodes (none, replicate, interleave), threads are"
+              << " pinned to the nodes unless OMP_PROC_BIND or OMP_PLACES is set" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 7) {
+        // Assuming n e p
+        std::cerr << "Invalid argument count." << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
+    char **largv = argv;
+    std::string edgesPath, profilePath;
+    int samples = 0, repetitions = 5, startDay = 0, startHour = 8, startMinute = 0;
+    Routing::RngBackend rngBackend = Routing::RandomGenerator::DefaultBackend();
+    uint64_t seed = 0;
+    bool hasSeed = false;
+    Routing::NumaMode numaMode = Routing::NumaMode::None;
+    while (*++largv) {
+        switch ((*largv)[1]) {
+            case 'n':
+                samples = std::stoi(*++largv);
+                break;
+            case 'e':
+                edgesPath = *++largv;
+                break;
+            case 'p':
+                profilePath = *++largv;
+                break;
+            case 'r':
+                repetitions = std::stoi(*++largv);
+                break;
+            case 'd':
+                startDay = std::stoi(*++largv);
+                break;
+            case 'h':
+                startHour = std::stoi(*++largv);
+                break;
+            case 'm':
+                startMinute = std::stoi(*++largv);
+                break;
+            case 'g':
+                if (!Routing::RandomGenerator::FromName(*++largv, rngBackend)) {
+                    std::cerr << "Unknown random number generator " << *largv << std::endl;
+                    printHelp();
+                    std::exit(1);
+                }
+                break;
+            case 's':
+                seed = std::stoull(*++largv);
+                hasSeed = true;
+                break;
+            case 'u':
+                if (!Routing::NumaTopology::FromName(*++largv, numaMode)) {
+                    std::cerr << "Unknown NUMA mode " << *largv << std::endl;
+                    printHelp();
+                    std::exit(1);
+                }
+                break;
+            default:
+                printHelp();
+                std::exit(1);
+        }
+    }
+
+    const std::vector<std::pair<std::string, Routing::ProfileStorage>> storages = {
+            {"expanded", Routing::ProfileStorage::Expanded},
+            {"alias",    Routing::ProfileStorage::Alias}};
+
+    const std::vector<std::pair<std::string, Routing::ProfileLayout>> layouts = {
+            {"shared",         Routing::ProfileLayout::Shared},
+            {"interval-major", Routing::ProfileLayout::IntervalMajor},
+            {"segment-major",  Routing::ProfileLayout::SegmentMajor}};
+
+    if (numaMode != Routing::NumaMode::None)
+        Routing::NumaTopology::Get().PinThreads();
+
+    // Machine readable output, one line per storage, layout, supported kernel and segment time table
+    std::cout << "storage;layout;kernel;segment_times;numa;nodes;segments;samples;repetitions;ms;samples_per_s;"
+              << "identical" << std::endl;
+    for (const auto &storage : storages) {
+        Routing::ProfileDatabase database(profilePath, {edgesPath}, storage.second);
+        Routing::Route route(database, edgesPath);
+        for (const auto &layout : layouts) {
+            Routing::MCSimulation mc(database, route, layout.second);
+            mc.SetRngBackend(rngBackend);
+            if (hasSeed)
+                mc.SetSeed(seed);
+            mc.SetNumaMode(numaMode);
+
+            for (auto kernel : {Routing::SimulationKernel::Scalar, Routing::SimulationKernel::AVX2,
+                                Routing::SimulationKernel::AVX512}) {
+                if (!Routing::Kernel::IsSupported(kernel))
+                    continue;
+                mc.SetKernel(kernel);
+
+                // Travel times with the table are compared to the ones without it, identical with a fixed seed
+                std::vector<float> reference;
+                for (bool segmentTimes : {false, true}) {
+                    mc.SetSegmentTimes(segmentTimes);
+
+                    // Warm up caches and the OpenMP thread pool
+                    std::vector<float> result = mc.RunMonteCarloSimulation(samples, startDay, startHour, startMinute,
+                                                                           false);
+                    if (!segmentTimes)
+                        reference = result;
+
+                    auto startTime = std::chrono::high_resolution_clock::now();
+                    for (int r = 0; r < repetitions; ++r) {
+                        mc.RunMonteCarloSimulation(samples, startDay, startHour, startMinute, false);
+                    }
+                    double elapsed = std::chrono::duration<double, std::milli>(
+                            std::chrono::high_resolution_clock::now() - startTime).count();
+
+                    std::cout << storage.first << ";" << layout.first << ";" << Routing::Kernel::Name(kernel) << ";"
+                              << (segmentTimes ? "yes" : "no") << ";" << Routing::NumaTopology::Name(numaMode) << ";"
+                              << Routing::NumaTopology::Get().GetNodeCount() << ";" << route.GetSegments().size() << ";" << samples
+                              << ";" << repetitions << ";" << elapsed << ";"
+                              << (1000.0 * samples * repetitions / elapsed) << ";"
+                              << (hasSeed ? (result == reference ? "yes" : "no") : "unseeded") << std::endl;
+                }
+                mc.SetSegmentTimes(false);
+            }
+        }
+    }
+
+    return 0;
+}
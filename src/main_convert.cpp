@@ -0,0 +1,76 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "Data.h"
+#include "ProfileStore.h"
+
+void printHelp() {
+    std::cout
+            << "Usage: ptdr-convert -e [edges_file.csv] (-e [edges_file.csv] ...) -p [profiles directory] -o [output_file.ptdr]"
+            << std::endl;
+    std::cout << "\t Arguments:" << std::endl;
+    std::cout << "\t\t -e: Edges file (CSV), may be repeated to merge several routes into one store" << std::endl;
+    std::cout << "\t\t -p: Directory with speed profiles" << std::endl;
+    std::cout << "\t\t -o: Output binary profile store" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 7) {
+        // Assuming e p o
+        std::cerr << "Invalid argument count." << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
+    char **largv = argv;
+    std::vector<std::string> edgesPaths;
+    std::string profilePath, outputFile;
+    while (*++largv) {
+        switch ((*largv)[1]) {
+            case 'e':
+                edgesPaths.push_back(*++largv);
+                break;
+            case 'p':
+                profilePath = *++largv;
+                break;
+            case 'o':
+                outputFile = *++largv;
+                break;
+            default:
+                printHelp();
+                std::exit(1);
+        }
+    }
+
+    std::cout << "Edges files: " << edgesPaths.size() << std::endl;
+    std::cout << "Profiles directory: " << profilePath << std::endl;
+    std::cout << "Output file: " << outputFile << std::endl;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::map<std::string, std::string> profilesByTmcId = Routing::Data::ListSpeedProfiles(profilePath);
+
+    // Collect segments of all edges files, lengths and freeflow speeds are stored along the profiles
+    std::vector<Routing::ProfileStore::Source> sources;
+    for (const auto &edgesPath : edgesPaths) {
+        for (const auto &segment : Routing::Data::LoadEdges(edgesPath)) {
+            auto profile = profilesByTmcId.find(segment.tmcId);
+            if (profile == profilesByTmcId.end()) {
+                std::cerr << "ERROR: Profile for segment " << segment.tmcId << " not found in profile directory "
+                          << profilePath << std::endl;
+                continue;
+            }
+            sources.push_back({segment.tmcId, profile->second, segment.length, segment.freeSpeed});
+        }
+    }
+
+    std::cout << "Converting " << sources.size() << " segments..." << std::flush;
+    if (!Routing::ProfileStore::Convert(sources, outputFile)) {
+        std::exit(EXIT_FAILURE);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+    std::cout << "OK" << std::endl;
+    std::cout << "Elapsed time: " << elapsed << " ms" << std::endl;
+
+    return 0;
+}
@@ -104,6 +104,7 @@ int main(int argc, char *argv[]) {
     std::cout << "Output file: " << outputFile << std::endl;
     std::cout << "Compute optimal travel time: " << (optimal ? std::string("Yes") : std::string("No")) << std::endl;
     std::cout << "Run all simulations: " << (all ? std::string("Yes") : std::string("No")) << std::endl;
+    std::cout << "RNG: " << Routing::RandomGenerator::Name(Routing::RandomGenerator::DefaultBackend()) << std::endl;
     if (!all)
         std::cout << "Start day: " << startDay << " at " << startHour << ":" << startMinute << std::endl;
 
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "Data.h"
+
+#define GENERATE_MIN_LENGTH 50 // Shortest generated segment in meters
+#define GENERATE_MAX_LENGTH 1500 // Longest generated segment in meters
+#define GENERATE_MIN_SPEED 5.0f // Lowest generated speed in km/h
+#define GENERATE_CONGESTED_FACTOR 0.25f // Share of the freeflow speed in the most congested state
+
+void printHelp() {
+    std::cout
+            << "Usage: ptdr-generate -n [number of segments] -e [edges_file.csv] -p [profiles directory] (-i [interval] -l [levels] -k [states] -c [persistence] -s [seed])"
+            << std::endl;
+    std::cout << "\t Arguments:" << std::endl;
+    std::cout << "\t\t -n: Number of segments of the generated route" << std::endl;
+    std::cout << "\t\t -e: Edges file (CSV) to write" << std::endl;
+    std::cout << "\t\t -p: Directory to write the speed profiles to, created if missing" << std::endl;
+    std::cout << "\t\t -i: Length of the profile time interval in minutes, divides or is a multiple of an hour (default 15)"
+              << std::endl;
+    std::cout << "\t\t -l: Maximal number of speed levels of an interval (default 4)" << std::endl;
+    std::cout << "\t\t -k: Number of congestion states of the Markov chain (default 3)" << std::endl;
+    std::cout << "\t\t -c: Probability of staying in the congestion state in the next interval (default 0.9)"
+              << std::endl;
+    std::cout << "\t\t -s: Random seed, the output does not depend on the number of threads (default 0)" << std::endl;
+}
+
+/**
+ * Parameters of the congestion model
+ */
+struct CongestionModel {
+    int secondInterval;
+    int maxLevels;
+    int states;
+    float persistence;
+};
+
+/**
+ * Probability that the congestion state moves towards heavier congestion when it changes, traffic builds up during
+ * the rush hours of working days and clears at night
+ * @param day day of the week (0-6)
+ * @param hour hour of the day
+ */
+float worseningProbability(int day, int hour) {
+    if (day < 5 && ((hour >= 7 && hour < 9) || (hour >= 16 && hour < 18)))
+        return 0.8f;
+    if (hour >= 22 || hour < 5)
+        return 0.2f;
+    return 0.5f;
+}
+
+/**
+ * Generate a segment and its speed distributions. Congestion state of the segment is a Markov chain over the intervals
+ * of the week, state 0 is freeflow and every further state lowers the mean speed. Every interval gets a random number
+ * of speed levels around the speed of its state with probabilities in whole percents.
+ * @param model parameters of the congestion model
+ * @param rng random number generator of the segment
+ * @param segment is set to the length and freeflow speed of the segment
+ * @param levels is set to the speed distributions of the segment
+ */
+void generateSegment(const CongestionModel &model, std::mt19937_64 &rng, Routing::Data::Segment &segment,
+                     Routing::Data::SpeedLevels &levels) {
+    static const float roadSpeeds[] = {50.0f, 90.0f, 130.0f}; // Freeflow speeds of the road classes in km/h
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int> lengthDist(GENERATE_MIN_LENGTH, GENERATE_MAX_LENGTH);
+    std::uniform_int_distribution<int> roadDist(0, 2);
+    std::uniform_int_distribution<int> countDist(1, model.maxLevels);
+    std::uniform_int_distribution<int> cutDist(1, 99);
+
+    float freeflowSpeed = roadSpeeds[roadDist(rng)];
+    segment.length = lengthDist(rng);
+    segment.freeSpeed = freeflowSpeed / 3.6f;
+
+    int intervalsPerDay = 86400 / model.secondInterval;
+    levels.intervals = 7 * intervalsPerDay;
+    levels.maxLevels = model.maxLevels;
+    levels.counts.assign(levels.intervals, 0);
+    levels.speeds.assign(levels.intervals * levels.maxLevels, 0.0f);
+    levels.probabilities.assign(levels.intervals * levels.maxLevels, 0.0f);
+
+    int state = 0;
+    std::vector<int> cuts;
+    for (int i = 0; i < levels.intervals; ++i) {
+        if (unit(rng) >= model.persistence) {
+            int hour = (i % intervalsPerDay) * model.secondInterval / 3600;
+            if (unit(rng) < worseningProbability(i / intervalsPerDay, hour))
+                state = std::min(state + 1, model.states - 1);
+            else
+                state = std::max(state - 1, 0);
+        }
+        float factor = 1.0f;
+        if (model.states > 1)
+            factor -= (1.0f - GENERATE_CONGESTED_FACTOR) * state / (model.states - 1);
+
+        // Split 100 percent among the levels by distinct cut points
+        int count = countDist(rng);
+        cuts.assign({0, 100});
+        while (static_cast<int>(cuts.size()) < count + 1) {
+            int cut = cutDist(rng);
+            if (std::find(cuts.begin(), cuts.end(), cut) == cuts.end())
+                cuts.push_back(cut);
+        }
+        std::sort(cuts.begin(), cuts.end());
+
+        levels.counts[i] = count;
+        for (int l = 0; l < count; ++l) {
+            float speed = std::max(freeflowSpeed * factor * (0.6f + 0.5f * unit(rng)), GENERATE_MIN_SPEED);
+            levels.speeds[i * levels.maxLevels + l] = speed / 3.6f;
+            levels.probabilities[i * levels.maxLevels + l] = (cuts[l + 1] - cuts[l]) / 100.0f;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 7) {
+        // Assuming n e p
+        std::cerr << "Invalid argument count." << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
+    char **largv = argv;
+    std::string edgesPath, profilePath;
+    int segmentCount = 0, intervalMinutes = 15;
+    uint64_t seed = 0;
+    CongestionModel model = {0, 4, 3, 0.9f};
+    while (*++largv) {
+        switch ((*largv)[1]) {
+            case 'n':
+                segmentCount = std::stoi(*++largv);
+                break;
+            case 'e':
+                edgesPath = *++largv;
+                break;
+            case 'p':
+                profilePath = *++largv;
+                break;
+            case 'i':
+                intervalMinutes = std::stoi(*++largv);
+                break;
+            case 'l':
+                model.maxLevels = std::stoi(*++largv);
+                break;
+            case 'k':
+                model.states = std::stoi(*++largv);
+                break;
+            case 'c':
+                model.persistence = std::stof(*++largv);
+                break;
+            case 's':
+                seed = std::stoull(*++largv);
+                break;
+            default:
+                printHelp();
+                std::exit(1);
+        }
+    }
+
+    // Loader derives the interval from the first two rows, so it has to divide an hour or be whole hours of a day
+    if (intervalMinutes <= 0 ||
+        (60 % intervalMinutes != 0 && (intervalMinutes % 60 != 0 || 1440 % intervalMinutes != 0))) {
+        std::cerr << "ERROR: Interval of " << intervalMinutes << " minutes does not divide an hour or a day" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (segmentCount <= 0 || model.maxLevels < 1 || model.maxLevels > 99 || model.states < 1 ||
+        model.persistence < 0.0f || model.persistence > 1.0f) {
+        std::cerr << "ERROR: Invalid parameters of the generator" << std::endl;
+        printHelp();
+        std::exit(EXIT_FAILURE);
+    }
+    model.secondInterval = 60 * intervalMinutes;
+
+    std::cout << "Segments: " << segmentCount << std::endl;
+    std::cout << "Edges file: " << edgesPath << std::endl;
+    std::cout << "Profiles directory: " << profilePath << std::endl;
+    std::cout << "Interval: " << intervalMinutes << " min, levels: " << model.maxLevels << ", states: " << model.states
+              << ", persistence: " << model.persistence << std::endl;
+
+    if (mkdir(profilePath.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "ERROR: Cannot create directory " << profilePath << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "Generating..." << std::flush;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::vector<Routing::Data::Segment> segments(segmentCount);
+    bool failed = false;
+#pragma omp parallel
+    {
+        Routing::Data::SpeedLevels levels;
+#pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < segmentCount; ++i) {
+            // Every segment has its own generator, so the output is the same for any schedule
+            std::seed_seq seq = {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+                                 static_cast<uint32_t>(i)};
+            std::mt19937_64 rng(seq);
+            segments[i].tmcId = std::to_string(i);
+            generateSegment(model, rng, segments[i], levels);
+            if (!Routing::Data::WriteSpeedLevels(profilePath + "/" + segments[i].tmcId + "_profile.csv", levels,
+                                                 model.secondInterval)) {
+#pragma omp atomic write
+                failed = true;
+            }
+        }
+    }
+    if (failed || !Routing::Data::WriteEdges(edgesPath, segments))
+        std::exit(EXIT_FAILURE);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+    std::cout << "OK" << std::endl;
+    std::cout << "Elapsed time: " << elapsed << " ms" << std::endl;
+
+    return 0;
+}
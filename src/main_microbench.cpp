@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "Data.h"
+#include "MCSimulation.h"
+#include "ProfileDatabase.h"
+#include "ResultStats.h"
+#include "Route.h"
+
+#define MICROBENCH_MIN_TIME 0.2 // Minimal duration of a single measured repetition in seconds
+
+void printHelp() {
+    std::cout
+            << "Usage: ptdr-microbench -e [edges_file.csv] -p [profiles] (-n [number of samples] -r [repetitions] -f [filter] -o [scratch file])"
+            << std::endl;
+    std::cout << "\t Arguments:" << std::endl;
+    std::cout << "\t\t -e: Edges file (CSV)" << std::endl;
+    std::cout << "\t\t -p: Directory with speed profiles or binary profile store" << std::endl;
+    std::cout << "\t\t -n: Number of Monte Carlo samples per iteration (default 10000)" << std::endl;
+    std::cout << "\t\t -r: Number of measured repetitions, the median is reported (default 5)" << std::endl;
+    std::cout << "\t\t -f: Run only benchmarks whose name contains the filter" << std::endl;
+    std::cout << "\t\t -o: Scratch file written by the output benchmark (default ptdr-microbench.tmp)" << std::endl;
+}
+
+/**
+ * Measurement of a single benchmark, the body is repeated until a repetition lasts at least MICROBENCH_MIN_TIME
+ */
+class Benchmark {
+public:
+    /**
+     * Constructor
+     * @param repetitions number of measured repetitions
+     * @param filter benchmarks whose name does not contain it are skipped
+     */
+    Benchmark(int repetitions, const std::string &filter) : m_repetitions(repetitions), m_filter(filter) {}
+
+    /**
+     * @param name name of the benchmark
+     * @return true if the benchmark is selected by the filter
+     */
+    bool Enabled(const std::string &name) const {
+        return name.find(m_filter) != std::string::npos;
+    }
+
+    /**
+     * Measure the body and print a row name;parameter;iterations;median_ms;min_ms;max_ms;items_per_s
+     * @param name name of the benchmark
+     * @param parameter value of the varied parameter
+     * @param items work items processed by a single call of the body, e.g. samples
+     * @param body measured code
+     */
+    template<typename Body>
+    void Run(const std::string &name, long parameter, double items, Body body) const {
+        if (!Enabled(name))
+            return;
+
+        // Warm up caches, the thread pool and find the iteration count of a repetition
+        int iterations = 1;
+        while (true) {
+            double elapsed = Time(body, iterations);
+            if (elapsed >= MICROBENCH_MIN_TIME || iterations >= (1 << 20))
+                break;
+            iterations = std::max(iterations * 2,
+                                  static_cast<int>(iterations * 1.2 * MICROBENCH_MIN_TIME / std::max(elapsed, 1e-9)));
+        }
+
+        std::vector<double> times;
+        for (int r = 0; r < m_repetitions; ++r) {
+            times.push_back(1000.0 * Time(body, iterations) / iterations);
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        std::printf("%s;%ld;%d;%.6f;%.6f;%.6f;%.1f\n", name.c_str(), parameter, iterations, median, times.front(),
+                    times.back(), 1000.0 * items / median);
+        std::fflush(stdout);
+    }
+
+private:
+    /**
+     * @return seconds of the given number of calls of the body
+     */
+    template<typename Body>
+    static double Time(Body &body, int iterations) {
+        auto startTime = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            body();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    /**
+     * Number of measured repetitions
+     */
+    int m_repetitions;
+
+    /**
+     * Substring of the names of the selected benchmarks
+     */
+    std::string m_filter;
+};
+
+int main(int argc, char *argv[]) {
+    if (argc < 5) {
+        // Assuming e p
+        std::cerr << "Invalid argument count." << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
+    char **largv = argv;
+    std::string edgesPath, profilePath, filter, scratchFile = "ptdr-microbench.tmp";
+    int samples = 10000, repetitions = 5;
+    while (*++largv) {
+        switch ((*largv)[1]) {
+            case 'e':
+                edgesPath = *++largv;
+                break;
+            case 'p':
+                profilePath = *++largv;
+                break;
+            case 'n':
+                samples = std::stoi(*++largv);
+                break;
+            case 'r':
+                repetitions = std::stoi(*++largv);
+                break;
+            case 'f':
+                filter = *++largv;
+                break;
+            case 'o':
+                scratchFile = *++largv;
+                break;
+            default:
+                printHelp();
+                std::exit(1);
+        }
+    }
+
+    Benchmark bench(std::max(repetitions, 1), filter);
+    int maxThreads = omp_get_max_threads();
+
+    // Machine readable output, one line per benchmark and parameter
+    std::cout << "benchmark;parameter;iterations;median_ms;min_ms;max_ms;items_per_s" << std::endl;
+
+    // Profile loading, parameter is the number of segments
+    std::vector<Routing::Data::Segment> segments = Routing::Data::LoadEdges(edgesPath);
+    bench.Run("load_profiles", static_cast<long>(segments.size()), static_cast<double>(segments.size()), [&]() {
+        Routing::ProfileDatabase database(profilePath, {edgesPath});
+    });
+
+    Routing::ProfileDatabase database(profilePath, {edgesPath});
+    std::vector<std::string> tmcIds;
+    for (const auto &segment : segments) {
+        tmcIds.push_back(segment.tmcId);
+    }
+
+    // Scalar travel time of a single thread, parameter is the length of a prefix of the route in segments
+    omp_set_num_threads(1);
+    for (std::size_t length = 1; bench.Enabled("travel_time_scalar") && length <= tmcIds.size(); length *= 4) {
+        Routing::Route route(database, std::vector<std::string>(tmcIds.begin(), tmcIds.begin() + length));
+        Routing::MCSimulation mc(database, route);
+        mc.SetKernel(Routing::SimulationKernel::Scalar);
+        mc.SetRngBackend(Routing::RngBackend::Philox);
+        mc.SetSeed(0);
+        bench.Run("travel_time_scalar", static_cast<long>(length), samples, [&]() {
+            mc.RunMonteCarloSimulation(samples, 0, 8, 0, false);
+        });
+    }
+
+    // Thread scaling of the whole route with the default kernel, parameter is the thread count
+    Routing::Route route(database, tmcIds);
+    Routing::MCSimulation mc(database, route);
+    mc.SetRngBackend(Routing::RngBackend::Philox);
+    mc.SetSeed(0);
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    for (int threads : threadCounts) {
+        if (!bench.Enabled("simulation_threads"))
+            break;
+        omp_set_num_threads(threads);
+        bench.Run("simulation_threads", threads, samples, [&]() {
+            mc.RunMonteCarloSimulation(samples, 0, 8, 0, false);
+        });
+    }
+    omp_set_num_threads(maxThreads);
+
+    // Statistics of the samples, parameter is the number of samples
+    std::vector<float> travelTimes = mc.RunMonteCarloSimulation(samples, 0, 8, 0, false);
+    std::vector<float> scratch;
+    bench.Run("result_stats", samples, samples, [&]() {
+        scratch = travelTimes;
+        ResultStats stats(scratch);
+    });
+
+    // Output of a week of samples, parameter is the number of samples per interval
+    int weekSamples = std::max(samples / 100, 1);
+    std::vector<float> week = mc.RunMonteCarloSimulation(weekSamples, 0, 0, 0, true);
+    bench.Run("write_result_all", weekSamples, static_cast<double>(week.size()), [&]() {
+        Routing::Data::WriteResultAll(week, scratchFile, weekSamples, database.GetSecondInterval());
+    });
+    std::remove(scratchFile.c_str());
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "ProfileCache.h"
+#include "RandomGenerator.h"
+#include "ResultCache.h"
+#include "SocketListener.h"
+#include "TravelTimeServer.h"
+
+void printHelp() {
+    std::cout << "Usage: ptdr-server -p [profiles directory] (-u [socket] -b [budget MB] -r [budget MB] -g [rng] -s [seed])"
+              << std::endl;
+    std::cout << "\t Arguments:" << std::endl;
+    std::cout << "\t\t -p: Directory with speed profiles, kept resident in the profile cache" << std::endl;
+    std::cout << "\t\t -u: Listen on the Unix domain socket, otherwise requests are read from stdin and replies"
+              << " written to stdout" << std::endl;
+    std::cout << "\t\t -b: Memory budget of the released profiles in MB (default 1024)" << std::endl;
+    std::cout << "\t\t -r: Memory budget of the cached results in MB, 0 disables the result cache (default 64)"
+              << std::endl;
+    std::cout << "\t\t -g: Random number generator (gnu, mkl, philox)" << std::endl;
+    std::cout << "\t\t -s: Random seed of every batch" << std::endl;
+    std::cout << "\t Requests: id;route edges file;day;hour;minute;samples(;percentiles separated by commas)" << std::endl;
+    std::cout << "\t Replies: id;OK;samples;mean;sample_dev;percentile:value,...;latency_ms;batch or id;ERROR;message"
+              << std::endl;
+    std::cout << "\t Line reload drops the cached profiles and results" << std::endl;
+}
+
+std::atomic<bool> stopRequested(false);
+
+void requestStop(int) {
+    stopRequested = true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        // Assuming p
+        std::cerr << "Invalid argument count." << std::endl;
+        printHelp();
+        std::exit(1);
+    }
+
+    char **largv = argv;
+    std::string profilePath, socketPath;
+    std::size_t budget = PROFILE_CACHE_DEFAULT_BUDGET;
+    std::size_t resultBudget = RESULT_CACHE_DEFAULT_BUDGET;
+    Routing::RngBackend rngBackend = Routing::RandomGenerator::DefaultBackend();
+    uint64_t seed = 0;
+    bool hasSeed = false;
+    while (*++largv) {
+        switch ((*largv)[1]) {
+            case 'p':
+                profilePath = *++largv;
+                break;
+            case 'u':
+                socketPath = *++largv;
+                break;
+            case 'b':
+                budget = std::stoull(*++largv) << 20;
+                break;
+            case 'r':
+                resultBudget = std::stoull(*++largv) << 20;
+                break;
+            case 'g':
+                if (!Routing::RandomGenerator::FromName(*++largv, rngBackend)) {
+                    std::cerr << "Unknown random number generator " << *largv << std::endl;
+                    printHelp();
+                    std::exit(1);
+                }
+                break;
+            case 's':
+                seed = std::stoull(*++largv);
+                hasSeed = true;
+                break;
+            default:
+                printHelp();
+                std::exit(1);
+        }
+    }
+
+    // Standard output carries the replies, the log goes to the error output
+    std::cerr << "Profiles directory: " << profilePath << std::endl;
+    std::cerr << "Memory budget: " << (budget >> 20) << " MB, results: " << (resultBudget >> 20) << " MB"
+              << std::endl;
+    std::cerr << "RNG: " << Routing::RandomGenerator::Name(rngBackend) << std::endl;
+
+    Routing::ProfileCache cache(profilePath, budget);
+    Routing::ResultCache results(resultBudget);
+    Routing::TravelTimeServer server(cache, resultBudget > 0 ? &results : nullptr);
+    server.SetRngBackend(rngBackend);
+    if (hasSeed)
+        server.SetSeed(seed);
+
+    std::thread input;
+    int listenFd = -1;
+    std::unique_ptr<Routing::SocketListener> listener;
+    std::mutex outputMutex;
+    if (socketPath.empty()) {
+        std::cerr << "Reading requests from stdin" << std::endl;
+        input = std::thread([&server, &outputMutex]() {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                if (line.empty())
+                    continue;
+                server.Submit(line, [&outputMutex](const std::string &reply) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << reply << std::endl;
+                });
+            }
+            server.Close();
+        });
+    } else {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            std::cerr << "ERROR: Socket path " << socketPath << " is too long" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        socketPath.copy(address.sun_path, socketPath.size());
+        unlink(socketPath.c_str());
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            listen(listenFd, SOMAXCONN) != 0) {
+            std::cerr << "ERROR: Cannot listen on socket " << socketPath << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+        std::cerr << "Listening on " << socketPath << std::endl;
+        listener.reset(new Routing::SocketListener(server, listenFd));
+        input = std::thread(&Routing::SocketListener::Run, listener.get(), std::cref(stopRequested));
+    }
+
+    server.Serve();
+    input.join();
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+
+    if (listener)
+        std::cerr << "Connections: " << listener->GetAcceptedConnections() << std::endl;
+    std::cerr << "Requests: " << server.GetRequestCount() << ", batches: " << server.GetBatchCount() << std::endl;
+    std::cerr << "Profile cache hits: " << cache.GetHits() << ", misses: " << cache.GetMisses() << ", evictions: "
+              << cache.GetEvictions() << std::endl;
+    std::cerr << "Result cache hits: " << results.GetHits() << ", misses: " << results.GetMisses() << ", evictions: "
+              << results.GetEvictions() << std::endl;
+    return 0;
+}
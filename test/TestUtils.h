@@ -0,0 +1,84 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "Data.h"
+
+#define TEST_SEGMENTS 6 // Segments of the synthetic test route
+#define TEST_SECOND_INTERVAL 900 // Profile interval of the synthetic test route in seconds
+
+/**
+ * Report a failed condition and count it, a test returns the number of failures
+ */
+#define CHECK(condition) Routing::Test::Check((condition), #condition, __FILE__, __LINE__)
+
+namespace Routing {
+    namespace Test {
+
+        /**
+         * @return number of failed checks of the test
+         */
+        inline int &Failures() {
+            static int failures = 0;
+            return failures;
+        }
+
+        inline void Check(bool passed, const char *condition, const char *file, int line) {
+            if (!passed) {
+                std::cerr << "FAILED: " << condition << " at " << file << ":" << line << std::endl;
+                Failures()++;
+            }
+        }
+
+        /**
+         * Write a synthetic route with speed profiles of two or three speeds per interval, congested on weekday
+         * mornings. Speeds and probabilities depend only on the segment and interval, so the data are the same
+         * on every run.
+         * @param directory directory to create, receives route.csv and the profiles directory
+         * @return path to the edges file of the route, empty on failure
+         */
+        inline std::string WriteRoute(const std::string &directory) {
+            std::string profiles = directory + "/profiles";
+            mkdir(directory.c_str(), 0755);
+            mkdir(profiles.c_str(), 0755);
+
+            std::vector<Data::Segment> segments;
+            for (int s = 0; s < TEST_SEGMENTS; ++s) {
+                Data::Segment segment = {"seg" + std::to_string(s), 300 + 150 * s, 25.0f - s};
+                segments.push_back(segment);
+
+                Data::SpeedLevels levels;
+                levels.intervals = 7 * 86400 / TEST_SECOND_INTERVAL;
+                levels.maxLevels = 3;
+                levels.counts.assign(levels.intervals, 0);
+                levels.speeds.assign(levels.intervals * levels.maxLevels, 0.0f);
+                levels.probabilities.assign(levels.intervals * levels.maxLevels, 0.0f);
+                for (int i = 0; i < levels.intervals; ++i) {
+                    int hour = (i % (86400 / TEST_SECOND_INTERVAL)) * TEST_SECOND_INTERVAL / 3600;
+                    bool congested = i < 5 * 86400 / TEST_SECOND_INTERVAL && hour >= 7 && hour < 9;
+                    float *speeds = &levels.speeds[i * levels.maxLevels];
+                    float *probabilities = &levels.probabilities[i * levels.maxLevels];
+                    speeds[0] = segment.freeSpeed;
+                    speeds[1] = segment.freeSpeed * 0.6f;
+                    probabilities[0] = congested ? 0.3f : 0.8f;
+                    probabilities[1] = 1.0f - probabilities[0];
+                    levels.counts[i] = 2;
+                    if (congested) {
+                        speeds[2] = 3.0f + s % 3;
+                        probabilities[1] = 0.45f;
+                        probabilities[2] = 0.25f;
+                        levels.counts[i] = 3;
+                    }
+                }
+                if (!Data::WriteSpeedLevels(profiles + "/" + segment.tmcId + "_profile.csv", levels,
+                                            TEST_SECOND_INTERVAL))
+                    return "";
+            }
+
+            std::string edges = directory + "/route.csv";
+            return Data::WriteEdges(edges, segments) ? edges : "";
+        }
+    }
+}
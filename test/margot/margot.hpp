@@ -0,0 +1,35 @@
+#pragma once
+
+/**
+ * Stub of the mArgot interface generated by bootstrap_margot.sh for the travel block of autotuning.conf. It lets the
+ * main application be compiled without mArgot, the knobs are never changed.
+ */
+namespace margot {
+
+    inline void init() {}
+
+    namespace travel {
+
+        /**
+         * Stub of the application-specific run-time manager
+         */
+        struct Manager {
+            void configuration_applied() {}
+        };
+
+        extern Manager manager;
+
+        /**
+         * @param samples knob num_samples, left unchanged
+         * @param unpredictability feature of the input
+         * @return false, the configuration never changes
+         */
+        inline bool update(int &samples, const float unpredictability) {
+            (void) samples;
+            (void) unpredictability;
+            return false;
+        }
+
+        inline void log() {}
+    }
+}
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <random>
+#include "MCSimulation.h"
+#include "ProfileStore.h"
+#include "ResultStats.h"
+#include "TestUtils.h"
+
+int main() {
+    // Random distributions with probabilities below the 1% resolution of the expanded profiles
+    std::mt19937_64 rng(5);
+    std::uniform_real_distribution<float> uniform(0.001f, 1.0f);
+    Routing::Data::SpeedLevels levels;
+    levels.intervals = 200;
+    levels.maxLevels = 5;
+    levels.counts.assign(levels.intervals, 0);
+    levels.speeds.assign(levels.intervals * levels.maxLevels, 0.0f);
+    levels.probabilities.assign(levels.intervals * levels.maxLevels, 0.0f);
+    for (int i = 0; i < levels.intervals; ++i) {
+        int count = 1 + i % levels.maxLevels;
+        float sum = 0.0f;
+        for (int l = 0; l < count; ++l) {
+            levels.speeds[i * levels.maxLevels + l] = 5.0f * (l + 1);
+            levels.probabilities[i * levels.maxLevels + l] = l == 0 && count > 1 ? 0.003f : uniform(rng);
+            sum += levels.probabilities[i * levels.maxLevels + l];
+        }
+        for (int l = 0; l < count; ++l) {
+            levels.probabilities[i * levels.maxLevels + l] /= sum;
+        }
+        levels.counts[i] = count;
+    }
+
+    // Probability of a speed is the sum of the column shares selecting it, exact up to the 24-bit thresholds
+    int columns = Routing::Data::AliasColumns(levels.maxLevels);
+    std::vector<float> table(columns * ALIAS_ENTRY_SIZE * levels.intervals);
+    Routing::Data::BuildAliasTables(levels, columns, table.data());
+    for (int i = 0; i < levels.intervals; ++i) {
+        const float *interval = &table[i * columns * ALIAS_ENTRY_SIZE];
+        for (int l = 0; l < levels.counts[i]; ++l) {
+            float speed = levels.speeds[i * levels.maxLevels + l];
+            double probability = 0.0;
+            for (int c = 0; c < columns; ++c) {
+                double threshold = interval[c * ALIAS_ENTRY_SIZE] / ALIAS_THRESHOLD_SCALE;
+                probability += (interval[c * ALIAS_ENTRY_SIZE + 1] == speed ? threshold : 0.0) / columns;
+                probability += (interval[c * ALIAS_ENTRY_SIZE + 2] == speed ? 1.0 - threshold : 0.0) / columns;
+            }
+            CHECK(std::fabs(probability - levels.probabilities[i * levels.maxLevels + l]) < 1e-6);
+        }
+    }
+
+    // Probabilities of the synthetic route are multiples of 5%, so both representations are exact and the
+    // simulations agree within the sampling noise
+    std::string route = Routing::Test::WriteRoute("alias_data");
+    CHECK(!route.empty());
+    Routing::MCSimulation expanded(route, "alias_data/profiles");
+    Routing::MCSimulation alias(route, "alias_data/profiles", Routing::ProfileLayout::IntervalMajor,
+                                Routing::ProfileStorage::Alias);
+    for (auto mc : {&expanded, &alias}) {
+        mc->SetRngBackend(Routing::RngBackend::Philox);
+        mc->SetSeed(13);
+    }
+    for (int hour : {3, 8}) {
+        std::vector<float> expandedTimes = expanded.RunMonteCarloSimulation(100000, 2, hour, 0, false);
+        std::vector<float> aliasTimes = alias.RunMonteCarloSimulation(100000, 2, hour, 0, false);
+        ResultStats expandedStats(expandedTimes), aliasStats(aliasTimes);
+        CHECK(std::fabs(expandedStats.mean - aliasStats.mean) <= 0.01 * expandedStats.mean);
+        CHECK(std::fabs(expandedStats.sampleDev - aliasStats.sampleDev) <= 0.05 * expandedStats.sampleDev);
+    }
+
+    // Alias tables of a binary store are built from the stored distributions, same as from the CSV files
+    std::vector<Routing::ProfileStore::Source> sources;
+    for (const auto &segment : Routing::Data::LoadEdges(route)) {
+        sources.push_back({segment.tmcId, "alias_data/profiles/" + segment.tmcId + "_profile.csv", segment.length,
+                           segment.freeSpeed});
+    }
+    CHECK(Routing::ProfileStore::Convert(sources, "alias_data/profiles.ptdr"));
+    Routing::MCSimulation stored(route, "alias_data/profiles.ptdr", Routing::ProfileLayout::IntervalMajor,
+                                 Routing::ProfileStorage::Alias);
+    stored.SetRngBackend(Routing::RngBackend::Philox);
+    stored.SetSeed(13);
+    CHECK(stored.RunMonteCarloSimulation(10000, 4, 8, 0, false) ==
+          alias.RunMonteCarloSimulation(10000, 4, 8, 0, false));
+
+    return Routing::Test::Failures();
+}
@@ -0,0 +1,41 @@
+#include "BatchSimulation.h"
+#include "ProfileDatabase.h"
+#include "ResultStats.h"
+#include "TestUtils.h"
+
+int main() {
+    std::string route = Routing::Test::WriteRoute("batch_data");
+    CHECK(!route.empty());
+    std::vector<Routing::Data::Segment> segments = Routing::Data::LoadEdges(route);
+    segments.resize(1);
+    CHECK(Routing::Data::WriteEdges("batch_data/short.csv", segments));
+
+    // Short route first, it is the last one started if the batch is reordered as a whole
+    std::vector<Routing::Data::BatchEntry> requests = {{"batch_data/short.csv", 0, 8, 0}};
+    for (int i = 0; i < 2 * BATCH_MAX_OUTSTANDING; ++i) {
+        requests.push_back({route, i % 2 * 5, 8, 0});
+    }
+    Routing::ProfileDatabase database("batch_data/profiles", {route});
+    Routing::BatchSimulation batch(database, requests);
+    batch.SetRngBackend(Routing::RngBackend::Philox);
+    batch.SetSeed(19);
+
+    // Results arrive in the order of the requests, same requests get the same travel times
+    for (auto engine : {Routing::SimulationEngine::MonteCarlo, Routing::SimulationEngine::Histogram}) {
+        batch.SetEngine(engine);
+        std::vector<int> indices;
+        std::vector<double> means;
+        batch.Run(2000, {0.5}, [&](int r, const ResultStats &stats) {
+            indices.push_back(r);
+            means.push_back(stats.mean);
+        });
+        CHECK(static_cast<int>(indices.size()) == batch.GetRequestCount());
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            CHECK(indices[i] == static_cast<int>(i));
+            CHECK(i < 3 || means[i] == means[i - 2]);
+        }
+        CHECK(means.size() > 2 && means[0] < means[1] && means[1] != means[2]);
+    }
+
+    return Routing::Test::Failures();
+}
@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "CSVReader.h"
+#include "TestUtils.h"
+
+namespace {
+    /**
+     * Outcome of a parser, the value or the exception it throws
+     */
+    template<typename Parse>
+    std::string Outcome(Parse parse) {
+        try {
+            std::ostringstream value;
+            value.precision(9);
+            value << parse();
+            return value.str();
+        } catch (const std::invalid_argument &) {
+            return "invalid_argument";
+        } catch (const std::out_of_range &) {
+            return "out_of_range";
+        }
+    }
+
+    /**
+     * Check that the field parses the text the same way as the standard library
+     */
+    void CheckSame(const std::string &text) {
+        Routing::CSVField field(text.data(), text.size());
+        std::string toInt = Outcome([&]() { return field.ToInt(); });
+        std::string stoi = Outcome([&]() { return std::stoi(text); });
+        std::string toFloat = Outcome([&]() { return field.ToFloat(); });
+        std::string stof = Outcome([&]() { return std::stof(text); });
+        if (toInt != stoi || toFloat != stof)
+            std::cerr << "Text " << text << ": ToInt " << toInt << ", stoi " << stoi << ", ToFloat " << toFloat
+                      << ", stof " << stof << std::endl;
+        CHECK(toInt == stoi);
+        CHECK(toFloat == stof);
+    }
+}
+
+int main() {
+    for (const char *text : {"0", "7", "-7", "+7", "0042", "2147483647", "-2147483648", "2147483648", "-2147483649",
+                             "99999999999999999999", "12abc", "3.75", "-0.5", ".5", "5.", "1e3", "2.5E-2", "inf",
+                             "nan", "0.1234567890123456789", "123456789012345678", "1e-30", "1e39", "", "-", "+",
+                             ".", "abc", "e5"}) {
+        CheckSame(text);
+    }
+
+    // Speeds and probabilities as written by the profile files
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+    const char *formats[] = {"%.0f", "%.1f", "%.2f", "%.6f", "%.9g", "%.17g"};
+    for (int i = 0; i < 100000; ++i) {
+        char text[64];
+        std::snprintf(text, sizeof(text), formats[i % 6], uniform(rng));
+        CheckSame(text);
+    }
+
+    // Fields of a row refer to the line without the spaces
+    std::istringstream stream(" 12 ; 3.5 ;x\r\n");
+    Routing::CSVReader row(';');
+    stream >> row;
+    CHECK(row.size() == 3);
+    CHECK(row[0].ToInt() == 12);
+    CHECK(row[1].ToFloat() == 3.5f);
+    CHECK(row[2] == "x");
+
+    return Routing::Test::Failures();
+}
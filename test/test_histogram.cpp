@@ -0,0 +1,34 @@
+#include <cmath>
+#include "MCSimulation.h"
+#include "ResultStats.h"
+#include "TestUtils.h"
+
+int main() {
+    const std::vector<float> percentiles = {0.25, 0.5, 0.75};
+    std::string route = Routing::Test::WriteRoute("histogram_data");
+    CHECK(!route.empty());
+    Routing::MCSimulation mc(route, "histogram_data/profiles");
+    mc.SetRngBackend(Routing::RngBackend::Philox);
+    mc.SetSeed(11);
+
+    // Histogram convolution agrees with the sampling within the sampling noise, off-peak and in the morning peak
+    for (int hour : {3, 8}) {
+        TravelTimeHistogram histogram;
+        CHECK(mc.ConvolveHistograms(1, hour, 0, histogram));
+        ResultStats convolved(histogram, percentiles);
+
+        std::vector<float> samples = mc.RunMonteCarloSimulation(100000, 1, hour, 0, false);
+        ResultStats sampled(samples, percentiles);
+        CHECK(std::fabs(convolved.mean - sampled.mean) <= 0.01 * sampled.mean);
+        CHECK(std::fabs(convolved.sampleDev - sampled.sampleDev) <= 0.05 * sampled.sampleDev);
+        for (float p : percentiles) {
+            CHECK(std::fabs(convolved.percentiles[p] - sampled.percentiles[p]) <= 0.02 * sampled.percentiles[p]);
+        }
+    }
+
+    // Distribution wider than the allowed bins is reported, so the caller samples instead
+    TravelTimeHistogram narrow;
+    CHECK(!mc.ConvolveHistograms(1, 8, 0, narrow, 2));
+
+    return Routing::Test::Failures();
+}
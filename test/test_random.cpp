@@ -0,0 +1,24 @@
+#include "RandomGenerator.h"
+#include "TestUtils.h"
+
+int main() {
+    // Known answers of Philox4x32-10 published with the reference implementation (Random123 kat_vectors)
+    const uint32_t counters[3][4] = {{0x00000000, 0x00000000, 0x00000000, 0x00000000},
+                                     {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                                     {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+    const uint32_t keys[3][2] = {{0x00000000, 0x00000000},
+                                 {0xffffffff, 0xffffffff},
+                                 {0xa4093822, 0x299f31d0}};
+    const uint32_t expected[3][4] = {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+                                     {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+                                     {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+    for (int v = 0; v < 3; ++v) {
+        uint32_t words[4];
+        Routing::Philox4x32::Generate(counters[v], keys[v], words);
+        for (int w = 0; w < 4; ++w) {
+            CHECK(words[w] == expected[v][w]);
+        }
+    }
+
+    return Routing::Test::Failures();
+}
@@ -0,0 +1,55 @@
+#include "ResultCache.h"
+#include "TestUtils.h"
+
+int main() {
+    using Routing::ResultCache;
+    const std::vector<float> result(100, 1.0f);
+    const ResultCache::Key first = {1, 10, 100}, second = {1, 11, 100}, third = {2, 10, 100};
+
+    // Budget of two results
+    ResultCache cache(2 * result.size() * sizeof(float));
+    std::vector<float> travelTimes;
+    CHECK(!cache.Lookup(first, travelTimes));
+    cache.Insert(first, result);
+    cache.Insert(second, std::vector<float>(100, 2.0f));
+    CHECK(cache.Lookup(first, travelTimes));
+    CHECK(travelTimes == result);
+    CHECK(cache.GetHits() == 1);
+    CHECK(cache.GetMisses() == 1);
+    CHECK(cache.GetResidentBytes() == 2 * result.size() * sizeof(float));
+
+    // Least recently used result is evicted, the first one was looked up after the second one was inserted
+    cache.Insert(third, result);
+    CHECK(cache.GetEvictions() == 1);
+    CHECK(!cache.Lookup(second, travelTimes));
+    CHECK(cache.Lookup(first, travelTimes));
+    CHECK(cache.Lookup(third, travelTimes));
+
+    // Replacing a result keeps its size accounted once
+    cache.Insert(third, result);
+    CHECK(cache.GetResidentBytes() == 2 * result.size() * sizeof(float));
+    CHECK(cache.GetEvictions() == 1);
+
+    // Results larger than the budget are not stored
+    ResultCache::Key large = {3, 0, 1000};
+    cache.Insert(large, std::vector<float>(1000, 1.0f));
+    CHECK(!cache.Lookup(large, travelTimes));
+    CHECK(cache.Lookup(first, travelTimes));
+
+    cache.Invalidate();
+    CHECK(cache.GetResidentBytes() == 0);
+    CHECK(!cache.Lookup(first, travelTimes));
+    CHECK(!cache.Lookup(third, travelTimes));
+
+    // Fingerprint depends on the order and the values of the segments
+    std::vector<Routing::Data::Segment> route = {{"a", 100, 10.0f}, {"b", 200, 20.0f}};
+    std::vector<Routing::Data::Segment> reversed = {{"b", 200, 20.0f}, {"a", 100, 10.0f}};
+    std::vector<Routing::Data::Segment> longer = {{"a", 101, 10.0f}, {"b", 200, 20.0f}};
+    std::vector<Routing::Data::Segment> joined = {{"ab", 100, 10.0f}};
+    CHECK(ResultCache::Fingerprint(route) == ResultCache::Fingerprint(route));
+    CHECK(ResultCache::Fingerprint(route) != ResultCache::Fingerprint(reversed));
+    CHECK(ResultCache::Fingerprint(route) != ResultCache::Fingerprint(longer));
+    CHECK(ResultCache::Fingerprint(route) != ResultCache::Fingerprint(joined));
+
+    return Routing::Test::Failures();
+}
@@ -0,0 +1,106 @@
+#include <sstream>
+#include "ProfileCache.h"
+#include "ResultCache.h"
+#include "TravelTimeServer.h"
+#include "TestUtils.h"
+
+namespace {
+    /**
+     * Split the reply line to its fields
+     */
+    std::vector<std::string> Fields(const std::string &reply) {
+        std::vector<std::string> fields;
+        std::istringstream stream(reply);
+        std::string field;
+        while (std::getline(stream, field, ';')) {
+            fields.push_back(field);
+        }
+        return fields;
+    }
+
+    /**
+     * Submit the requests to a new server and answer them
+     * @return replies in the order they were sent
+     */
+    std::vector<std::string> Serve(Routing::ProfileCache &profiles, const std::vector<std::string> &requests,
+                                   Routing::ResultCache *results = nullptr) {
+        std::vector<std::string> replies;
+        Routing::TravelTimeServer server(profiles, results);
+        server.SetRngBackend(Routing::RngBackend::Philox);
+        server.SetSeed(7);
+        for (const auto &request : requests) {
+            server.Submit(request, [&replies](const std::string &reply) { replies.push_back(reply); });
+        }
+        server.Close();
+        server.Serve();
+        return replies;
+    }
+}
+
+int main() {
+    std::string route = Routing::Test::WriteRoute("server_data");
+    CHECK(!route.empty());
+    Routing::ProfileCache profiles("server_data/profiles");
+
+    // Invalid requests are answered immediately with the reason
+    std::vector<std::string> replies = Serve(profiles, {
+            "",
+            "a;" + route + ";0;8",
+            "b;" + route + ";x;8;0;100",
+            "c;" + route + ";7;8;0;100",
+            "d;" + route + ";0;24;0;100",
+            "e;" + route + ";0;8;0;0",
+            "f;" + route + ";0;8;0;" + std::to_string(SERVER_MAX_SAMPLES + 1),
+            "g;" + route + ";0;8;0;100;0.5,1.5",
+            "h;server_data/missing.csv;0;8;0;100"});
+    CHECK(replies.size() == 9);
+    if (replies.size() == 9) {
+        CHECK(replies[0] == ";ERROR;empty request");
+        CHECK(replies[1] == "a;ERROR;invalid column count");
+        CHECK(replies[2] == "b;ERROR;invalid number");
+        CHECK(replies[3] == "c;ERROR;invalid departure");
+        CHECK(replies[4] == "d;ERROR;invalid departure");
+        CHECK(replies[5] == "e;ERROR;invalid number of samples");
+        CHECK(replies[6] == "f;ERROR;invalid number of samples");
+        CHECK(replies[7] == "g;ERROR;invalid percentile");
+        CHECK(replies[8] == "h;ERROR;unable to open route file");
+    }
+
+    // Requests of the same departure are coalesced, the smaller one uses the first samples of the larger one
+    replies = Serve(profiles, {"i;" + route + ";0;8;0;1000", "j;" + route + ";0;8;0;500;0.5",
+                               "k;" + route + ";0;8;5;500"});
+    CHECK(replies.size() == 3);
+    if (replies.size() == 3) {
+        std::vector<std::string> i = Fields(replies[0]), j = Fields(replies[1]), k = Fields(replies[2]);
+        CHECK(i.size() == 8 && i[0] == "i" && i[1] == "OK" && i[2] == "1000" && i[7] == "2");
+        CHECK(j.size() == 8 && j[0] == "j" && j[1] == "OK" && j[2] == "500" && j[7] == "2");
+        CHECK(j.size() == 8 && j[5].compare(0, 4, "0.5:") == 0);
+        CHECK(k.size() == 8 && k[0] == "k" && k[1] == "OK" && k[7] == "1");
+    }
+
+    // Reload is acknowledged after the requests queued before it are answered
+    replies = Serve(profiles, {"l;" + route + ";0;8;10;100", "reload", "m;" + route + ";0;8;10;100"});
+    CHECK(replies.size() == 3);
+    if (replies.size() == 3) {
+        CHECK(Fields(replies[0]).size() == 8 && Fields(replies[0])[1] == "OK");
+        CHECK(replies[1] == "reload;OK");
+        CHECK(Fields(replies[2]).size() == 8 && Fields(replies[2])[1] == "OK");
+    }
+
+    // Same interval and samples are answered from the result cache with batch 0, reload drops the cache, so the
+    // last request is simulated
+    Routing::ResultCache results;
+    replies = Serve(profiles, {"n;" + route + ";0;8;0;1000"}, &results);
+    std::string mean = replies.size() == 1 && Fields(replies[0]).size() == 8 ? Fields(replies[0])[3] : "";
+    replies = Serve(profiles, {"o;" + route + ";0;8;10;1000", "reload", "p;" + route + ";0;8;10;1000"}, &results);
+    CHECK(replies.size() == 3);
+    if (replies.size() == 3) {
+        std::vector<std::string> o = Fields(replies[0]), p = Fields(replies[2]);
+        CHECK(o.size() == 8 && o[1] == "OK" && o[3] == mean && o[7] == "0");
+        CHECK(replies[1] == "reload;OK");
+        CHECK(p.size() == 8 && p[1] == "OK" && p[7] == "1");
+    }
+    CHECK(results.GetHits() == 1);
+
+    return Routing::Test::Failures();
+}
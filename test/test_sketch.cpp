@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "ResultStats.h"
+#include "TestUtils.h"
+
+int main() {
+    const std::vector<float> percentiles = {0.0, 0.05, 0.25, 0.5, 0.75, 0.95, 1.0};
+
+    // Skewed travel times, as of a congested route
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<float> distribution(7.0f, 0.4f);
+    std::vector<float> travelTimes(100000);
+    QuantileSketch sketch(0.01);
+    for (auto &t : travelTimes) {
+        t = distribution(rng);
+        sketch.Add(t);
+    }
+    float largest = *std::max_element(travelTimes.begin(), travelTimes.end());
+
+    // Exact percentile 1 is the largest sample, the sketch keeps the relative error of its percentiles
+    std::vector<float> sorted = travelTimes;
+    ResultStats exact(sorted, percentiles);
+    ResultStats estimated(sketch, percentiles);
+    CHECK(exact.percentiles[1.0f] == largest);
+    for (const auto &p : percentiles) {
+        CHECK(std::fabs(estimated.percentiles[p] - exact.percentiles[p]) <= 0.01 * exact.percentiles[p] + 1e-3);
+    }
+    CHECK(std::fabs(estimated.mean - exact.mean) <= 1e-3 * exact.mean);
+    CHECK(std::fabs(estimated.sampleDev - exact.sampleDev) <= 1e-2 * exact.sampleDev);
+
+    // Sketches of parts merged together summarize the whole
+    QuantileSketch first(0.01), second(0.01);
+    for (std::size_t i = 0; i < travelTimes.size(); ++i) {
+        (i % 3 == 0 ? first : second).Add(travelTimes[i]);
+    }
+    first.Merge(second);
+    CHECK(first.GetCount() == travelTimes.size());
+    for (const auto &p : percentiles) {
+        CHECK(std::fabs(first.Quantile(p) - sketch.Quantile(p)) <= 0.02 * sketch.Quantile(p));
+    }
+
+    return Routing::Test::Failures();
+}
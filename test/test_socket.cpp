@@ -0,0 +1,140 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "ProfileCache.h"
+#include "SocketListener.h"
+#include "TravelTimeServer.h"
+#include "TestUtils.h"
+
+#define TEST_CONNECTIONS 500 // Connections opened and closed one after another, more than the readers ever alive
+#define TEST_WAIT_MS 5000 // Longest wait for the readers to finish
+
+namespace {
+    /**
+     * @return number of open file descriptors of the process
+     */
+    int OpenFiles() {
+        DIR *directory = opendir("/proc/self/fd");
+        if (!directory)
+            return -1;
+        int count = 0;
+        while (readdir(directory)) {
+            count++;
+        }
+        closedir(directory);
+        return count;
+    }
+
+    /**
+     * Connect to the listening socket
+     * @return connected socket, -1 on failure
+     */
+    int Connect(const sockaddr_un &address) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /**
+     * Send a request line and read the reply line
+     * @return reply without the line end, empty when the connection fails
+     */
+    std::string Request(int fd, const std::string &line) {
+        std::string data = line + '\n';
+        if (send(fd, data.data(), data.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(data.size()))
+            return "";
+        std::string reply;
+        char c;
+        while (recv(fd, &c, 1, 0) == 1 && c != '\n') {
+            reply += c;
+        }
+        return reply;
+    }
+
+    bool StartsWith(const std::string &text, const std::string &prefix) {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    /**
+     * Wait until the condition holds or the wait times out
+     * @return condition
+     */
+    template<typename Condition>
+    bool WaitFor(Condition condition) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TEST_WAIT_MS);
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+}
+
+int main() {
+    std::string route = Routing::Test::WriteRoute("socket_data");
+    CHECK(!route.empty());
+    Routing::ProfileCache profiles("socket_data/profiles");
+    Routing::TravelTimeServer server(profiles);
+    server.SetRngBackend(Routing::RngBackend::Philox);
+    server.SetSeed(7);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::string socketPath = "socket_data/server.sock";
+    socketPath.copy(address.sun_path, socketPath.size());
+    unlink(socketPath.c_str());
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(listenFd >= 0);
+    CHECK(bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+    CHECK(listen(listenFd, SOMAXCONN) == 0);
+
+    std::atomic<bool> stop(false);
+    Routing::SocketListener listener(server, listenFd);
+    std::thread accepting(&Routing::SocketListener::Run, &listener, std::cref(stop));
+    std::thread serving(&Routing::TravelTimeServer::Serve, &server);
+
+    // Closed connections release their socket and reader, replies of both the dispatcher and the reader arrive
+    int openFiles = OpenFiles();
+    int replies = 0;
+    for (int i = 0; i < TEST_CONNECTIONS; ++i) {
+        int fd = Connect(address);
+        CHECK(fd >= 0);
+        if (fd < 0)
+            break;
+        // Every tenth client waits for a simulation, every other one for an invalid request, the rest send nothing
+        std::string id = std::to_string(i);
+        if (i % 10 == 0)
+            replies += StartsWith(Request(fd, id + ";" + route + ";0;8;0;100"), id + ";OK;");
+        else if (i % 2 == 0)
+            replies += Request(fd, id + ";" + route + ";0;8") == id + ";ERROR;invalid column count";
+        close(fd);
+    }
+    CHECK(replies == TEST_CONNECTIONS / 2);
+    CHECK(WaitFor([&listener]() { return listener.GetAcceptedConnections() == TEST_CONNECTIONS; }));
+    CHECK(WaitFor([&listener]() { return listener.GetOpenConnections() == 0; }));
+    CHECK(WaitFor([openFiles]() { return OpenFiles() == openFiles; }));
+
+    // Stop wakes up the readers of the open connections and closes the server
+    int idle = Connect(address);
+    int busy = Connect(address);
+    CHECK(idle >= 0 && busy >= 0);
+    CHECK(StartsWith(Request(busy, "a;" + route + ";0;8;0;100"), "a;OK;"));
+    CHECK(WaitFor([&listener]() { return listener.GetOpenConnections() == 2; }));
+    stop = true;
+    accepting.join();
+    serving.join();
+    CHECK(listener.GetOpenConnections() == 0);
+    close(idle);
+    close(busy);
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return Routing::Test::Failures();
+}
@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "ProfileDatabase.h"
+#include "ProfileStore.h"
+#include "TestUtils.h"
+
+int main() {
+    std::string route = Routing::Test::WriteRoute("store_data");
+    CHECK(!route.empty());
+    std::vector<Routing::ProfileStore::Source> sources;
+    for (const auto &segment : Routing::Data::LoadEdges(route)) {
+        sources.push_back({segment.tmcId, "store_data/profiles/" + segment.tmcId + "_profile.csv", segment.length,
+                           segment.freeSpeed});
+    }
+
+    // Failed conversion leaves neither the store nor the temporary file behind
+    std::remove("store_data/profiles.ptdr");
+    std::vector<Routing::ProfileStore::Source> missing = sources;
+    missing.push_back({"zzz", "store_data/profiles/zzz_profile.csv", 100, 10.0f});
+    CHECK(!Routing::ProfileStore::Convert(missing, "store_data/profiles.ptdr"));
+    CHECK(!std::ifstream("store_data/profiles.ptdr").good());
+    CHECK(!std::ifstream("store_data/profiles.ptdr.tmp").good());
+
+    // Store holds the segments of the route with their lengths, freeflow speeds and profiles
+    CHECK(Routing::ProfileStore::Convert(sources, "store_data/profiles.ptdr"));
+    CHECK(!std::ifstream("store_data/profiles.ptdr.tmp").good());
+    Routing::ProfileDatabase csv("store_data/profiles", {route});
+    Routing::ProfileDatabase store("store_data/profiles.ptdr");
+    CHECK(store.GetSegmentCount() == TEST_SEGMENTS);
+    CHECK(store.GetSecondInterval() == TEST_SECOND_INTERVAL);
+    for (const auto &source : sources) {
+        int c = csv.Find(source.tmcId), s = store.Find(source.tmcId);
+        CHECK(s >= 0 && store.GetLength(s) == source.length && store.GetFreeSpeed(s) == source.freeSpeed);
+        std::size_t size = static_cast<std::size_t>(7 * 86400 / TEST_SECOND_INTERVAL) * INDEX_RESOLUTION;
+        CHECK(c >= 0 && s >= 0 && std::equal(csv.GetSpeedProfile(c), csv.GetSpeedProfile(c) + size,
+                                             store.GetSpeedProfile(s)));
+    }
+    CHECK(store.Find("zzz") == -1);
+
+    return Routing::Test::Failures();
+}
@@ -0,0 +1,55 @@
+#include <omp.h>
+#include "MCSimulation.h"
+#include "ResultStats.h"
+#include "TestUtils.h"
+
+int main() {
+    std::string route = Routing::Test::WriteRoute("sweep_data");
+    CHECK(!route.empty());
+    Routing::MCSimulation mc(route, "sweep_data/profiles");
+    mc.SetRngBackend(Routing::RngBackend::Philox);
+    mc.SetSeed(17);
+
+    const int samples = 1000;
+    const int intervalsPerDay = 86400 / TEST_SECOND_INTERVAL;
+    auto block = [&](const std::vector<float> &week, int day, int hour) {
+        auto first = week.begin() + static_cast<std::ptrdiff_t>(day * intervalsPerDay + hour * 3600 /
+                                                                 TEST_SECOND_INTERVAL) * samples;
+        return std::vector<float>(first, first + samples);
+    };
+
+    // Profiles of the synthetic route differ only in the weekday mornings, every other departure draws the same
+    // random numbers and gets the same travel times
+    std::vector<float> week = mc.RunMonteCarloSimulation(samples, 0, 0, 0, true);
+    CHECK(week.size() == static_cast<std::size_t>(7 * intervalsPerDay * samples));
+    CHECK(block(week, 0, 2) == block(week, 2, 3));
+    CHECK(block(week, 0, 2) == block(week, 6, 14));
+    CHECK(block(week, 0, 8) != block(week, 0, 2));
+    std::vector<float> night = block(week, 0, 2), morning = block(week, 0, 8);
+    CHECK(ResultStats(morning).mean > ResultStats(night).mean);
+
+    // Counter based generator gives the same sweep for any number of threads
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    CHECK(mc.RunMonteCarloSimulation(samples, 0, 0, 0, true) == week);
+    omp_set_num_threads(threads);
+
+    // Streaming sweeps use the same random numbers as the whole week at once
+    std::vector<float> streamed;
+    mc.SweepWeekSamples(samples, [&streamed](int, int, const float *travelTimes) {
+        streamed.insert(streamed.end(), travelTimes, travelTimes + samples);
+    });
+    CHECK(streamed == week);
+
+    const std::vector<float> percentiles = {0.05, 0.5, 0.95};
+    int failures = 0;
+    mc.SweepWeek(samples, percentiles, 0.0, [&](int day, int interval, const ResultStats &stats) {
+        auto first = week.begin() + static_cast<std::ptrdiff_t>(day * intervalsPerDay + interval) * samples;
+        std::vector<float> travelTimes(first, first + samples);
+        ResultStats expected(travelTimes, percentiles);
+        failures += stats.mean != expected.mean || stats.percentiles != expected.percentiles;
+    });
+    CHECK(failures == 0);
+
+    return Routing::Test::Failures();
+}